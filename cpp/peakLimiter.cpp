@@ -1,614 +1,2109 @@
-/*
-Copyright (c) 2016, UMR STMS 9912 - Ircam-Centre Pompidou / CNRS / UPMC
-All rights reserved.
-
-Redistribution and use in source and binary forms, with or without
-modification, are permitted provided that the following conditions are met:
-    * Redistributions of source code must retain the above copyright
-      notice, this list of conditions and the following disclaimer.
-    * Redistributions in binary form must reproduce the above copyright
-      notice, this list of conditions and the following disclaimer in the
-      documentation and/or other materials provided with the distribution.
-    * Neither the name of the <organization> nor the
-      names of its contributors may be used to endorse or promote products
-      derived from this software without specific prior written permission.
-
-THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
-ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
-WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
-DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
-DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
-(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
-LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
-ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
-(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
-SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
-*/
-
-#include "peakLimiter.h"
-
-#ifndef max
-#define max(a, b)   (((a) > (b)) ? (a) : (b))
-#endif
-#ifndef min
-#define min(a, b)   (((a) < (b)) ? (a) : (b))
-#endif
-
-/* create limiter */
- PeakLimiter::PeakLimiter(
-                           float         maxAttackMsIn,
-                           float         releaseMsIn,
-                           float         thresholdIn,
-                           int  maxChannelsIn,
-                           int  maxSampleRateIn
-                           )
-{
-
-  /* calc m_attack time in samples */
-  m_attack = (int)(maxAttackMsIn * maxSampleRateIn / 1000);
-
-  if (m_attack < 1) /* m_attack time is too short */
-	  m_attack = 1; 
-
-  /* length of m_pMaxBuffer sections */
-  m_sectionLen = (int)sqrt((float)m_attack+1);
-  /* sqrt(m_attack+1) leads to the minimum 
-     of the number of maximum operators:
-     nMaxOp = m_sectionLen + (m_attack+1)/m_sectionLen */
-
-  /* alloc limiter struct */
-
-  m_nbrMaxBufferSection = (m_attack+1)/m_sectionLen;
-  if (m_nbrMaxBufferSection*m_sectionLen < (m_attack+1))
-    m_nbrMaxBufferSection++; /* create a full section for the last samples */
-
-  /* alloc maximum and delay buffers */
-  m_pMaxBuffer   = new float[m_nbrMaxBufferSection * m_sectionLen];
-  m_pDelayBuffer   = new float[m_attack * maxChannelsIn];
-  m_pMaxBufferSlow   = new float[m_nbrMaxBufferSection];
-  m_pIndexMaxInSection = new  int[m_nbrMaxBufferSection];
-
-  if ((m_pMaxBuffer==NULL) || (m_pDelayBuffer==NULL) || (m_pMaxBufferSlow==NULL)) {
-    destroyLimiter();
-    return;
-  }
-
-  /* init parameters & states */
-  m_maxBufferIndex = 0;
-  m_delayBufferIndex = 0;
-  m_maxBufferSlowIndex = 0;
-  m_maxBufferSectionIndex = 0;
-  m_maxBufferSectionCounter = 0;
-  m_maxMaxBufferSlow = 0;
-  m_indexMaxBufferSlow = 0;
-  m_maxCurrentSection = 0;
-
-  m_attackMs      = maxAttackMsIn;
-  m_maxAttackMs   = maxAttackMsIn;
-  m_attackConst   = (float)pow(0.1, 1.0 / (m_attack + 1));
-  m_releaseConst  = (float)pow(0.1, 1.0 / (m_releaseMs * maxSampleRateIn / 1000 + 1));
-  m_threshold     = thresholdIn;
-  m_channels      = maxChannelsIn;
-  m_maxChannels   = maxChannelsIn;
-  m_sampleRate    = maxSampleRateIn;
-  m_maxSampleRate = maxSampleRateIn;
-    
-
-  m_fadedGain = 1.0f;
-  m_smoothState = 1.0;
-    
-    memset(m_pMaxBuffer,0,sizeof(float)*m_nbrMaxBufferSection * m_sectionLen);
-    memset(m_pDelayBuffer,0,sizeof(float)*m_attack * maxChannelsIn);
-    memset(m_pMaxBufferSlow,0,sizeof(float)*m_nbrMaxBufferSection);
-    memset(m_pIndexMaxInSection,0,sizeof( int)*m_nbrMaxBufferSection);
-}
-
-PeakLimiter::~PeakLimiter()
-{
-    destroyLimiter();
-}
-
-/* reset limiter */
-int PeakLimiter::resetLimiter()
-{
- 
-    m_maxBufferIndex = 0;
-    m_delayBufferIndex = 0;
-    m_maxBufferSlowIndex = 0;
-    m_maxBufferSectionIndex = 0;
-    m_maxBufferSectionCounter = 0;
-    m_fadedGain = 1.0f;
-    m_smoothState = 1.0;
-    m_maxMaxBufferSlow = 0;
-    m_indexMaxBufferSlow = 0;
-    m_maxCurrentSection = 0;
-
-
-    memset(m_pMaxBuffer,0,sizeof(float)*m_nbrMaxBufferSection * m_sectionLen);
-    memset(m_pDelayBuffer,0,sizeof(float)*m_attack * m_maxChannels);
-    memset(m_pMaxBufferSlow,0,sizeof(float)*m_nbrMaxBufferSection);
-    memset(m_pIndexMaxInSection,0,sizeof(int)*m_nbrMaxBufferSection);
-  
-  return LIMITER_OK;
-}
-
-
-/* destroy limiter */
-int PeakLimiter::destroyLimiter()
-{
-    if (m_pMaxBuffer)
-    {
-        delete [] m_pMaxBuffer;
-        m_pMaxBuffer = NULL;
-    }
-    if (m_pDelayBuffer)
-    {
-     delete [] m_pDelayBuffer;
-        m_pDelayBuffer = NULL;
-    }
-    if (m_pMaxBufferSlow)
-    {
-        delete [] m_pMaxBufferSlow;
-        m_pMaxBufferSlow = NULL;
-    }
-    if (m_pIndexMaxInSection)
-    {
-        delete [] m_pIndexMaxInSection;
-        m_pIndexMaxInSection = NULL;
-    }
-    
-    return LIMITER_OK;
-}
-
-/* apply limiter */
-int PeakLimiter::applyLimiter_E(const float *samplesIn,float *samplesOut, int nSamples)
-{
-	memcpy(samplesOut,samplesIn,nSamples*sizeof(float));
-	return applyLimiter_E_I(samplesOut,nSamples);
-}
-
-/* apply limiter */
-int PeakLimiter::applyLimiter_E_I(float *samples, int nSamples)
-{
-   int i, j;
-    float tmp, gain, maximum;
-
-    for (i = 0; i < nSamples; i++) {
-        /* get maximum absolute sample value of all channels that are greater in absoulte value to m_threshold */
-        m_pMaxBuffer[m_maxBufferIndex] = m_threshold;
-        for (j = 0; j < m_channels; j++) {
-            m_pMaxBuffer[m_maxBufferIndex] = max(m_pMaxBuffer[m_maxBufferIndex], (float)fabs(samples[i * m_channels + j]));
-        }
-
-        /* search maximum in the current section */
-        if (m_pIndexMaxInSection[m_maxBufferSlowIndex] == m_maxBufferIndex) // if we have just changed the sample containg the old maximum value
-        {
-            // need to compute the maximum on the whole section 
-            m_maxCurrentSection = m_pMaxBuffer[m_maxBufferSectionIndex];
-            for (j = 1; j < m_sectionLen; j++) {
-                if (m_pMaxBuffer[m_maxBufferSectionIndex + j] > m_maxCurrentSection)
-                {
-                    m_maxCurrentSection = m_pMaxBuffer[m_maxBufferSectionIndex + j];
-                    m_pIndexMaxInSection[m_maxBufferSlowIndex] = m_maxBufferSectionIndex + j;
-                }
-            }
-        }
-        else // just need to compare the new value the cthe current maximum value
-        {
-            if (m_pMaxBuffer[m_maxBufferIndex] > m_maxCurrentSection)
-            {
-                m_maxCurrentSection = m_pMaxBuffer[m_maxBufferIndex];
-                m_pIndexMaxInSection[m_maxBufferSlowIndex] = m_maxBufferIndex;
-            }
-        }
-
-        // find maximum of slow (downsampled) max buffer
-        maximum = m_maxMaxBufferSlow;
-        if (m_maxCurrentSection > maximum)
-        {
-            maximum = m_maxCurrentSection;
-        }
-
-        m_maxBufferIndex++;
-        m_maxBufferSectionCounter++;
-
-        /* if m_pMaxBuffer section is finished, or end of m_pMaxBuffer is reached,
-        store the maximum of this section and open up a new one */
-        if ((m_maxBufferSectionCounter >= m_sectionLen) || (m_maxBufferIndex >= m_attack + 1)) {
-            m_maxBufferSectionCounter = 0;
-
-            tmp = m_pMaxBufferSlow[m_maxBufferSlowIndex] = m_maxCurrentSection;
-            j = 0;
-            if (m_indexMaxBufferSlow == m_maxBufferSlowIndex)
-            {
-                j = 1;
-            }
-            m_maxBufferSlowIndex++;
-            if (m_maxBufferSlowIndex >= m_nbrMaxBufferSection)
-            {
-                m_maxBufferSlowIndex = 0;
-            }
-            if (m_indexMaxBufferSlow == m_maxBufferSlowIndex)
-            {
-                j = 1;
-            }
-            m_maxCurrentSection = m_pMaxBufferSlow[m_maxBufferSlowIndex];
-            m_pMaxBufferSlow[m_maxBufferSlowIndex] = 0.0f;  /* zero out the value representing the new section */
-
-            /* compute the maximum over all the section */
-            if (j)
-            {
-                m_maxMaxBufferSlow = 0;
-                for (j = 0; j < m_nbrMaxBufferSection; j++)
-                {
-                    if (m_pMaxBufferSlow[j] > m_maxMaxBufferSlow)
-                    {
-                        m_maxMaxBufferSlow = m_pMaxBufferSlow[j];
-                        m_indexMaxBufferSlow = j;
-                    }
-                }
-            }
-            else
-            {
-                if (tmp > m_maxMaxBufferSlow)
-                {
-                    m_maxMaxBufferSlow = tmp;
-                    m_indexMaxBufferSlow = m_maxBufferSlowIndex;
-                }
-            }
-
-            m_maxBufferSectionIndex += m_sectionLen;
-        }
-
-        if (m_maxBufferIndex >= (m_attack + 1))
-        {
-            m_maxBufferIndex = 0;
-            m_maxBufferSectionIndex = 0;
-        }
-
-        /* needed current gain */
-        if (maximum > m_threshold)
-        {
-            gain = m_threshold / maximum;
-        }
-        else
-        {
-            gain = 1;
-        }
-
-        /*avoid overshoot */
-
-        if (gain < m_smoothState) {
-            m_fadedGain = min(m_fadedGain, (gain - 0.1f * (float)m_smoothState) * 1.11111111f);
-        }
-        else
-        {
-            m_fadedGain = gain;
-        }
-
-
-        /* smoothing gain */
-        if (m_fadedGain < m_smoothState)
-        {
-            m_smoothState = m_attackConst * (m_smoothState - m_fadedGain) + m_fadedGain;  /* m_attack */
-            /*avoid overshoot */
-            if (gain > m_smoothState)
-            {
-                m_smoothState = gain;
-            }
-        }
-        else
-        {
-            m_smoothState = m_releaseConst * (m_smoothState - m_fadedGain) + m_fadedGain; /* release */
-        }
-
-        /* fill delay line, apply gain */
-        for (j = 0; j < m_channels; j++)
-        {
-            tmp = m_pDelayBuffer[m_delayBufferIndex * m_channels + j];
-            m_pDelayBuffer[m_delayBufferIndex * m_channels + j] = samples[i * m_channels + j];
-
-            tmp *= m_smoothState;
-            if (tmp > m_threshold) tmp = m_threshold;
-            if (tmp < -m_threshold) tmp = -m_threshold;
-
-            samples[i * m_channels + j] = tmp;
-        }
-
-        m_delayBufferIndex++;
-        if (m_delayBufferIndex >= m_attack)
-            m_delayBufferIndex = 0;
-
-    }
-
-    return LIMITER_OK;
-}
-
-/* apply limiter */
-int PeakLimiter::applyLimiter(const float **samplesIn,float **samplesOut, int nSamples)
-{
-	int ind;
-	for(ind=0;ind<m_channels;ind++)
-	{
-		memcpy(samplesOut[ind],samplesIn[ind],nSamples*sizeof(float));
-	}
-	return applyLimiter_I(samplesOut,nSamples);
-}
-
-
-/* apply limiter */
-int PeakLimiter::applyLimiter_I( float **samples,int nSamples)
-{
-   int i, j;
-    float tmp, gain, maximum;
-    
-    for (i = 0; i < nSamples; i++) {
-        /* get maximum absolute sample value of all channels that are greater in absoulte value to m_threshold */
-        m_pMaxBuffer[m_maxBufferIndex] = m_threshold;
-        for (j = 0; j < m_channels; j++) {
-            m_pMaxBuffer[m_maxBufferIndex] = max(m_pMaxBuffer[m_maxBufferIndex], (float)fabs(samples[j][i]));
-        }
-                
-        /* search maximum in the current section */
-        if (m_pIndexMaxInSection[m_maxBufferSlowIndex] == m_maxBufferIndex) // if we have just changed the sample containg the old maximum value
-        {
-            // need to compute the maximum on the whole section 
-            m_maxCurrentSection = m_pMaxBuffer[m_maxBufferSectionIndex];
-            for (j = 1; j < m_sectionLen; j++) {
-                if (m_pMaxBuffer[m_maxBufferSectionIndex + j] > m_maxCurrentSection)
-                {
-                    m_maxCurrentSection = m_pMaxBuffer[m_maxBufferSectionIndex + j];
-                    m_pIndexMaxInSection[m_maxBufferSlowIndex] = m_maxBufferSectionIndex+j;
-                }
-            }
-        }
-        else // just need to compare the new value the cthe current maximum value
-        {
-            if (m_pMaxBuffer[m_maxBufferIndex] > m_maxCurrentSection)
-            {
-                m_maxCurrentSection = m_pMaxBuffer[m_maxBufferIndex];
-                m_pIndexMaxInSection[m_maxBufferSlowIndex] = m_maxBufferIndex;
-            }
-        }
-        
-        // find maximum of slow (downsampled) max buffer
-        maximum = m_maxMaxBufferSlow;
-        if (m_maxCurrentSection > maximum)
-        {
-            maximum = m_maxCurrentSection;
-        }
-    
-        m_maxBufferIndex++;
-        m_maxBufferSectionCounter++;
-        
-        /* if m_pMaxBuffer section is finished, or end of m_pMaxBuffer is reached,
-         store the maximum of this section and open up a new one */
-        if ((m_maxBufferSectionCounter >= m_sectionLen)||(m_maxBufferIndex >= m_attack+1)) {
-            m_maxBufferSectionCounter = 0;
-            
-            tmp = m_pMaxBufferSlow[m_maxBufferSlowIndex] = m_maxCurrentSection;
-            j = 0;
-            if (m_indexMaxBufferSlow == m_maxBufferSlowIndex)
-            {
-                j = 1;
-            }
-            m_maxBufferSlowIndex++;
-            if (m_maxBufferSlowIndex >= m_nbrMaxBufferSection)
-            {
-                m_maxBufferSlowIndex = 0;
-            }
-            if (m_indexMaxBufferSlow == m_maxBufferSlowIndex)
-            {
-                j = 1;
-            }
-            m_maxCurrentSection = m_pMaxBufferSlow[m_maxBufferSlowIndex];
-            m_pMaxBufferSlow[m_maxBufferSlowIndex] = 0.0f;  /* zero out the value representing the new section */
-
-            /* compute the maximum over all the section */
-            if (j)
-            {
-                m_maxMaxBufferSlow = 0;
-                for (j = 0; j < m_nbrMaxBufferSection; j++)
-                {
-                    if (m_pMaxBufferSlow[j] > m_maxMaxBufferSlow)
-                    {
-                        m_maxMaxBufferSlow = m_pMaxBufferSlow[j];
-                        m_indexMaxBufferSlow = j;
-                    }
-                }
-            }
-            else
-            {
-                if (tmp > m_maxMaxBufferSlow)
-                {
-                    m_maxMaxBufferSlow = tmp;
-                    m_indexMaxBufferSlow = m_maxBufferSlowIndex;
-                }
-            }
-            
-            m_maxBufferSectionIndex += m_sectionLen;
-        }
-        
-        if (m_maxBufferIndex >= (m_attack+1))
-        {
-            m_maxBufferIndex = 0;
-            m_maxBufferSectionIndex = 0;
-        }
-        
-        /* needed current gain */
-        if (maximum > m_threshold)
-        {
-            gain = m_threshold / maximum;
-        }
-        else
-        {
-            gain = 1;
-        }
-        
-        /*avoid overshoot */
- 
-        if (gain < m_smoothState) {
-            m_fadedGain = min(m_fadedGain, (gain - 0.1f * (float)m_smoothState) * 1.11111111f);
-        }
-        else 
-        {
-            m_fadedGain = gain;
-        }
-
-
-        /* smoothing gain */
-        if (m_fadedGain < m_smoothState)
-        {
-            m_smoothState = m_attackConst * (m_smoothState - m_fadedGain) + m_fadedGain;  /* m_attack */
-            /*avoid overshoot */
-            if (gain > m_smoothState)
-            {
-                m_smoothState = gain;
-            }
-        }
-        else
-        {
-            m_smoothState = m_releaseConst * (m_smoothState - m_fadedGain) + m_fadedGain; /* release */
-        }
-        
-        /* fill delay line, apply gain */
-        for (j = 0; j < m_channels; j++)
-        {
-            tmp = m_pDelayBuffer[m_delayBufferIndex * m_channels + j];
-            m_pDelayBuffer[m_delayBufferIndex * m_channels + j] = samples[j][i];
-            
-            tmp *= m_smoothState;
-            if (tmp > m_threshold) tmp = m_threshold;
-            if (tmp < -m_threshold) tmp = -m_threshold;
-            
-            samples[j][i] = tmp;
-        }
-        
-        m_delayBufferIndex++;
-        if (m_delayBufferIndex >= m_attack)
-            m_delayBufferIndex = 0;
-        
-    }
-    
-    return LIMITER_OK;
-    
-}
-
-/* get delay in samples */
-int PeakLimiter::getLimiterDelay()
-{
-  return m_attack;
-}
-
-/* get m_attack in Ms */
-float PeakLimiter::getLimiterAttack()
-{
-  return m_attackMs;
-}
-
-/* get delay in samples */
-int PeakLimiter::getLimiterSampleRate()
-{
-	return m_sampleRate;
-}
-
-/* get delay in samples */
-float PeakLimiter::getLimiterRelease()
-{
-	return m_releaseMs;
-}
- 
-/* get maximum gain reduction of last processed block */
-float PeakLimiter::getLimiterMaxGainReduction()
-{
-  return -20 * (float)log10(m_smoothState);
-}
-
-/* set number of channels */
-int PeakLimiter::setLimiterNChannels(int nChannelsIn)
-{
-  if (nChannelsIn > m_maxChannels) return LIMITER_INVALID_PARAMETER;
-
-  m_channels = nChannelsIn;
-  resetLimiter();
-
-  return LIMITER_OK;
-}
-
-/* set sampling rate */
-int PeakLimiter::setLimiterSampleRate(int sampleRateIn)
-{
-  if (sampleRateIn > m_maxSampleRate) return LIMITER_INVALID_PARAMETER;
-
-  /* update m_attack/release constants */
-  m_attack = (int)(m_attackMs * sampleRateIn / 1000);
-
-  if (m_attack < 1) /* m_attack time is too short */
-    return LIMITER_INVALID_PARAMETER; 
-
-  /* length of m_pMaxBuffer sections */
-  m_sectionLen = (int)sqrt((float)m_attack+1);
-
-  m_nbrMaxBufferSection    = (m_attack+1)/m_sectionLen;
-  if (m_nbrMaxBufferSection*m_sectionLen < (m_attack+1))
-    m_nbrMaxBufferSection++;
-  m_attackConst   = (float)pow(0.1, 1.0 / (m_attack + 1));
-  m_releaseConst  = (float)pow(0.1, 1.0 / (m_releaseMs * sampleRateIn / 1000 + 1));
-  m_sampleRate    = sampleRateIn;
-
-  /* reset */
-  resetLimiter();
-
-  return LIMITER_OK;
-}
-
-/* set m_attack time */
-int PeakLimiter::setLimiterAttack(float attackMsIn)
-{
-  if (attackMsIn > m_maxAttackMs) return LIMITER_INVALID_PARAMETER;
-
-  /* calculate attack time in samples */
-  m_attack = (int)(attackMsIn * m_sampleRate / 1000);
-
-  if (m_attack < 1) /* attack time is too short */
-    m_attack=1;
-
-  /* length of m_pMaxBuffer sections */
-  m_sectionLen = (int)sqrt((float)m_attack+1);
-
-  m_nbrMaxBufferSection   = (m_attack+1)/m_sectionLen;
-  if (m_nbrMaxBufferSection*m_sectionLen < (m_attack+1))
-    m_nbrMaxBufferSection++;
-  m_attackConst  = (float)pow(0.1, 1.0 / (m_attack + 1));
-  m_attackMs     = attackMsIn;
-
-  /* reset */
-  resetLimiter();
-
-  return LIMITER_OK;
-}
-
-/* set release time */
-int PeakLimiter::setLimiterRelease(float releaseMsIn)
-{ 
-  m_releaseConst = (float)pow(0.1, 1.0 / (releaseMsIn * m_sampleRate / 1000 + 1));
-  m_releaseMs = releaseMsIn;
-
-  return LIMITER_OK;
-}
-
-/* set limiter threshold */
-int PeakLimiter::setLimiterThreshold(float thresholdIn)
-{
-  m_threshold = thresholdIn;
-
-  return LIMITER_OK;
-}
-
-/* set limiter threshold */
-float PeakLimiter::getLimiterThreshold()
-{
-  return m_threshold;
-}
-
-
+/*
+Copyright (c) 2016, UMR STMS 9912 - Ircam-Centre Pompidou / CNRS / UPMC
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the <organization> nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "peakLimiter.h"
+
+#include <algorithm>
+#include <chrono>
+#include <new>
+
+#ifndef max
+#define max(a, b)   (((a) > (b)) ? (a) : (b))
+#endif
+#ifndef min
+#define min(a, b)   (((a) < (b)) ? (a) : (b))
+#endif
+
+#define PEAKLIMITER_PARAMS_NEW   (4)   /* flag of m_paramsMiddle, new parameters in the middle slot */
+
+/* add n to a counter of m_stats, nothing at all (not even n) is evaluated without PEAKLIMITER_STATS */
+#if PEAKLIMITER_STATS
+#define PEAKLIMITER_COUNT(counter, n)   (m_stats.counter += (n))
+#else
+#define PEAKLIMITER_COUNT(counter, n)   ((void)0)
+#endif
+
+/* size of a state buffer rounded up to whole cache lines */
+static size_t alignSize(size_t size)
+{
+  return (size + PEAKLIMITER_ALIGN - 1) & ~(size_t)(PEAKLIMITER_ALIGN - 1);
+}
+
+/* place the buffers of a limiter in one block: each buffer starts on a cache line,
+   the ones used for every block first, then the state of the channel groups 1 to
+   maxChannels-1. With memory NULL, only returns the size */
+size_t PeakLimiter::layoutMemory(PeakLimiter* limiter, char* memory, int attack, int maxChannels, int maxEngine)
+{
+  int g, sectionLen, nbrMaxBufferSection, vhgwBlockLen;
+  size_t offset = 0;
+  size_t offsetPeak, offsetGain, offsetTruePeakBuffer, offsetMeter, offsetTruePeakHistory;
+  size_t offsetDelay, offsetMax, offsetMaxSlow, offsetIndexMax, offsetPeakHistory, offsetVhgwValues, offsetVhgwSuffix;
+  size_t offsetGroups, offsetChannelGroup, offsetChannelPeak, offsetChannelGain;
+  PeakLimiterGroup* group;
+
+  sectionLen = (int)sqrt((float)attack+1);
+  nbrMaxBufferSection = (attack+1)/sectionLen;
+  if (nbrMaxBufferSection*sectionLen < (attack+1))
+    nbrMaxBufferSection++;
+  vhgwBlockLen = (attack+1)/2;
+
+  offsetPeak            = offset; offset += alignSize(sizeof(float) * PEAKLIMITER_BLOCK_SIZE);
+  offsetGain            = offset; offset += alignSize(sizeof(float) * PEAKLIMITER_BLOCK_SIZE);
+  offsetTruePeakBuffer  = offset; offset += alignSize(sizeof(float) * ((PEAKLIMITER_TRUEPEAK_TAPS-1) + PEAKLIMITER_BLOCK_SIZE));
+  offsetMeter           = offset; offset += alignSize(sizeof(float) * PEAKLIMITER_BLOCK_SIZE);
+  offsetTruePeakHistory = offset; offset += alignSize(sizeof(float) * (PEAKLIMITER_TRUEPEAK_TAPS-1) * maxChannels);
+  offsetDelay           = offset; offset += alignSize(sizeof(float) * attack * maxChannels);
+  offsetMax             = offset; offset += alignSize(sizeof(float) * nbrMaxBufferSection * sectionLen);
+  offsetMaxSlow         = offset; offset += alignSize(sizeof(float) * nbrMaxBufferSection);
+  offsetIndexMax        = offset; offset += alignSize(sizeof(int) * nbrMaxBufferSection);
+  offsetPeakHistory     = offset; offset += alignSize(sizeof(float) * (attack+1));
+  offsetVhgwValues      = offset;
+  offsetVhgwSuffix      = offset;
+  if (maxEngine == PEAKLIMITER_MAX_VHGW) {
+    offsetVhgwValues    = offset; offset += alignSize(sizeof(float) * 2 * vhgwBlockLen);
+    offsetVhgwSuffix    = offset; offset += alignSize(sizeof(float) * 2 * vhgwBlockLen);
+  }
+  offsetGroups          = offset; offset += alignSize(sizeof(PeakLimiterGroup) * maxChannels);
+  offsetChannelGroup    = offset; offset += alignSize(sizeof(int) * maxChannels);
+  offsetChannelPeak     = offset; offset += alignSize(sizeof(float*) * maxChannels);
+  offsetChannelGain     = offset; offset += alignSize(sizeof(float*) * maxChannels);
+
+  if (limiter != NULL) {
+    limiter->m_sectionLen          = sectionLen;
+    limiter->m_nbrMaxBufferSection = nbrMaxBufferSection;
+    limiter->m_vhgwBlockLen        = vhgwBlockLen;
+    limiter->m_pPeakBuffer         = (float*)(memory + offsetPeak);
+    limiter->m_pGainBuffer         = (float*)(memory + offsetGain);
+    limiter->m_pTruePeakBuffer     = (float*)(memory + offsetTruePeakBuffer);
+    limiter->m_pMeterBuffer        = (float*)(memory + offsetMeter);
+    limiter->m_pTruePeakHistory    = (float*)(memory + offsetTruePeakHistory);
+    limiter->m_pDelayBuffer        = (float*)(memory + offsetDelay);
+    limiter->m_pMaxBuffer          = (float*)(memory + offsetMax);
+    limiter->m_pMaxBufferSlow      = (float*)(memory + offsetMaxSlow);
+    limiter->m_pIndexMaxInSection  = (int*)(memory + offsetIndexMax);
+    limiter->m_pPeakHistory        = (float*)(memory + offsetPeakHistory);
+    limiter->m_pVhgwValues         = NULL;
+    limiter->m_pVhgwSuffix         = NULL;
+    if (maxEngine == PEAKLIMITER_MAX_VHGW) {
+      limiter->m_pVhgwValues       = (float*)(memory + offsetVhgwValues);
+      limiter->m_pVhgwSuffix       = (float*)(memory + offsetVhgwSuffix);
+    }
+    limiter->m_pGroups             = (PeakLimiterGroup*)(memory + offsetGroups);
+    limiter->m_pChannelGroup       = (int*)(memory + offsetChannelGroup);
+    limiter->m_ppChannelPeak       = (float**)(memory + offsetChannelPeak);
+    limiter->m_ppChannelGain       = (const float**)(memory + offsetChannelGain);
+  }
+
+  /* maximum search and block buffers of each group, with the offsets of the ones above */
+  for (g = 1; g < maxChannels; g++) {
+    offsetPeak          = offset; offset += alignSize(sizeof(float) * PEAKLIMITER_BLOCK_SIZE);
+    offsetGain          = offset; offset += alignSize(sizeof(float) * PEAKLIMITER_BLOCK_SIZE);
+    offsetMax           = offset; offset += alignSize(sizeof(float) * nbrMaxBufferSection * sectionLen);
+    offsetMaxSlow       = offset; offset += alignSize(sizeof(float) * nbrMaxBufferSection);
+    offsetIndexMax      = offset; offset += alignSize(sizeof(int) * nbrMaxBufferSection);
+    offsetVhgwValues    = offset;
+    offsetVhgwSuffix    = offset;
+    if (maxEngine == PEAKLIMITER_MAX_VHGW) {
+      offsetVhgwValues  = offset; offset += alignSize(sizeof(float) * 2 * vhgwBlockLen);
+      offsetVhgwSuffix  = offset; offset += alignSize(sizeof(float) * 2 * vhgwBlockLen);
+    }
+
+    if (limiter != NULL) {
+      group = &limiter->m_pGroups[g];
+      group->pPeakBuffer        = (float*)(memory + offsetPeak);
+      group->pGainBuffer        = (float*)(memory + offsetGain);
+      group->pMaxBuffer         = (float*)(memory + offsetMax);
+      group->pMaxBufferSlow     = (float*)(memory + offsetMaxSlow);
+      group->pIndexMaxInSection = (int*)(memory + offsetIndexMax);
+      group->pVhgwValues        = NULL;
+      group->pVhgwSuffix        = NULL;
+      if (maxEngine == PEAKLIMITER_MAX_VHGW) {
+        group->pVhgwValues      = (float*)(memory + offsetVhgwValues);
+        group->pVhgwSuffix      = (float*)(memory + offsetVhgwSuffix);
+      }
+    }
+  }
+
+  /* room to align the start of the block */
+  return offset + PEAKLIMITER_ALIGN;
+}
+
+/* size of the state of a limiter */
+size_t PeakLimiter::getLimiterMemorySize(
+                           float         maxAttackMsIn,
+                           int  maxChannelsIn,
+                           int  maxSampleRateIn,
+                           int  maxEngineIn
+                           )
+{
+  int attack = (int)(maxAttackMsIn * maxSampleRateIn / 1000);
+
+  if (attack < 1)
+    attack = 1;
+
+  return layoutMemory(NULL, NULL, attack, maxChannelsIn, maxEngineIn);
+}
+
+/* create limiter */
+ PeakLimiter::PeakLimiter(
+                           float         maxAttackMsIn,
+                           float         releaseMsIn,
+                           float         thresholdIn,
+                           int  maxChannelsIn,
+                           int  maxSampleRateIn,
+                           int  maxEngineIn,
+                           void*         memoryIn,
+                           size_t        memorySizeIn
+                           )
+{
+  size_t memorySize;
+
+  /* calc m_attack time in samples */
+  m_attack = (int)(maxAttackMsIn * maxSampleRateIn / 1000);
+
+  if (m_attack < 1) /* m_attack time is too short */
+	  m_attack = 1; 
+  m_zeroLookahead = (maxAttackMsIn == 0);   /* the delay line and maximum keep 1 sample */
+
+  /* m_pMaxBuffer is split in sections of sqrt(m_attack+1) samples, this leads
+     to the minimum of the number of maximum operators:
+     nMaxOp = m_sectionLen + (m_attack+1)/m_sectionLen.
+     van Herk/Gil-Werman blocks: two blocks of values being written/scanned,
+     two blocks of suffix maxima being computed/used */
+  m_maxEngine     = maxEngineIn;
+  m_pMeterRing    = NULL;
+  m_nGroups       = 1;
+  m_pGroups       = NULL;
+  m_pChannelGroup = NULL;
+  m_ppChannelGain = NULL;
+  m_ppChannelPeak = NULL;
+  m_timingSeq     = 0;
+  setLimiterTiming(0);
+  m_flushDenormals = 1;
+  m_flushSoftware  = 0;
+  memset(&m_stats, 0, sizeof(m_stats));
+
+  /* alloc limiter state, a single block */
+  m_pMemory       = NULL;
+  m_pMemoryBlock  = NULL;
+  memorySize      = layoutMemory(NULL, NULL, m_attack, maxChannelsIn, m_maxEngine);
+  if (memoryIn == NULL) {
+    m_pMemoryBlock = new (std::nothrow) char[memorySize];
+    memoryIn       = m_pMemoryBlock;
+  }
+  else if (memorySizeIn < memorySize) {
+    memoryIn       = NULL;
+  }
+
+  if (memoryIn == NULL) {
+    destroyLimiter();
+    return;
+  }
+  m_pMemory = (char*)(((uintptr_t)memoryIn + PEAKLIMITER_ALIGN - 1) & ~(uintptr_t)(PEAKLIMITER_ALIGN - 1));
+  memset(m_pMemory, 0, memorySize - PEAKLIMITER_ALIGN);
+  layoutMemory(this, m_pMemory, m_attack, maxChannelsIn, m_maxEngine);
+
+  /* init parameters & states */
+  m_maxBufferIndex = 0;
+  m_delayBufferIndex = 0;
+  m_maxBufferSlowIndex = 0;
+  m_maxBufferSectionIndex = 0;
+  m_maxBufferSectionCounter = 0;
+  m_maxMaxBufferSlow = 0;
+  m_indexMaxBufferSlow = 0;
+  m_maxCurrentSection = 0;
+  m_vhgwIndex = 0;
+  m_vhgwBlock = 0;
+  m_vhgwPrefixMax = 0;
+  m_vhgwLastBlockMax = 0;
+  m_lastMaximum = 0;
+  m_delayUnchecked = 0;
+
+  m_attackMs      = maxAttackMsIn;
+  m_maxAttackMs   = maxAttackMsIn;
+  m_releaseMs     = releaseMsIn;
+  m_attackConst   = (float)pow(0.1, 1.0 / (m_attack + 1));
+  m_releaseConst  = (float)pow(0.1, 1.0 / (m_releaseMs * maxSampleRateIn / 1000 + 1));
+  m_threshold     = thresholdIn;
+  m_channels      = maxChannelsIn;
+  m_maxChannels   = maxChannelsIn;
+  m_sampleRate    = maxSampleRateIn;
+  m_maxSampleRate = maxSampleRateIn;
+  m_pKernels      = getPeakLimiterKernels(PEAKLIMITER_ISA_BEST);
+  m_processingMode = PEAKLIMITER_PROCESS_SAMPLE;
+  m_truePeak      = 0;
+  selectProcess();
+
+  /* parameter handoff: back, middle and front slots */
+  m_paramsBack    = 0;
+  m_paramsMiddle  = 1;
+  m_paramsFront   = 2;
+
+  m_minGain       = 1.0f;
+  m_meterPendingValid = 0;
+  m_meterPosition = 0;
+    
+
+  m_fadedGain = 1.0f;
+  m_smoothState = 1.0;
+}
+
+PeakLimiter::~PeakLimiter()
+{
+    destroyLimiter();
+}
+
+/* reset limiter */
+int PeakLimiter::resetLimiter()
+{
+    int g;
+ 
+    m_delayBufferIndex = 0;
+    m_fadedGain = 1.0f;
+    m_smoothState = 1.0;
+    m_minGain = 1.0f;
+    m_delayUnchecked = 0;
+
+    memset(m_pDelayBuffer,0,sizeof(float)*m_attack * m_maxChannels);
+    memset(m_pTruePeakHistory,0,sizeof(float)*(PEAKLIMITER_TRUEPEAK_TAPS-1) * m_maxChannels);
+    resetMax();
+
+    for (g = 1; g < m_nGroups; g++) {
+      swapGroup(g);
+      m_fadedGain = 1.0f;
+      m_smoothState = 1.0;
+      resetMax();
+      swapGroup(g);
+    }
+  
+  return LIMITER_OK;
+}
+
+/* reset the lookahead maximum search only */
+void PeakLimiter::resetMax()
+{
+    m_maxBufferIndex = 0;
+    m_maxBufferSlowIndex = 0;
+    m_maxBufferSectionIndex = 0;
+    m_maxBufferSectionCounter = 0;
+    m_maxMaxBufferSlow = 0;
+    m_indexMaxBufferSlow = 0;
+    m_maxCurrentSection = 0;
+    m_vhgwIndex = 0;
+    m_vhgwBlock = 0;
+    m_vhgwPrefixMax = 0;
+    m_vhgwLastBlockMax = 0;
+    m_lastMaximum = 0;
+
+    memset(m_pMaxBuffer,0,sizeof(float)*m_nbrMaxBufferSection * m_sectionLen);
+    memset(m_pMaxBufferSlow,0,sizeof(float)*m_nbrMaxBufferSection);
+    memset(m_pIndexMaxInSection,0,sizeof(int)*m_nbrMaxBufferSection);
+    if (m_maxEngine == PEAKLIMITER_MAX_VHGW) {
+      memset(m_pVhgwValues,0,sizeof(float)*2*m_vhgwBlockLen);
+      memset(m_pVhgwSuffix,0,sizeof(float)*2*m_vhgwBlockLen);
+    }
+}
+
+
+/* destroy limiter */
+int PeakLimiter::destroyLimiter()
+{
+    /* the buffers all live in the state block */
+    if (m_pMemoryBlock)
+    {
+        delete [] m_pMemoryBlock;
+        m_pMemoryBlock = NULL;
+    }
+    m_pMemory = NULL;
+    m_pMaxBuffer = m_pDelayBuffer = m_pMaxBufferSlow = m_pPeakBuffer = m_pGainBuffer = NULL;
+    m_pTruePeakHistory = m_pTruePeakBuffer = m_pPeakHistory = m_pMeterBuffer = NULL;
+    m_pVhgwValues = m_pVhgwSuffix = NULL;
+    m_pIndexMaxInSection = NULL;
+    m_pGroups = NULL;
+    m_pChannelGroup = NULL;
+    m_ppChannelPeak = NULL;
+    m_ppChannelGain = NULL;
+    m_nGroups = 1;
+    if (m_pMeterRing)
+    {
+        delete m_pMeterRing;
+        m_pMeterRing = NULL;
+    }
+    
+    return LIMITER_OK;
+}
+
+/* push the peak of one sample into the maximum buffer sections,
+   returns the maximum over the last m_attack+1 samples */
+inline float PeakLimiter::updateMaxSections(float peak)
+{
+   int j;
+    float tmp, maximum;
+
+    m_pMaxBuffer[m_maxBufferIndex] = peak;
+
+    /* search maximum in the current section */
+    if (m_pIndexMaxInSection[m_maxBufferSlowIndex] == m_maxBufferIndex) // if we have just changed the sample containg the old maximum value
+    {
+        // need to compute the maximum on the whole section 
+        PEAKLIMITER_COUNT(sectionRescans, 1);
+        PEAKLIMITER_COUNT(sectionRescanSamples, m_sectionLen);
+        m_maxCurrentSection = m_pMaxBuffer[m_maxBufferSectionIndex];
+        for (j = 1; j < m_sectionLen; j++) {
+            if (m_pMaxBuffer[m_maxBufferSectionIndex + j] > m_maxCurrentSection)
+            {
+                m_maxCurrentSection = m_pMaxBuffer[m_maxBufferSectionIndex + j];
+                m_pIndexMaxInSection[m_maxBufferSlowIndex] = m_maxBufferSectionIndex + j;
+            }
+        }
+    }
+    else // just need to compare the new value the cthe current maximum value
+    {
+        if (m_pMaxBuffer[m_maxBufferIndex] > m_maxCurrentSection)
+        {
+            m_maxCurrentSection = m_pMaxBuffer[m_maxBufferIndex];
+            m_pIndexMaxInSection[m_maxBufferSlowIndex] = m_maxBufferIndex;
+        }
+    }
+
+    // find maximum of slow (downsampled) max buffer
+    maximum = m_maxMaxBufferSlow;
+    if (m_maxCurrentSection > maximum)
+    {
+        maximum = m_maxCurrentSection;
+    }
+
+    m_maxBufferIndex++;
+    m_maxBufferSectionCounter++;
+
+    /* if m_pMaxBuffer section is finished, or end of m_pMaxBuffer is reached,
+    store the maximum of this section and open up a new one */
+    if ((m_maxBufferSectionCounter >= m_sectionLen) || (m_maxBufferIndex >= m_attack + 1)) {
+        m_maxBufferSectionCounter = 0;
+
+        tmp = m_pMaxBufferSlow[m_maxBufferSlowIndex] = m_maxCurrentSection;
+        j = 0;
+        if (m_indexMaxBufferSlow == m_maxBufferSlowIndex)
+        {
+            j = 1;
+        }
+        m_maxBufferSlowIndex++;
+        if (m_maxBufferSlowIndex >= m_nbrMaxBufferSection)
+        {
+            m_maxBufferSlowIndex = 0;
+        }
+        if (m_indexMaxBufferSlow == m_maxBufferSlowIndex)
+        {
+            j = 1;
+        }
+        m_maxCurrentSection = m_pMaxBufferSlow[m_maxBufferSlowIndex];
+        m_pMaxBufferSlow[m_maxBufferSlowIndex] = 0.0f;  /* zero out the value representing the new section */
+
+        /* compute the maximum over all the section */
+        if (j)
+        {
+            PEAKLIMITER_COUNT(slowRescans, 1);
+            PEAKLIMITER_COUNT(slowRescanSections, m_nbrMaxBufferSection);
+            m_maxMaxBufferSlow = 0;
+            for (j = 0; j < m_nbrMaxBufferSection; j++)
+            {
+                if (m_pMaxBufferSlow[j] > m_maxMaxBufferSlow)
+                {
+                    m_maxMaxBufferSlow = m_pMaxBufferSlow[j];
+                    m_indexMaxBufferSlow = j;
+                }
+            }
+        }
+        else
+        {
+            if (tmp > m_maxMaxBufferSlow)
+            {
+                m_maxMaxBufferSlow = tmp;
+                m_indexMaxBufferSlow = m_maxBufferSlowIndex;
+            }
+        }
+
+        m_maxBufferSectionIndex += m_sectionLen;
+    }
+
+    if (m_maxBufferIndex >= (m_attack + 1))
+    {
+        m_maxBufferIndex = 0;
+        m_maxBufferSectionIndex = 0;
+    }
+
+    return maximum;
+}
+
+/* push the peak of one sample into the van Herk/Gil-Werman blocks,
+   returns the maximum over the last m_attack+1 samples.
+   With blocks of b = (m_attack+1)/2 samples, the window always covers the whole
+   previous block, the start of the current one and the end of the one before:
+   the suffix maxima of the latter are computed one per sample while the previous
+   block is being filled, so the cost is the same for every sample */
+inline float PeakLimiter::updateMaxVhgw(float peak)
+{
+    int first;
+    float *values, *lastValues, *suffix, *lastSuffix;
+    float maximum;
+
+    values     = m_pVhgwValues + m_vhgwBlock * m_vhgwBlockLen;
+    lastValues = m_pVhgwValues + (1 - m_vhgwBlock) * m_vhgwBlockLen;
+    suffix     = m_pVhgwSuffix + m_vhgwBlock * m_vhgwBlockLen;        /* suffix maxima of the block before the previous one */
+    lastSuffix = m_pVhgwSuffix + (1 - m_vhgwBlock) * m_vhgwBlockLen;  /* suffix maxima of the previous block, in progress */
+
+    values[m_vhgwIndex] = peak;
+    m_vhgwPrefixMax = max(m_vhgwPrefixMax, peak);
+
+    /* one more suffix maximum of the previous block */
+    first = m_vhgwBlockLen - 1 - m_vhgwIndex;
+    if (m_vhgwIndex == 0)
+        lastSuffix[first] = lastValues[first];
+    else
+        lastSuffix[first] = max(lastValues[first], lastSuffix[first + 1]);
+
+    /* window = end of the block before the previous one (empty when the window is
+       exactly two blocks long and the current block is full), previous block, current block */
+    maximum = max(m_vhgwLastBlockMax, m_vhgwPrefixMax);
+    first = m_vhgwIndex + 2 * m_vhgwBlockLen - m_attack;
+    if (first < m_vhgwBlockLen)
+        maximum = max(maximum, suffix[first]);
+
+    m_vhgwIndex++;
+    if (m_vhgwIndex >= m_vhgwBlockLen) {
+        m_vhgwIndex = 0;
+        m_vhgwBlock = 1 - m_vhgwBlock;
+        m_vhgwLastBlockMax = m_vhgwPrefixMax;
+        m_vhgwPrefixMax = 0;
+    }
+
+    return maximum;
+}
+
+/* push the peak of one sample into the maximum search and update the gain */
+inline float PeakLimiter::updateGain(float peak)
+{
+    float gain, maximum, release;
+
+    if (m_maxEngine == PEAKLIMITER_MAX_VHGW)
+        maximum = updateMaxVhgw(peak);
+    else
+        maximum = updateMaxSections(peak);
+    m_lastMaximum = maximum;
+
+    /* needed current gain */
+    if (maximum > m_threshold)
+    {
+        gain = m_threshold / maximum;
+    }
+    else
+    {
+        gain = 1;
+    }
+
+    /*avoid overshoot */
+
+    if (gain < m_smoothState) {
+        m_fadedGain = min(m_fadedGain, (gain - 0.1f * (float)m_smoothState) * 1.11111111f);
+    }
+    else
+    {
+        m_fadedGain = gain;
+    }
+
+
+    /* smoothing gain */
+    if (m_fadedGain < m_smoothState)
+    {
+        m_smoothState = m_attackConst * (m_smoothState - m_fadedGain) + m_fadedGain;  /* m_attack */
+        /*avoid overshoot */
+        if (gain > m_smoothState)
+        {
+            m_smoothState = gain;
+        }
+    }
+    else
+    {
+        release = m_releaseConst * (m_smoothState - m_fadedGain) + m_fadedGain; /* release */
+        /* the release stalls short of its target once a step is below float precision:
+           settle there, so that the gain gets back to exactly 1 */
+        m_smoothState = (release == m_smoothState) ? m_fadedGain : release;
+    }
+
+    return m_smoothState;
+}
+
+/******************************************************************************
+* processing kernels                                                          *
+* one instance per sample format, buffer layout and number of channels,       *
+* NCHANNELS == 0 being the generic version that reads m_channels              *
+******************************************************************************/
+
+enum {
+  PEAKLIMITER_FLOAT32 = 0,
+  PEAKLIMITER_INT16,
+  PEAKLIMITER_INT24,
+  PEAKLIMITER_INT32,
+
+  PEAKLIMITER_NBR_FORMATS
+};
+
+/* kernels for one number of channels, selected by setLimiterNChannels */
+struct PeakLimiterProcess
+{
+    int (PeakLimiter::*interleaved[PEAKLIMITER_NBR_FORMATS])(const void* samplesIn, void* samplesOut, int nSamples);
+    int (PeakLimiter::*planar[PEAKLIMITER_NBR_FORMATS])(const void* const* samplesIn, void* const* samplesOut, int nSamples);
+};
+
+/* sample formats: WIDTH Sample elements per audio sample, converted to and from
+   float full scale [-1, 1[ on the fly, the output being saturated to the integer range */
+struct PeakLimiterFloat32
+{
+    typedef float Sample;
+    enum { WIDTH = 1 };
+
+    static inline float load(const float* p) { return *p; }
+    static inline void store(float* p, float x) { *p = x; }
+};
+
+struct PeakLimiterInt16
+{
+    typedef int16_t Sample;
+    enum { WIDTH = 1 };
+
+    static inline float load(const int16_t* p) { return (float)*p * (1.0f / 32768.0f); }
+    static inline void store(int16_t* p, float x)
+    {
+        long v = lrintf(x * 32768.0f);
+        *p = (int16_t)((v > 32767) ? 32767 : ((v < -32768) ? -32768 : v));
+    }
+};
+
+/* packed little endian 24 bit */
+struct PeakLimiterInt24
+{
+    typedef uint8_t Sample;
+    enum { WIDTH = 3 };
+
+    static inline float load(const uint8_t* p)
+    {
+        int32_t v = (int32_t)(((uint32_t)p[0] << 8) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 24)) >> 8;
+        return (float)v * (1.0f / 8388608.0f);
+    }
+    static inline void store(uint8_t* p, float x)
+    {
+        long v = lrintf(x * 8388608.0f);
+        v = (v > 8388607) ? 8388607 : ((v < -8388608) ? -8388608 : v);
+        p[0] = (uint8_t)(v & 0xff);
+        p[1] = (uint8_t)((v >> 8) & 0xff);
+        p[2] = (uint8_t)((v >> 16) & 0xff);
+    }
+};
+
+struct PeakLimiterInt32
+{
+    typedef int32_t Sample;
+    enum { WIDTH = 1 };
+
+    static inline float load(const int32_t* p) { return (float)*p * (1.0f / 2147483648.0f); }
+    static inline void store(int32_t* p, float x)
+    {
+        double v = (double)x * 2147483648.0;
+        *p = (v >= 2147483647.0) ? 2147483647 : ((v <= -2147483648.0) ? (-2147483647 - 1) : (int32_t)lrint(v));
+    }
+};
+
+/* frames of at least 8 channels fill a whole SIMD register, below that
+   the unrolled scalar code is faster than a call to the SIMD kernels */
+#define PEAKLIMITER_SIMD_MIN_CHANNELS (8)
+
+/* one frame of contiguous samples */
+template <class Format, int NCHANNELS>
+struct PeakLimiterFrame
+{
+    typedef typename Format::Sample Sample;
+
+    /* maximum absolute value */
+    static inline float maxAbs(const PeakLimiterKernels*, const Sample* frame, int nChannels, float threshold)
+    {
+        int j;
+        float tmp, maximum;
+
+        if (NCHANNELS > 0)
+            nChannels = NCHANNELS;
+
+        maximum = threshold;
+        for (j = 0; j < nChannels; j++) {
+            tmp = (float)fabs(Format::load(frame + j * Format::WIDTH));
+            maximum = (maximum > tmp) ? maximum : tmp;
+        }
+        return maximum;
+    }
+
+    /* push the frame into the delay line, apply gain to the delayed frame */
+    static inline void applyGain(const PeakLimiterKernels*, const Sample* in, Sample* out, float* delay, int nChannels,
+                                 float gain, float threshold)
+    {
+        int j;
+        float tmp;
+
+        if (NCHANNELS > 0)
+            nChannels = NCHANNELS;
+
+        for (j = 0; j < nChannels; j++) {
+            tmp = delay[j];
+            delay[j] = Format::load(in + j * Format::WIDTH);
+
+            tmp *= gain;
+            if (tmp > threshold) tmp = threshold;
+            if (tmp < -threshold) tmp = -threshold;
+
+            Format::store(out + j * Format::WIDTH, tmp);
+        }
+    }
+};
+
+/* float frames go through the SIMD kernels unless they are short and unrolled */
+template <int NCHANNELS>
+struct PeakLimiterFrame<PeakLimiterFloat32, NCHANNELS>
+{
+    static inline float maxAbs(const PeakLimiterKernels* kernels, const float* frame, int nChannels, float threshold)
+    {
+        int j;
+        float tmp, maximum;
+
+        if ((NCHANNELS == 0) || (NCHANNELS >= PEAKLIMITER_SIMD_MIN_CHANNELS))
+            return kernels->maxAbs(frame, (NCHANNELS > 0) ? NCHANNELS : nChannels, threshold);
+
+        maximum = threshold;
+        for (j = 0; j < NCHANNELS; j++) {
+            tmp = (float)fabs(frame[j]);
+            maximum = (maximum > tmp) ? maximum : tmp;
+        }
+        return maximum;
+    }
+
+    static inline void applyGain(const PeakLimiterKernels* kernels, const float* in, float* out, float* delay, int nChannels,
+                                 float gain, float threshold)
+    {
+        int j;
+        float tmp;
+
+        if ((NCHANNELS == 0) || (NCHANNELS >= PEAKLIMITER_SIMD_MIN_CHANNELS)) {
+            kernels->applyGain(in, out, delay, (NCHANNELS > 0) ? NCHANNELS : nChannels, gain, threshold);
+            return;
+        }
+
+        for (j = 0; j < NCHANNELS; j++) {
+            tmp = delay[j];
+            delay[j] = in[j];
+
+            tmp *= gain;
+            if (tmp > threshold) tmp = threshold;
+            if (tmp < -threshold) tmp = -threshold;
+
+            out[j] = tmp;
+        }
+    }
+};
+
+/* maximum absolute value over the channels of a planar buffer, sample by sample */
+template <class Format>
+static inline void maxAbsPlanar(const PeakLimiterKernels*, const typename Format::Sample* const* in, int nChannels,
+                                int offset, int nSamples, float threshold, float* peak)
+{
+    int i, j;
+    float tmp;
+
+    for (i = 0; i < nSamples; i++)
+        peak[i] = threshold;
+
+    for (j = 0; j < nChannels; j++) {
+        const typename Format::Sample* x = in[j] + offset * Format::WIDTH;
+        for (i = 0; i < nSamples; i++) {
+            tmp = (float)fabs(Format::load(x + i * Format::WIDTH));
+            peak[i] = (peak[i] > tmp) ? peak[i] : tmp;
+        }
+    }
+}
+
+/* the float channel buffers are contiguous, so the detector is vectorised along the samples */
+template <>
+inline void maxAbsPlanar<PeakLimiterFloat32>(const PeakLimiterKernels* kernels, const float* const* in, int nChannels,
+                                             int offset, int nSamples, float threshold, float* peak)
+{
+    kernels->maxAbsPlanar(in, nChannels, offset, nSamples, threshold, peak);
+}
+
+/* contiguous run of n samples through the delay line at gain 1 */
+template <class Format>
+static inline void delayRun(const typename Format::Sample* x, typename Format::Sample* y, float* delay, int n)
+{
+    int k;
+    float tmp;
+
+    for (k = 0; k < n; k++) {
+        tmp = delay[k];
+        delay[k] = Format::load(x + k * Format::WIDTH);
+        Format::store(y + k * Format::WIDTH, tmp);
+    }
+}
+
+/* float samples are copied as they are: two block copies out of place, a swap in place */
+template <>
+inline void delayRun<PeakLimiterFloat32>(const float* x, float* y, float* delay, int n)
+{
+    int k;
+    float tmp;
+
+    if (x != y) {
+        memcpy(y, delay, sizeof(float) * n);
+        memcpy(delay, x, sizeof(float) * n);
+        return;
+    }
+    for (k = 0; k < n; k++) {
+        tmp = delay[k];
+        delay[k] = x[k];
+        y[k] = tmp;
+    }
+}
+
+/* interleaved buffers: frame i starts at in[i * nChannels] and out[i * nChannels],
+   out may be the same buffer as in */
+template <class Format>
+struct PeakLimiterInterleaved
+{
+    typedef typename Format::Sample Sample;
+
+    const Sample* in;
+    Sample*       out;
+
+    template <int NCHANNELS>
+    inline void detect(const PeakLimiterKernels* kernels, int offset, int nSamples, int nChannels,
+                       float threshold, float* peak) const
+    {
+        int i;
+        for (i = 0; i < nSamples; i++)
+            peak[i] = PeakLimiterFrame<Format, NCHANNELS>::maxAbs(kernels, in + (offset + i) * nChannels * Format::WIDTH,
+                                                                  nChannels, threshold);
+    }
+
+    /* channel j converted to float */
+    template <int NCHANNELS>
+    inline void load(int j, int offset, int nSamples, int nChannels, float* x) const
+    {
+        int i;
+        if (NCHANNELS > 0)
+            nChannels = NCHANNELS;
+        for (i = 0; i < nSamples; i++)
+            x[i] = Format::load(in + ((offset + i) * nChannels + j) * Format::WIDTH);
+    }
+
+    template <int NCHANNELS>
+    inline void applyGain(const PeakLimiterKernels* kernels, int i, float* delay, int nChannels,
+                          float gain, float threshold) const
+    {
+        PeakLimiterFrame<Format, NCHANNELS>::applyGain(kernels, in + i * nChannels * Format::WIDTH, out + i * nChannels * Format::WIDTH,
+                                                       delay, nChannels, gain, threshold);
+    }
+
+    /* frames are contiguous, so the block is one linear pass over the buffer,
+       in at most two runs that do not wrap around the delay line */
+    template <int NCHANNELS>
+    inline void applyGainBlock(const PeakLimiterKernels* kernels, int offset, int nSamples,
+                               float* delayBuffer, int delayIndex, int delayLen, int nChannels,
+                               const float* gain, float threshold) const
+    {
+        int i, k, segLen;
+        float* delay;
+
+        if (NCHANNELS > 0)
+            nChannels = NCHANNELS;
+
+        for (i = 0; i < nSamples; i += segLen) {
+            segLen = min(nSamples - i, delayLen - delayIndex);
+            delay = delayBuffer + delayIndex * nChannels;
+            for (k = 0; k < segLen; k++)
+                applyGain<NCHANNELS>(kernels, offset + i + k, delay + k * nChannels, nChannels, gain[i + k], threshold);
+            delayIndex += segLen;
+            if (delayIndex >= delayLen)
+                delayIndex = 0;
+        }
+    }
+
+    /* gain 1 and no clip: the frames only go through the delay line */
+    template <int NCHANNELS>
+    inline void delayBlock(int offset, int nSamples, float* delayBuffer, int delayIndex, int delayLen, int nChannels) const
+    {
+        int i, segLen;
+
+        if (NCHANNELS > 0)
+            nChannels = NCHANNELS;
+
+        for (i = 0; i < nSamples; i += segLen) {
+            /* stop at the end of the delay line */
+            segLen = min(nSamples - i, delayLen - delayIndex);
+            delayRun<Format>(in + (offset + i) * nChannels * Format::WIDTH, out + (offset + i) * nChannels * Format::WIDTH,
+                             delayBuffer + delayIndex * nChannels, segLen * nChannels);
+            delayIndex += segLen;
+            if (delayIndex >= delayLen)
+                delayIndex = 0;
+        }
+    }
+
+    /* no lookahead: the gain goes to the current frame, gain[j] for channel j if perChannel,
+       gain[0] otherwise. The last frame is kept in the one frame delay line */
+    inline void applyGainCurrent(int offset, int nSamples, float* delay, int nChannels,
+                                 const float* const* gain, int perChannel, float threshold) const
+    {
+        int i, j;
+        float tmp;
+
+        for (j = 0; j < nChannels; j++)
+            delay[j] = Format::load(in + ((offset + nSamples - 1) * nChannels + j) * Format::WIDTH);
+
+        for (i = 0; i < nSamples; i++) {
+            const Sample* x = in + (offset + i) * nChannels * Format::WIDTH;
+            Sample* y = out + (offset + i) * nChannels * Format::WIDTH;
+            for (j = 0; j < nChannels; j++) {
+                tmp = Format::load(x + j * Format::WIDTH) * gain[perChannel ? j : 0][i];
+                if (tmp > threshold) tmp = threshold;
+                if (tmp < -threshold) tmp = -threshold;
+
+                Format::store(y + j * Format::WIDTH, tmp);
+            }
+        }
+    }
+
+    /* maximum absolute value of channel j into peak[j], frame by frame */
+    inline void detectChannels(int offset, int nSamples, int nChannels, float* const* peak) const
+    {
+        int i, j;
+        float tmp;
+
+        for (i = 0; i < nSamples; i++) {
+            const Sample* x = in + (offset + i) * nChannels * Format::WIDTH;
+            for (j = 0; j < nChannels; j++) {
+                tmp = (float)fabs(Format::load(x + j * Format::WIDTH));
+                peak[j][i] = (peak[j][i] > tmp) ? peak[j][i] : tmp;
+            }
+        }
+    }
+
+    /* channel j with the gain curve gain[j] */
+    inline void applyGainChannels(int offset, int nSamples, float* delayBuffer, int delayIndex, int delayLen, int nChannels,
+                                  const float* const* gain, float threshold) const
+    {
+        int i, j, k, segLen;
+        float tmp;
+        float* delay;
+
+        for (i = 0; i < nSamples; i += segLen) {
+            segLen = min(nSamples - i, delayLen - delayIndex);
+            for (k = 0; k < segLen; k++) {
+                const Sample* x = in + (offset + i + k) * nChannels * Format::WIDTH;
+                Sample* y = out + (offset + i + k) * nChannels * Format::WIDTH;
+                delay = delayBuffer + (delayIndex + k) * nChannels;
+                for (j = 0; j < nChannels; j++) {
+                    tmp = delay[j];
+                    delay[j] = Format::load(x + j * Format::WIDTH);
+
+                    tmp *= gain[j][i + k];
+                    if (tmp > threshold) tmp = threshold;
+                    if (tmp < -threshold) tmp = -threshold;
+
+                    Format::store(y + j * Format::WIDTH, tmp);
+                }
+            }
+            delayIndex += segLen;
+            if (delayIndex >= delayLen)
+                delayIndex = 0;
+        }
+    }
+};
+
+/* planar buffers: one buffer per channel, out[j] may be the same buffer as in[j] */
+template <class Format>
+struct PeakLimiterPlanar
+{
+    typedef typename Format::Sample Sample;
+
+    const Sample* const* in;
+    Sample* const*       out;
+
+    template <int NCHANNELS>
+    inline void detect(const PeakLimiterKernels* kernels, int offset, int nSamples, int nChannels,
+                       float threshold, float* peak) const
+    {
+        maxAbsPlanar<Format>(kernels, in, nChannels, offset, nSamples, threshold, peak);
+    }
+
+    /* channel j converted to float */
+    template <int NCHANNELS>
+    inline void load(int j, int offset, int nSamples, int, float* x) const
+    {
+        int i;
+        for (i = 0; i < nSamples; i++)
+            x[i] = Format::load(in[j] + (offset + i) * Format::WIDTH);
+    }
+
+    template <int NCHANNELS>
+    inline void applyGain(const PeakLimiterKernels*, int i, float* delay, int nChannels,
+                          float gain, float threshold) const
+    {
+        int j;
+        float tmp;
+
+        for (j = 0; j < ((NCHANNELS > 0) ? NCHANNELS : nChannels); j++) {
+            tmp = delay[j];
+            delay[j] = Format::load(in[j] + i * Format::WIDTH);
+
+            tmp *= gain;
+            if (tmp > threshold) tmp = threshold;
+            if (tmp < -threshold) tmp = -threshold;
+
+            Format::store(out[j] + i * Format::WIDTH, tmp);
+        }
+    }
+
+    /* channel by channel, streaming through each channel buffer */
+    template <int NCHANNELS>
+    inline void applyGainBlock(const PeakLimiterKernels*, int offset, int nSamples,
+                               float* delayBuffer, int delayIndex, int delayLen, int nChannels,
+                               const float* gain, float threshold) const
+    {
+        int j;
+
+        if (NCHANNELS > 0)
+            nChannels = NCHANNELS;
+
+        for (j = 0; j < nChannels; j++)
+            applyGainChannel(j, offset, nSamples, delayBuffer, delayIndex, delayLen, nChannels, gain, threshold);
+    }
+
+    /* gain 1 and no clip: the samples only go through the delay line */
+    template <int NCHANNELS>
+    inline void delayBlock(int offset, int nSamples, float* delayBuffer, int delayIndex, int delayLen, int nChannels) const
+    {
+        int i, j, k, segLen, index;
+        float tmp;
+        float* delay;
+
+        if (NCHANNELS > 0)
+            nChannels = NCHANNELS;
+
+        for (j = 0; j < nChannels; j++) {
+            const Sample *x = in[j] + offset * Format::WIDTH;
+            Sample *y = out[j] + offset * Format::WIDTH;
+
+            index = delayIndex;
+            for (i = 0; i < nSamples; i += segLen) {
+                segLen = min(nSamples - i, delayLen - index);
+                delay = delayBuffer + index * nChannels + j;
+                for (k = 0; k < segLen; k++) {
+                    tmp = delay[k * nChannels];
+                    delay[k * nChannels] = Format::load(x + (i + k) * Format::WIDTH);
+                    Format::store(y + (i + k) * Format::WIDTH, tmp);
+                }
+                index += segLen;
+                if (index >= delayLen)
+                    index = 0;
+            }
+        }
+    }
+
+    /* no lookahead: the gain goes to the current sample, gain[j] for channel j if perChannel,
+       gain[0] otherwise. The last frame is kept in the one frame delay line */
+    inline void applyGainCurrent(int offset, int nSamples, float* delay, int nChannels,
+                                 const float* const* gain, int perChannel, float threshold) const
+    {
+        int i, j;
+        float tmp;
+        const float* g;
+
+        for (j = 0; j < nChannels; j++) {
+            const Sample *x = in[j] + offset * Format::WIDTH;
+            Sample *y = out[j] + offset * Format::WIDTH;
+            g = gain[perChannel ? j : 0];
+
+            delay[j] = Format::load(x + (nSamples - 1) * Format::WIDTH);
+            for (i = 0; i < nSamples; i++) {
+                tmp = Format::load(x + i * Format::WIDTH) * g[i];
+                if (tmp > threshold) tmp = threshold;
+                if (tmp < -threshold) tmp = -threshold;
+
+                Format::store(y + i * Format::WIDTH, tmp);
+            }
+        }
+    }
+
+    /* maximum absolute value of channel j into peak[j], channel by channel */
+    inline void detectChannels(int offset, int nSamples, int nChannels, float* const* peak) const
+    {
+        int i, j;
+        float tmp;
+
+        for (j = 0; j < nChannels; j++) {
+            const Sample* x = in[j] + offset * Format::WIDTH;
+            float* y = peak[j];
+            for (i = 0; i < nSamples; i++) {
+                tmp = (float)fabs(Format::load(x + i * Format::WIDTH));
+                y[i] = (y[i] > tmp) ? y[i] : tmp;
+            }
+        }
+    }
+
+    /* channel j with the gain curve gain[j] */
+    inline void applyGainChannels(int offset, int nSamples, float* delayBuffer, int delayIndex, int delayLen, int nChannels,
+                                  const float* const* gain, float threshold) const
+    {
+        int j;
+
+        for (j = 0; j < nChannels; j++)
+            applyGainChannel(j, offset, nSamples, delayBuffer, delayIndex, delayLen, nChannels, gain[j], threshold);
+    }
+
+    inline void applyGainChannel(int j, int offset, int nSamples, float* delayBuffer, int delayIndex, int delayLen,
+                                 int nChannels, const float* gain, float threshold) const
+    {
+        int i, k, segLen, index;
+        float tmp;
+        const Sample *x = in[j] + offset * Format::WIDTH;
+        Sample *y = out[j] + offset * Format::WIDTH;
+        float *delay;
+
+        index = delayIndex;
+        for (i = 0; i < nSamples; i += segLen) {
+            /* stop at the end of the delay line */
+            segLen = min(nSamples - i, delayLen - index);
+            delay = delayBuffer + index * nChannels + j;
+            for (k = 0; k < segLen; k++) {
+                tmp = delay[k * nChannels];
+                delay[k * nChannels] = Format::load(x + (i + k) * Format::WIDTH);
+
+                tmp *= gain[i + k];
+                if (tmp > threshold) tmp = threshold;
+                if (tmp < -threshold) tmp = -threshold;
+
+                Format::store(y + (i + k) * Format::WIDTH, tmp);
+            }
+            index += segLen;
+            if (index >= delayLen)
+                index = 0;
+        }
+    }
+};
+
+/* apply limiter */
+int PeakLimiter::applyLimiter_E(const float *samplesIn,float *samplesOut, int nSamples)
+{
+    PEAKLIMITER_COUNT(calls[PEAKLIMITER_ENTRY_E], 1);
+    return (this->*m_pProcess->interleaved[PEAKLIMITER_FLOAT32])(samplesIn, samplesOut, nSamples);
+}
+
+/* apply limiter */
+int PeakLimiter::applyLimiter_E_I(float *samples, int nSamples)
+{
+    PEAKLIMITER_COUNT(calls[PEAKLIMITER_ENTRY_E_I], 1);
+    return (this->*m_pProcess->interleaved[PEAKLIMITER_FLOAT32])(samples, samples, nSamples);
+}
+
+/* apply limiter */
+int PeakLimiter::applyLimiter(const float **samplesIn,float **samplesOut, int nSamples)
+{
+    PEAKLIMITER_COUNT(calls[PEAKLIMITER_ENTRY_PLANAR], 1);
+    return (this->*m_pProcess->planar[PEAKLIMITER_FLOAT32])((const void* const*)samplesIn, (void* const*)samplesOut, nSamples);
+}
+
+/* apply limiter */
+int PeakLimiter::applyLimiter_I( float **samples,int nSamples)
+{
+    PEAKLIMITER_COUNT(calls[PEAKLIMITER_ENTRY_I], 1);
+    return (this->*m_pProcess->planar[PEAKLIMITER_FLOAT32])((const void* const*)samples, (void* const*)samples, nSamples);
+}
+
+/* apply limiter on 16 bit integer samples */
+int PeakLimiter::applyLimiter_E_Int16(const int16_t *samplesIn, int16_t *samplesOut, int nSamples)
+{
+    PEAKLIMITER_COUNT(calls[PEAKLIMITER_ENTRY_E_INT16], 1);
+    return (this->*m_pProcess->interleaved[PEAKLIMITER_INT16])(samplesIn, samplesOut, nSamples);
+}
+
+int PeakLimiter::applyLimiter_Int16(const int16_t **samplesIn, int16_t **samplesOut, int nSamples)
+{
+    PEAKLIMITER_COUNT(calls[PEAKLIMITER_ENTRY_INT16], 1);
+    return (this->*m_pProcess->planar[PEAKLIMITER_INT16])((const void* const*)samplesIn, (void* const*)samplesOut, nSamples);
+}
+
+/* apply limiter on packed 24 bit integer samples */
+int PeakLimiter::applyLimiter_E_Int24(const uint8_t *samplesIn, uint8_t *samplesOut, int nSamples)
+{
+    PEAKLIMITER_COUNT(calls[PEAKLIMITER_ENTRY_E_INT24], 1);
+    return (this->*m_pProcess->interleaved[PEAKLIMITER_INT24])(samplesIn, samplesOut, nSamples);
+}
+
+int PeakLimiter::applyLimiter_Int24(const uint8_t **samplesIn, uint8_t **samplesOut, int nSamples)
+{
+    PEAKLIMITER_COUNT(calls[PEAKLIMITER_ENTRY_INT24], 1);
+    return (this->*m_pProcess->planar[PEAKLIMITER_INT24])((const void* const*)samplesIn, (void* const*)samplesOut, nSamples);
+}
+
+/* apply limiter on 32 bit integer samples */
+int PeakLimiter::applyLimiter_E_Int32(const int32_t *samplesIn, int32_t *samplesOut, int nSamples)
+{
+    PEAKLIMITER_COUNT(calls[PEAKLIMITER_ENTRY_E_INT32], 1);
+    return (this->*m_pProcess->interleaved[PEAKLIMITER_INT32])(samplesIn, samplesOut, nSamples);
+}
+
+int PeakLimiter::applyLimiter_Int32(const int32_t **samplesIn, int32_t **samplesOut, int nSamples)
+{
+    PEAKLIMITER_COUNT(calls[PEAKLIMITER_ENTRY_INT32], 1);
+    return (this->*m_pProcess->planar[PEAKLIMITER_INT32])((const void* const*)samplesIn, (void* const*)samplesOut, nSamples);
+}
+
+/* samples below -600 dB to 0: their products with the true peak filter taps, not only
+   the subnormal samples themselves, would be subnormal */
+#define PEAKLIMITER_FLUSH_FLOOR   (1e-30f)
+
+static inline void flushDenormals(float* x, int n)
+{
+    int i;
+
+    for (i = 0; i < n; i++)
+        if (fabsf(x[i]) < PEAKLIMITER_FLUSH_FLOOR)
+            x[i] = 0;
+}
+
+/* true peak of a block of samples: each channel goes through the 4x oversampling filter
+   after the last samples of the previous block, the peaks are added to m_pPeakBuffer,
+   or to the peak buffer of the group of the channel.
+   The interpolated peaks reach the maximum search about PEAKLIMITER_TRUEPEAK_TAPS/2
+   samples late, well within the usual lookahead. Without a hardware flush to zero mode
+   the filter input is flushed here: its 48 products per sample are the arithmetic
+   that a fading tail reaches, the fast path only copies the delayed samples */
+template <class Layout, int NCHANNELS>
+inline void PeakLimiter::detectTruePeak(const Layout& samples, int offset, int nSamples, int nChannels)
+{
+    int j;
+    float* history;
+    float* peak;
+    float* x = m_pTruePeakBuffer + PEAKLIMITER_TRUEPEAK_TAPS - 1;
+
+    for (j = 0; j < nChannels; j++) {
+        history = m_pTruePeakHistory + j * (PEAKLIMITER_TRUEPEAK_TAPS - 1);
+        memcpy(m_pTruePeakBuffer, history, (PEAKLIMITER_TRUEPEAK_TAPS - 1) * sizeof(float));
+        samples.template load<NCHANNELS>(j, offset, nSamples, nChannels, x);
+        if (m_flushSoftware)
+            flushDenormals(x, nSamples);
+
+        peak = (m_nGroups > 1) ? m_ppChannelPeak[j] : m_pPeakBuffer;
+        m_pKernels->truePeak(x, nSamples, peak);
+
+        memcpy(history, m_pTruePeakBuffer + nSamples, (PEAKLIMITER_TRUEPEAK_TAPS - 1) * sizeof(float));
+    }
+}
+
+/* hard clips of one delayed frame at a given gain, as counted by meterOutput */
+static inline int countClips(const float* frame, int nChannels, float gain, float threshold)
+{
+    int j, clips = 0;
+
+    for (j = 0; j < nChannels; j++)
+        clips += ((float)fabs(frame[j] * gain) > threshold);
+
+    return clips;
+}
+
+/* output peak and hard clips of a block, from the gain curve and the samples leaving
+   the delay line: its content first, then the block itself once it has been read through */
+template <class Layout, int NCHANNELS>
+inline void PeakLimiter::meterOutput(const Layout& samples, int offset, int nSamples, int nChannels,
+                                     float* outputPeak, int* clipCount)
+{
+    int i, j, index, nDelayed;
+    float tmp, peak = *outputPeak;
+    int clips = *clipCount;
+    const float* gain;
+
+    nDelayed = m_zeroLookahead ? 0 : min(nSamples, m_attack);
+    for (j = 0; j < nChannels; j++) {
+        gain = (m_nGroups > 1) ? m_ppChannelGain[j] : m_pGainBuffer;
+        index = m_delayBufferIndex;
+        for (i = 0; i < nDelayed; i++) {
+            m_pMeterBuffer[i] = m_pDelayBuffer[index * nChannels + j];
+            if (++index >= m_attack)
+                index = 0;
+        }
+        if (nSamples > nDelayed)
+            samples.template load<NCHANNELS>(j, offset, nSamples - nDelayed, nChannels, m_pMeterBuffer + nDelayed);
+
+        for (i = 0; i < nSamples; i++) {
+            tmp = (float)fabs(m_pMeterBuffer[i] * gain[i]);
+            if (tmp > m_threshold) {
+                clips++;
+                tmp = m_threshold;
+            }
+            peak = (peak > tmp) ? peak : tmp;
+        }
+    }
+
+    *outputPeak = peak;
+    *clipCount = clips;
+}
+
+/* push the record of one call, merged with the previous ones if the ring was full */
+void PeakLimiter::pushMeter(int nSamples, float minGain, float inputPeak, float outputPeak, int clipCount)
+{
+    PeakLimiterMeter* meter = &m_meterPending;
+    float maxGainReduction = -20 * (float)log10(minGain);
+
+    if (m_meterPendingValid) {
+        meter->nSamples += nSamples;
+        meter->maxGainReduction = max(meter->maxGainReduction, maxGainReduction);
+        meter->inputPeak = max(meter->inputPeak, inputPeak);
+        meter->outputPeak = max(meter->outputPeak, outputPeak);
+        meter->clipCount += clipCount;
+    }
+    else {
+        meter->position = m_meterPosition;
+        meter->nSamples = nSamples;
+        meter->maxGainReduction = maxGainReduction;
+        meter->inputPeak = inputPeak;
+        meter->outputPeak = outputPeak;
+        meter->clipCount = clipCount;
+    }
+    m_meterPosition += nSamples;
+
+    m_meterPendingValid = !m_pMeterRing->push(*meter);
+}
+
+/* apply limiter: detector for a whole block, then either gain and delay line sample
+   by sample, or the gain curve of the whole block and then the delay line.
+   Each input sample is read before the output sample at the same position is written,
+   so in-place and out-of-place processing share the same single pass.
+   Metering needs the gain curve before the delay line, so it goes through the block mode,
+   and the detector starts from 0 instead of m_threshold to get the input peak: the gain
+   only depends on the maxima above m_threshold */
+template <class Layout, int NCHANNELS>
+inline int PeakLimiter::processBlocks(Layout samples, int nSamples)
+{
+   int i, k, n, blockLen, segLen;
+    float smoothState;
+    float* delay;
+    const float* gain;
+    const int nChannels = (NCHANNELS > 0) ? NCHANNELS : m_channels;
+    const int metering = (m_pMeterRing != NULL);
+    float minGain = 1.0f, inputPeak = 0, outputPeak = 0;
+    int clipCount = 0;
+
+    for (n = 0; n < nSamples; n += blockLen) {
+        blockLen = min(PEAKLIMITER_BLOCK_SIZE, nSamples - n);
+
+        /* get maximum absolute sample value of all channels that are greater in absoulte value to m_threshold */
+        samples.template detect<NCHANNELS>(m_pKernels, n, blockLen, nChannels, metering ? 0.0f : m_threshold, m_pPeakBuffer);
+        if (metering)
+            for (i = 0; i < blockLen; i++)
+                inputPeak = max(inputPeak, m_pPeakBuffer[i]);
+        if (m_truePeak)
+            detectTruePeak<Layout, NCHANNELS>(samples, n, blockLen, nChannels);
+
+        if (!metering && !m_zeroLookahead && (m_smoothState == 1.0f) && (m_lastMaximum <= m_threshold) && (m_delayUnchecked == 0)
+            && (processQuiet<Layout, NCHANNELS>(samples, n, blockLen, nChannels) == LIMITER_OK))
+            continue;
+        m_delayUnchecked = max(0, m_delayUnchecked - blockLen);
+
+        if ((m_processingMode == PEAKLIMITER_PROCESS_BLOCK) || metering || m_zeroLookahead)
+        {
+            /* gain curve */
+            for (i = 0; i < blockLen; i++) {
+                m_pGainBuffer[i] = updateGain(m_pPeakBuffer[i]);
+                minGain = min(minGain, m_pGainBuffer[i]);
+                PEAKLIMITER_COUNT(limitedSamples, m_pGainBuffer[i] < 1.0f);
+            }
+
+            if (metering || PEAKLIMITER_STATS)
+                meterOutput<Layout, NCHANNELS>(samples, n, blockLen, nChannels, &outputPeak, &clipCount);
+
+            if (m_zeroLookahead) {
+                gain = m_pGainBuffer;
+                samples.applyGainCurrent(n, blockLen, m_pDelayBuffer, nChannels, &gain, 0, m_threshold);
+                continue;
+            }
+
+            /* fill delay line, apply gain */
+            samples.template applyGainBlock<NCHANNELS>(m_pKernels, n, blockLen, m_pDelayBuffer, m_delayBufferIndex, m_attack,
+                                                       nChannels, m_pGainBuffer, m_threshold);
+            m_delayBufferIndex = (m_delayBufferIndex + blockLen) % m_attack;
+        }
+        else
+        {
+            /* runs of samples that do not wrap around the delay line */
+            for (i = 0; i < blockLen; i += segLen) {
+                segLen = min(blockLen - i, m_attack - m_delayBufferIndex);
+                delay = m_pDelayBuffer + m_delayBufferIndex * nChannels;
+                for (k = 0; k < segLen; k++) {
+                    smoothState = updateGain(m_pPeakBuffer[i + k]);
+                    minGain = min(minGain, smoothState);
+                    PEAKLIMITER_COUNT(limitedSamples, smoothState < 1.0f);
+                    PEAKLIMITER_COUNT(clipSamples, countClips(delay + k * nChannels, nChannels, smoothState, m_threshold));
+
+                    /* fill delay line, apply gain */
+                    samples.template applyGain<NCHANNELS>(m_pKernels, n + i + k, delay + k * nChannels,
+                                                          nChannels, smoothState, m_threshold);
+                }
+                m_delayBufferIndex += segLen;
+                if (m_delayBufferIndex >= m_attack)
+                    m_delayBufferIndex = 0;
+            }
+        }
+    }
+
+    m_minGain = minGain;
+    if (metering)
+        pushMeter(nSamples, minGain, inputPeak, outputPeak, clipCount);
+    PEAKLIMITER_COUNT(clipSamples, clipCount);
+
+    return LIMITER_OK;
+}
+
+/* fast path of a block below the threshold, with the gain settled at 1: the gain stays 1 on the
+   whole block and no delayed sample reaches the hard clip, so only the maximum search is updated
+   and the delay line shifts. Returns LIMITER_INVALID_PARAMETER, without any change, when a peak
+   of the block is above the threshold */
+template <class Layout, int NCHANNELS>
+inline int PeakLimiter::processQuiet(Layout samples, int offset, int nSamples, int nChannels)
+{
+    int i;
+    float peak = 0;
+
+    for (i = 0; i < nSamples; i++)
+        peak = max(peak, m_pPeakBuffer[i]);
+    if (peak > m_threshold)
+        return LIMITER_INVALID_PARAMETER;
+
+    if (m_maxEngine == PEAKLIMITER_MAX_VHGW)
+        for (i = 0; i < nSamples; i++)
+            m_lastMaximum = updateMaxVhgw(m_pPeakBuffer[i]);
+    else
+        for (i = 0; i < nSamples; i++)
+            m_lastMaximum = updateMaxSections(m_pPeakBuffer[i]);
+    m_fadedGain = 1.0f;
+    PEAKLIMITER_COUNT(quietBlocks, 1);
+    PEAKLIMITER_COUNT(quietSamples, nSamples);
+
+    samples.template delayBlock<NCHANNELS>(offset, nSamples, m_pDelayBuffer, m_delayBufferIndex, m_attack, nChannels);
+    m_delayBufferIndex = (m_delayBufferIndex + nSamples) % m_attack;
+
+    return LIMITER_OK;
+}
+
+/* apply limiter: parameters posted by the control thread, then the linked or grouped
+   processing, timed when setLimiterTiming is on, with subnormals flushed to zero when
+   setLimiterFlushDenormals is on */
+template <class Layout, int NCHANNELS>
+int PeakLimiter::process(Layout samples, int nSamples)
+{
+    int err;
+    uint64_t startTicks = 0, fpState = 0;
+    std::chrono::steady_clock::time_point startTime;
+
+    if (m_timing) {
+        startTime = std::chrono::steady_clock::now();
+        startTicks = getPeakLimiterTicks();
+    }
+    if (m_flushDenormals)
+        m_flushSoftware = !enterPeakLimiterFlushDenormals(&fpState);
+
+    pollParameters();
+    PEAKLIMITER_COUNT(samples, nSamples);
+    if (m_nGroups > 1)
+        err = processGroups<Layout>(samples, nSamples);
+    else
+        err = processBlocks<Layout, NCHANNELS>(samples, nSamples);
+
+    if (m_flushDenormals)
+        leavePeakLimiterFlushDenormals(fpState);
+    if (m_timing)
+        updateTiming(nSamples, getPeakLimiterTicks() - startTicks,
+                     (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startTime).count());
+
+    return err;
+}
+
+/* apply limiter with channel groups: the detector of each channel feeds the peak buffer of
+   its group, each group computes its gain curve, then one pass over the shared delay line
+   applies to each channel the gain of its group */
+template <class Layout>
+int PeakLimiter::processGroups(Layout samples, int nSamples)
+{
+    int i, g, n, blockLen;
+    float init;
+    float* peak;
+    const int nChannels = m_channels;
+    const int metering = (m_pMeterRing != NULL);
+    float minGain = 1.0f, inputPeak = 0, outputPeak = 0;
+    int clipCount = 0;
+
+    init = metering ? 0.0f : m_threshold;
+    for (n = 0; n < nSamples; n += blockLen) {
+        blockLen = min(PEAKLIMITER_BLOCK_SIZE, nSamples - n);
+
+        /* detector, into the peak buffer of the group of each channel */
+        for (g = 0; g < m_nGroups; g++) {
+            peak = (g == 0) ? m_pPeakBuffer : m_pGroups[g].pPeakBuffer;
+            for (i = 0; i < blockLen; i++)
+                peak[i] = init;
+        }
+        samples.detectChannels(n, blockLen, nChannels, m_ppChannelPeak);
+        if (metering)
+            for (g = 0; g < m_nGroups; g++) {
+                peak = (g == 0) ? m_pPeakBuffer : m_pGroups[g].pPeakBuffer;
+                for (i = 0; i < blockLen; i++)
+                    inputPeak = max(inputPeak, peak[i]);
+            }
+        if (m_truePeak)
+            detectTruePeak<Layout, 0>(samples, n, blockLen, nChannels);
+
+        /* gain curve of each group, in the state of the group */
+        for (g = 0; g < m_nGroups; g++) {
+            swapGroup(g);
+            for (i = 0; i < blockLen; i++) {
+                m_pGainBuffer[i] = updateGain(m_pPeakBuffer[i]);
+                minGain = min(minGain, m_pGainBuffer[i]);
+                PEAKLIMITER_COUNT(limitedSamples, m_pGainBuffer[i] < 1.0f);
+            }
+            swapGroup(g);
+        }
+
+        if (metering || PEAKLIMITER_STATS)
+            meterOutput<Layout, 0>(samples, n, blockLen, nChannels, &outputPeak, &clipCount);
+
+        /* fill delay line, apply gain */
+        if (m_zeroLookahead)
+            samples.applyGainCurrent(n, blockLen, m_pDelayBuffer, nChannels, m_ppChannelGain, 1, m_threshold);
+        else
+            samples.applyGainChannels(n, blockLen, m_pDelayBuffer, m_delayBufferIndex, m_attack, nChannels,
+                                      m_ppChannelGain, m_threshold);
+        m_delayBufferIndex = (m_delayBufferIndex + blockLen) % m_attack;
+    }
+
+    m_minGain = minGain;
+    if (metering)
+        pushMeter(nSamples, minGain, inputPeak, outputPeak, clipCount);
+    PEAKLIMITER_COUNT(clipSamples, clipCount);
+
+    return LIMITER_OK;
+}
+
+/* gain curve of applyLimiter_E: the detector and gain of processBlocks, without the delay line.
+   The fast path below the threshold would give a gain of exactly 1 as well */
+int PeakLimiter::analyzeLimiter_E(const float* samplesIn, float* gain, int nSamples)
+{
+    int i, n, blockLen;
+    uint64_t fpState = 0;
+    PeakLimiterInterleaved<PeakLimiterFloat32> samples = { samplesIn, NULL };
+
+    if ((samplesIn == NULL) || (gain == NULL) || (nSamples < 0)) return LIMITER_INVALID_PARAMETER;
+    if (m_nGroups > 1) return LIMITER_INVALID_PARAMETER;
+
+    if (m_flushDenormals)
+        m_flushSoftware = !enterPeakLimiterFlushDenormals(&fpState);
+    pollParameters();
+    for (n = 0; n < nSamples; n += blockLen) {
+        blockLen = min(PEAKLIMITER_BLOCK_SIZE, nSamples - n);
+
+        samples.detect<0>(m_pKernels, n, blockLen, m_channels, m_threshold, m_pPeakBuffer);
+        if (m_truePeak)
+            detectTruePeak<PeakLimiterInterleaved<PeakLimiterFloat32>, 0>(samples, n, blockLen, m_channels);
+
+        for (i = 0; i < blockLen; i++)
+            gain[n + i] = updateGain(m_pPeakBuffer[i]);
+    }
+    m_delayUnchecked = m_attack;    /* stale delay line, no fast path until it is refilled */
+    if (m_flushDenormals)
+        leavePeakLimiterFlushDenormals(fpState);
+
+    return LIMITER_OK;
+}
+
+template <class Format, int NCHANNELS>
+int PeakLimiter::processInterleaved(const void* samplesIn, void* samplesOut, int nSamples)
+{
+    PeakLimiterInterleaved<Format> layout = { (const typename Format::Sample*)samplesIn,
+                                              (typename Format::Sample*)samplesOut };
+    return process<PeakLimiterInterleaved<Format>, NCHANNELS>(layout, nSamples);
+}
+
+template <class Format, int NCHANNELS>
+int PeakLimiter::processPlanar(const void* const* samplesIn, void* const* samplesOut, int nSamples)
+{
+    PeakLimiterPlanar<Format> layout = { (const typename Format::Sample* const*)samplesIn,
+                                         (typename Format::Sample* const*)samplesOut };
+    return process<PeakLimiterPlanar<Format>, NCHANNELS>(layout, nSamples);
+}
+
+template <int NCHANNELS>
+const PeakLimiterProcess* PeakLimiter::getProcess()
+{
+    static const PeakLimiterProcess process = {
+        { &PeakLimiter::processInterleaved<PeakLimiterFloat32, NCHANNELS>,
+          &PeakLimiter::processInterleaved<PeakLimiterInt16, NCHANNELS>,
+          &PeakLimiter::processInterleaved<PeakLimiterInt24, NCHANNELS>,
+          &PeakLimiter::processInterleaved<PeakLimiterInt32, NCHANNELS> },
+        { &PeakLimiter::processPlanar<PeakLimiterFloat32, NCHANNELS>,
+          &PeakLimiter::processPlanar<PeakLimiterInt16, NCHANNELS>,
+          &PeakLimiter::processPlanar<PeakLimiterInt24, NCHANNELS>,
+          &PeakLimiter::processPlanar<PeakLimiterInt32, NCHANNELS> }
+    };
+    return &process;
+}
+
+/* pick the kernels matching the number of channels */
+void PeakLimiter::selectProcess()
+{
+    switch (m_channels) {
+    case 1:  m_pProcess = getProcess<1>();  break;
+    case 2:  m_pProcess = getProcess<2>();  break;
+    case 6:  m_pProcess = getProcess<6>();  break;
+    case 8:  m_pProcess = getProcess<8>();  break;
+    case 16: m_pProcess = getProcess<16>(); break;
+    default: m_pProcess = getProcess<0>();  break;
+    }
+}
+
+/* get delay in samples */
+int PeakLimiter::getLimiterDelay()
+{
+  return m_zeroLookahead ? 0 : m_attack;
+}
+
+/* get m_attack in Ms */
+float PeakLimiter::getLimiterAttack()
+{
+  return m_attackMs;
+}
+
+/* get delay in samples */
+int PeakLimiter::getLimiterSampleRate()
+{
+	return m_sampleRate;
+}
+
+/* get delay in samples */
+float PeakLimiter::getLimiterRelease()
+{
+	return m_releaseMs;
+}
+ 
+/* get maximum gain reduction of last processed block */
+void* PeakLimiter::getLimiterMemory()
+{
+  return m_pMemory;
+}
+
+float PeakLimiter::getLimiterMaxGainReduction()
+{
+  return -20 * (float)log10(m_minGain);
+}
+
+/* enable metering */
+int PeakLimiter::setLimiterMetering(int nRecordsIn)
+{
+  if (nRecordsIn < 0) return LIMITER_INVALID_PARAMETER;
+
+  if (m_pMeterRing) {
+    delete m_pMeterRing;
+    m_pMeterRing = NULL;
+  }
+  m_meterPendingValid = 0;
+  if (nRecordsIn > 0)
+    m_pMeterRing = new PeakLimiterRing<PeakLimiterMeter>(nRecordsIn);
+
+  return LIMITER_OK;
+}
+
+/* read meter records */
+int PeakLimiter::readLimiterMeters(PeakLimiterMeter* records, int maxRecords)
+{
+  if ((m_pMeterRing == NULL) || (records == NULL) || (maxRecords <= 0)) return 0;
+
+  return (int)m_pMeterRing->pop(records, (unsigned int)maxRecords);
+}
+
+/* enable timing, clear the counters */
+int PeakLimiter::setLimiterTiming(int timingIn)
+{
+  int k;
+
+  if ((timingIn != 0) && (timingIn != 1)) return LIMITER_INVALID_PARAMETER;
+
+  m_timingSeq.fetch_add(1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  m_timingCalls.store(0, std::memory_order_relaxed);
+  m_timingSamples.store(0, std::memory_order_relaxed);
+  m_timingTotalTicks.store(0, std::memory_order_relaxed);
+  m_timingLastTicks.store(0, std::memory_order_relaxed);
+  m_timingMaxTicks.store(0, std::memory_order_relaxed);
+  m_timingMaxTicksSamples.store(0, std::memory_order_relaxed);
+  m_timingLastNs.store(0, std::memory_order_relaxed);
+  m_timingMaxNs.store(0, std::memory_order_relaxed);
+  for (k = 0; k < PEAKLIMITER_TIMING_BINS; k++)
+    m_timingHistogram[k].store(0, std::memory_order_relaxed);
+  m_timingSeq.fetch_add(1, std::memory_order_release);
+  m_timing = timingIn;
+
+  return LIMITER_OK;
+}
+
+/* flush subnormals to zero while processing */
+int PeakLimiter::setLimiterFlushDenormals(int flushIn)
+{
+  if ((flushIn != 0) && (flushIn != 1)) return LIMITER_INVALID_PARAMETER;
+
+  m_flushDenormals = flushIn;
+  m_flushSoftware  = 0;
+
+  return LIMITER_OK;
+}
+
+/* add a call to the counters: only the processing thread writes them, inside an odd
+   sequence number, so getLimiterTiming retries instead of reading a half update */
+void PeakLimiter::updateTiming(int nSamples, uint64_t ticks, uint64_t ns)
+{
+  int bin;
+  const unsigned int seq = m_timingSeq.load(std::memory_order_relaxed);
+
+  for (bin = 0; (bin < PEAKLIMITER_TIMING_BINS - 1) && (ticks >> (bin + 1)); bin++)
+    ;
+
+  m_timingSeq.store(seq + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  m_timingCalls.store(m_timingCalls.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+  m_timingSamples.store(m_timingSamples.load(std::memory_order_relaxed) + nSamples, std::memory_order_relaxed);
+  m_timingTotalTicks.store(m_timingTotalTicks.load(std::memory_order_relaxed) + ticks, std::memory_order_relaxed);
+  m_timingLastTicks.store(ticks, std::memory_order_relaxed);
+  if (ticks > m_timingMaxTicks.load(std::memory_order_relaxed)) {
+    m_timingMaxTicks.store(ticks, std::memory_order_relaxed);
+    m_timingMaxTicksSamples.store(nSamples, std::memory_order_relaxed);
+  }
+  m_timingLastNs.store(ns, std::memory_order_relaxed);
+  if (ns > m_timingMaxNs.load(std::memory_order_relaxed))
+    m_timingMaxNs.store(ns, std::memory_order_relaxed);
+  m_timingHistogram[bin].store(m_timingHistogram[bin].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+  m_timingSeq.store(seq + 2, std::memory_order_release);
+}
+
+/* read the counters */
+int PeakLimiter::getLimiterTiming(PeakLimiterTiming* timing)
+{
+  int k;
+  unsigned int seq;
+
+  if (timing == NULL) return LIMITER_INVALID_PARAMETER;
+
+  do {
+    seq = m_timingSeq.load(std::memory_order_acquire);
+    timing->calls           = m_timingCalls.load(std::memory_order_relaxed);
+    timing->samples         = m_timingSamples.load(std::memory_order_relaxed);
+    timing->totalTicks      = m_timingTotalTicks.load(std::memory_order_relaxed);
+    timing->lastTicks       = m_timingLastTicks.load(std::memory_order_relaxed);
+    timing->maxTicks        = m_timingMaxTicks.load(std::memory_order_relaxed);
+    timing->maxTicksSamples = m_timingMaxTicksSamples.load(std::memory_order_relaxed);
+    timing->lastNs          = m_timingLastNs.load(std::memory_order_relaxed);
+    timing->maxNs           = m_timingMaxNs.load(std::memory_order_relaxed);
+    for (k = 0; k < PEAKLIMITER_TIMING_BINS; k++)
+      timing->histogram[k]  = m_timingHistogram[k].load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+  } while ((seq & 1) || (seq != m_timingSeq.load(std::memory_order_relaxed)));
+
+  return LIMITER_OK;
+}
+
+/* read the event counters */
+int PeakLimiter::getLimiterStats(PeakLimiterStats* stats)
+{
+  if (stats == NULL) return LIMITER_INVALID_PARAMETER;
+
+  *stats = m_stats;
+  stats->enabled = PEAKLIMITER_STATS;
+
+  return LIMITER_OK;
+}
+
+/* clear the event counters */
+int PeakLimiter::resetLimiterStats()
+{
+  memset(&m_stats, 0, sizeof(m_stats));
+
+  return LIMITER_OK;
+}
+
+/* set number of channels */
+int PeakLimiter::setLimiterNChannels(int nChannelsIn)
+{
+  int k;
+
+  if ((nChannelsIn < 1) || (nChannelsIn > m_maxChannels)) return LIMITER_INVALID_PARAMETER;
+
+  if (nChannelsIn == m_channels) return LIMITER_OK;
+
+  /* frame k of the delay line moves from k * m_channels to k * nChannelsIn */
+  linearizeDelay();
+  if (nChannelsIn < m_channels) {
+    for (k = 0; k < m_attack; k++)
+      memmove(m_pDelayBuffer + k * nChannelsIn, m_pDelayBuffer + k * m_channels, sizeof(float) * nChannelsIn);
+  }
+  else {
+    for (k = m_attack - 1; k >= 0; k--) {
+      memmove(m_pDelayBuffer + k * nChannelsIn, m_pDelayBuffer + k * m_channels, sizeof(float) * m_channels);
+      memset(m_pDelayBuffer + k * nChannelsIn + m_channels, 0, sizeof(float) * (nChannelsIn - m_channels));
+    }
+    memset(m_pTruePeakHistory + m_channels * (PEAKLIMITER_TRUEPEAK_TAPS-1), 0,
+           sizeof(float) * (nChannelsIn - m_channels) * (PEAKLIMITER_TRUEPEAK_TAPS-1));
+  }
+
+  m_channels = nChannelsIn;
+  selectProcess();
+
+  return LIMITER_OK;
+}
+
+/* set channel groups */
+int PeakLimiter::setLimiterChannelGroups(const int* channelGroupsIn, int nChannelsIn)
+{
+  int j, g, nGroups = 1;
+
+  if (m_pMemory == NULL) return LIMITER_INVALID_HANDLE;
+  if (channelGroupsIn != NULL) {
+    if ((nChannelsIn < 1) || (nChannelsIn > m_maxChannels)) return LIMITER_INVALID_PARAMETER;
+    for (j = 0; j < nChannelsIn; j++) {
+      if ((channelGroupsIn[j] < 0) || (channelGroupsIn[j] >= m_maxChannels)) return LIMITER_INVALID_PARAMETER;
+      nGroups = max(nGroups, channelGroupsIn[j] + 1);
+    }
+  }
+
+  m_delayUnchecked = m_attack;   /* channels of the other groups were not in the maximum search */
+  m_nGroups = nGroups;
+  if (nGroups == 1) return LIMITER_OK;
+
+  /* groups 1.. start from silence, group 0 keeps the state of the limiter */
+  for (g = 1; g < nGroups; g++) {
+    swapGroup(g);
+    m_fadedGain = 1.0f;
+    m_smoothState = 1.0;
+    resetMax();
+    swapGroup(g);
+  }
+  for (j = 0; j < m_maxChannels; j++) {
+    m_pChannelGroup[j] = ((channelGroupsIn != NULL) && (j < nChannelsIn)) ? channelGroupsIn[j] : 0;
+    g = m_pChannelGroup[j];
+    m_ppChannelGain[j] = (g == 0) ? m_pGainBuffer : m_pGroups[g].pGainBuffer;
+    m_ppChannelPeak[j] = (g == 0) ? m_pPeakBuffer : m_pGroups[g].pPeakBuffer;
+  }
+
+  return LIMITER_OK;
+}
+
+/* exchange the maximum search and gain state of the limiter with the one of a channel group,
+   a second call swaps them back. Group 0 is the state of the limiter itself */
+void PeakLimiter::swapGroup(int g)
+{
+  PeakLimiterGroup* group;
+
+  if (g == 0) return;
+
+  group = &m_pGroups[g];
+  std::swap(m_fadedGain,               group->fadedGain);
+  std::swap(m_smoothState,             group->smoothState);
+  std::swap(m_maxBufferIndex,          group->maxBufferIndex);
+  std::swap(m_maxBufferSlowIndex,      group->maxBufferSlowIndex);
+  std::swap(m_maxBufferSectionIndex,   group->maxBufferSectionIndex);
+  std::swap(m_maxBufferSectionCounter, group->maxBufferSectionCounter);
+  std::swap(m_maxMaxBufferSlow,        group->maxMaxBufferSlow);
+  std::swap(m_maxCurrentSection,       group->maxCurrentSection);
+  std::swap(m_indexMaxBufferSlow,      group->indexMaxBufferSlow);
+  std::swap(m_vhgwIndex,               group->vhgwIndex);
+  std::swap(m_vhgwBlock,               group->vhgwBlock);
+  std::swap(m_vhgwPrefixMax,           group->vhgwPrefixMax);
+  std::swap(m_vhgwLastBlockMax,        group->vhgwLastBlockMax);
+  std::swap(m_lastMaximum,             group->lastMaximum);
+  std::swap(m_pMaxBuffer,              group->pMaxBuffer);
+  std::swap(m_pMaxBufferSlow,          group->pMaxBufferSlow);
+  std::swap(m_pIndexMaxInSection,      group->pIndexMaxInSection);
+  std::swap(m_pVhgwValues,             group->pVhgwValues);
+  std::swap(m_pVhgwSuffix,             group->pVhgwSuffix);
+  std::swap(m_pPeakBuffer,             group->pPeakBuffer);
+  std::swap(m_pGainBuffer,             group->pGainBuffer);
+}
+
+/* set sampling rate */
+int PeakLimiter::setLimiterSampleRate(int sampleRateIn)
+{
+  int attack;
+
+  if ((sampleRateIn < 1) || (sampleRateIn > m_maxSampleRate)) return LIMITER_INVALID_PARAMETER;
+
+  /* update m_attack/release constants, the attack clamped as in setLimiterAttack:
+     without lookahead (m_zeroLookahead) the delay line stays unused */
+  attack = (int)(m_attackMs * sampleRateIn / 1000);
+
+  if (attack < 1) /* attack time is too short */
+    attack = 1;
+  setAttackLength(attack);
+  m_releaseConst  = (float)pow(0.1, 1.0 / (m_releaseMs * sampleRateIn / 1000 + 1));
+  m_sampleRate    = sampleRateIn;
+
+  /* reset, the channel groups as well */
+  resetLimiter();
+
+  return LIMITER_OK;
+}
+
+/* set m_attack time */
+int PeakLimiter::setLimiterAttack(float attackMsIn)
+{
+  int attack;
+
+  if (attackMsIn > m_maxAttackMs) return LIMITER_INVALID_PARAMETER;
+
+  /* calculate attack time in samples */
+  attack = (int)(attackMsIn * m_sampleRate / 1000);
+
+  if (attack < 1) /* attack time is too short */
+    attack=1;
+
+  changeAttack(attack);
+  m_attackMs     = attackMsIn;
+  m_zeroLookahead = (attackMsIn == 0);
+
+  return LIMITER_OK;
+}
+
+/* set release time */
+int PeakLimiter::setLimiterRelease(float releaseMsIn)
+{
+  m_releaseConst = (float)pow(0.1, 1.0 / (releaseMsIn * m_sampleRate / 1000 + 1));
+  m_releaseMs = releaseMsIn;
+
+  return LIMITER_OK;
+}
+
+/* set limiter threshold */
+int PeakLimiter::setLimiterThreshold(float thresholdIn)
+{
+  m_threshold = thresholdIn;
+
+  return LIMITER_OK;
+}
+
+/* set limiter threshold */
+float PeakLimiter::getLimiterThreshold()
+{
+  return m_threshold;
+}
+
+/* set processing mode */
+int PeakLimiter::setLimiterProcessingMode(int modeIn)
+{
+  if ((modeIn != PEAKLIMITER_PROCESS_SAMPLE) && (modeIn != PEAKLIMITER_PROCESS_BLOCK)) return LIMITER_INVALID_PARAMETER;
+
+  m_processingMode = modeIn;
+
+  return LIMITER_OK;
+}
+
+/* enable true peak detection */
+int PeakLimiter::setLimiterTruePeak(int truePeakIn)
+{
+  if (truePeakIn && !m_truePeak)
+    memset(m_pTruePeakHistory,0,sizeof(float)*(PEAKLIMITER_TRUEPEAK_TAPS-1) * m_maxChannels);
+
+  m_truePeak = (truePeakIn != 0);
+
+  return LIMITER_OK;
+}
+
+/* select processing kernels */
+int PeakLimiter::setLimiterKernels(int isaIn)
+{
+  const PeakLimiterKernels* kernels = getPeakLimiterKernels(isaIn);
+
+  if (kernels == NULL) return LIMITER_INVALID_PARAMETER;
+
+  m_pKernels = kernels;
+
+  return LIMITER_OK;
+}
+
+
+
+/* post parameters from a control thread */
+int PeakLimiter::setLimiterParameters(const PeakLimiterParameters* params)
+{
+  int old;
+
+  if ((params == NULL) || (params->attackMs > m_maxAttackMs)) return LIMITER_INVALID_PARAMETER;
+
+  m_params[m_paramsBack] = *params;
+  old = m_paramsMiddle.exchange(m_paramsBack | PEAKLIMITER_PARAMS_NEW, std::memory_order_acq_rel);
+  m_paramsBack = old & ~PEAKLIMITER_PARAMS_NEW;
+
+  return LIMITER_OK;
+}
+
+/* pick up the parameters posted since the last call */
+inline void PeakLimiter::pollParameters()
+{
+  if (m_paramsMiddle.load(std::memory_order_acquire) & PEAKLIMITER_PARAMS_NEW)
+    updateParameters();
+}
+
+void PeakLimiter::updateParameters()
+{
+  const PeakLimiterParameters* params;
+  int old;
+
+  old = m_paramsMiddle.exchange(m_paramsFront, std::memory_order_acq_rel);
+  m_paramsFront = old & ~PEAKLIMITER_PARAMS_NEW;
+  params = &m_params[m_paramsFront];
+
+  if (params->threshold != m_threshold)
+    setLimiterThreshold(params->threshold);
+  if (params->releaseMs != m_releaseMs)
+    setLimiterRelease(params->releaseMs);
+  if (params->attackMs != m_attackMs)
+    setLimiterAttack(params->attackMs);
+}
+
+/* rotate the delay line so that the oldest frame is the first one */
+void PeakLimiter::linearizeDelay()
+{
+  std::rotate(m_pDelayBuffer, m_pDelayBuffer + m_delayBufferIndex * m_channels, m_pDelayBuffer + m_attack * m_channels);
+  m_delayBufferIndex = 0;
+}
+
+/* lengths and constant of an attack of attack samples */
+void PeakLimiter::setAttackLength(int attack)
+{
+  m_attack = attack;
+
+  /* length of m_pMaxBuffer sections */
+  m_sectionLen = (int)sqrt((float)m_attack+1);
+
+  m_nbrMaxBufferSection   = (m_attack+1)/m_sectionLen;
+  if (m_nbrMaxBufferSection*m_sectionLen < (m_attack+1))
+    m_nbrMaxBufferSection++;
+  m_vhgwBlockLen = (m_attack+1)/2;
+  m_attackConst  = (float)pow(0.1, 1.0 / (m_attack + 1));
+}
+
+/* restart the maximum search for an attack of attack samples with its last peaks */
+void PeakLimiter::restartMax(int attack)
+{
+  int i, nPeaks;
+  float* values;
+
+  /* last peaks, oldest first */
+  if (m_maxEngine == PEAKLIMITER_MAX_VHGW) {
+    nPeaks = 0;
+    values = m_pVhgwValues + m_vhgwBlock * m_vhgwBlockLen;
+    for (i = m_vhgwIndex; i < m_vhgwBlockLen; i++)
+      m_pPeakHistory[nPeaks++] = values[i];
+    values = m_pVhgwValues + (1 - m_vhgwBlock) * m_vhgwBlockLen;
+    for (i = 0; i < m_vhgwBlockLen; i++)
+      m_pPeakHistory[nPeaks++] = values[i];
+    values = m_pVhgwValues + m_vhgwBlock * m_vhgwBlockLen;
+    for (i = 0; i < m_vhgwIndex; i++)
+      m_pPeakHistory[nPeaks++] = values[i];
+  }
+  else {
+    nPeaks = m_attack + 1;
+    for (i = 0; i < nPeaks; i++)
+      m_pPeakHistory[i] = m_pMaxBuffer[(m_maxBufferIndex + i) % nPeaks];
+  }
+
+  setAttackLength(attack);
+
+  /* the next peak completes the window */
+  resetMax();
+  for (i = max(0, nPeaks - m_attack); i < nPeaks; i++) {
+    if (m_maxEngine == PEAKLIMITER_MAX_VHGW)
+      m_lastMaximum = updateMaxVhgw(m_pPeakHistory[i]);
+    else
+      m_lastMaximum = updateMaxSections(m_pPeakHistory[i]);
+  }
+}
+
+/* change the attack time without reset.
+   The delay line keeps its latest samples: output frame k of the new delay line is
+   the old delay line frame k - (attack - m_attack), crossfaded over
+   PEAKLIMITER_CROSSFADE_LEN frames with frame k of the old one, which would have been
+   output otherwise. When the delay line more than doubles, the old frames run out
+   before the new ones start: the old ones fade out and the new ones fade in.
+   The maximum search of each channel group is restarted with its last peaks */
+void PeakLimiter::changeAttack(int attack)
+{
+  int j, k, g, first, last, step, fadeLen, shift, start, oldAttack;
+  float w, ramp, older, newer;
+
+  if (attack == m_attack) return;
+
+  /* new delay line, in place: forward when it gets shorter since frame k reads
+     frames k and k + shift, backward when it gets longer */
+  linearizeDelay();
+  fadeLen = min(PEAKLIMITER_CROSSFADE_LEN, min(m_attack, attack));
+  shift = attack - m_attack;
+  start = (shift <= 0) ? 0 : min(shift, m_attack - fadeLen);
+  if (shift < 0) {
+    first = 0; last = attack; step = 1;
+  }
+  else {
+    first = attack - 1; last = -1; step = -1;
+  }
+  for (k = first; k != last; k += step) {
+    w = (float)(k - start + 1) / (fadeLen + 1);
+    w = max(0.0f, min(1.0f, w));
+    ramp = 1.0f;
+    if (start < shift)
+      ramp = max(0.0f, min(1.0f, (float)(k - shift + 1) / (fadeLen + 1)));
+    for (j = 0; j < m_channels; j++) {
+      older = (k < m_attack) ? m_pDelayBuffer[k * m_channels + j] : 0.0f;
+      newer = (k >= shift) ? m_pDelayBuffer[(k - shift) * m_channels + j] : 0.0f;
+      m_pDelayBuffer[k * m_channels + j] = older * (1.0f - w) + newer * w * ramp;
+    }
+  }
+
+  /* each group reads its last peaks with the lengths of the old attack */
+  oldAttack = m_attack;
+  for (g = 0; g < m_nGroups; g++) {
+    swapGroup(g);
+    setAttackLength(oldAttack);
+    restartMax(attack);
+    swapGroup(g);
+  }
+  m_delayUnchecked = m_attack;   /* crossfaded samples */
+}
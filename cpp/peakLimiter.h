@@ -1,214 +1,700 @@
-/*
-Copyright (c) 2016, UMR STMS 9912 - Ircam-Centre Pompidou / CNRS / UPMC
-All rights reserved.
-
-Redistribution and use in source and binary forms, with or without
-modification, are permitted provided that the following conditions are met:
-    * Redistributions of source code must retain the above copyright
-      notice, this list of conditions and the following disclaimer.
-    * Redistributions in binary form must reproduce the above copyright
-      notice, this list of conditions and the following disclaimer in the
-      documentation and/or other materials provided with the distribution.
-    * Neither the name of the <organization> nor the
-      names of its contributors may be used to endorse or promote products
-      derived from this software without specific prior written permission.
-
-THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
-ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
-WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
-DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
-DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
-(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
-LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
-ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
-(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
-SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
-*/
-
-#include <stdlib.h>
-#include <math.h>
-#include <stdio.h>
-#include <string.h>
-
-#ifndef __peaklimiter_h__
-#define __peaklimiter_h__
-
-enum {
-  LIMITER_OK = 0,
-
-  __error_codes_start = -100,
-
-  LIMITER_INVALID_HANDLE,
-  LIMITER_INVALID_PARAMETER,
-
-  __error_codes_end
-};
-
-#define PEAKLIMITER_ATTACK_DEFAULT_MS      (20.0f)               /* default attack  time in ms */
-#define PEAKLIMITER_RELEASE_DEFAULT_MS     (20.0f)              /* default release time in ms */
-
-
-class PeakLimiter
-{
-
-public:
-  int  m_attack;
-  float         m_attackConst, m_releaseConst;
-  float         m_attackMs, m_releaseMs, m_maxAttackMs;
-  float         m_threshold;
-  int  m_channels, m_maxChannels;
-  int  m_sampleRate, m_maxSampleRate;
-  float         m_fadedGain;
-  float*        m_pMaxBuffer;
-  float*        m_pMaxBufferSlow;
-  float*        m_pDelayBuffer;
-  int  m_maxBufferIndex, m_maxBufferSlowIndex, m_delayBufferIndex;
-  int  m_sectionLen, m_nbrMaxBufferSection;
-  int  m_maxBufferSectionIndex, m_maxBufferSectionCounter;
-  float        m_smoothState;
-  float         m_maxMaxBufferSlow, m_maxCurrentSection;
-  int m_indexMaxBufferSlow, *m_pIndexMaxInSection;
-    
-public:
-
-/******************************************************************************
-* createLimiter                                                               *
-* maxAttackMs:   maximum attack/lookahead time in milliseconds                *
-* releaseMs:     release time in milliseconds (90% time constant)             *
-* threshold:     limiting threshold                                           *
-* maxChannels:   maximum number of channels                                   *
-* maxSampleRate: maximum sampling rate in Hz                                  *
-* returns:       limiter handle                                               *
-******************************************************************************/
-PeakLimiter(               float         maxAttackMs, 
-                           float         releaseMs, 
-                           float         threshold, 
-                           int  maxChannels, 
-                           int  maxSampleRate);
-~PeakLimiter();
-/******************************************************************************
-* resetLimiter                                                                *
-* limiter: limiter handle                                                     *
-* returns: error code                                                         *
-******************************************************************************/
-int resetLimiter();
-
-/******************************************************************************
-* destroyLimiter                                                              *
-* limiter: limiter handle                                                     *
-* returns: error code                                                         *
-******************************************************************************/
-int destroyLimiter();
-
-/******************************************************************************
-* applyLimiter                                                                *
-* limiter:  limiter handle                                                    *
-* samplesIn:  input buffer containing interleaved samples                *
-* samplesOut:  output buffer containing interleaved samples                *
-* nSamples: number of samples per channel                                     *
-* returns:  error code                                                        *
-******************************************************************************/
-int applyLimiter_E( 
-                 const float*       samplesIn, 
-                 float*       samplesOut, 
-                 int nSamples);
-
-/******************************************************************************
-* applyLimiter                                                                *
-* limiter:  limiter handle                                                    *
-* samplesIn:  input buffer containing no interleaved samples                *
-* samplesOut:  output buffer containing interleaved samples                *
-* nSamples: number of samples per channel                                     *
-* returns:  error code                                                        *
-******************************************************************************/
-int applyLimiter(
-                 const float**       samplesIn, 
-                 float**       samplesOut, 
-                 int nSamples);
-
-/******************************************************************************
-* applyLimiter                                                                *
-* limiter:  limiter handle                                                    *
-* samples:  input/output buffer containing no interleaved samples                *
-* nSamples: number of samples per channel                                     *
-* returns:  error code                                                        *
-******************************************************************************/
-int applyLimiter_I(
-                 float**       samples, 
-                 int nSamples);
-
-/******************************************************************************
-* applyLimiter                                                                *
-* limiter:  limiter handle                                                    *
-* samples:  input/output buffer containing interleaved samples                *
-* nSamples: number of samples per channel                                     *
-* returns:  error code                                                        *
-******************************************************************************/
-int applyLimiter_E_I(
-                 float*       samples, 
-                 int nSamples);
-
-/******************************************************************************
-* getLimiterDelay                                                             *
-* limiter: limiter handle                                                     *
-* returns: exact delay caused by the limiter in samples                       *
-******************************************************************************/
- int getLimiterDelay();
-
- int getLimiterSampleRate();
-
-float getLimiterAttack();
-
-float getLimiterRelease();
-
-float getLimiterThreshold();
-
-/******************************************************************************
-* getLimiterMaxGainReduction                                                  *
-* limiter: limiter handle                                                     *
-* returns: maximum gain reduction in last processed block in dB               *
-******************************************************************************/
-float getLimiterMaxGainReduction();
-
-/******************************************************************************
-* setLimiterNChannels                                                         *
-* limiter:   limiter handle                                                   *
-* nChannels: number of channels ( <= maxChannels specified on create)         *
-* returns:   error code                                                       *
-******************************************************************************/
-int setLimiterNChannels( int nChannels);
-
-/******************************************************************************
-* setLimiterSampleRate                                                        *
-* limiter:    limiter handle                                                  *
-* sampleRate: sampling rate in Hz ( <= maxSampleRate specified on create)     *
-* returns:    error code                                                      *
-******************************************************************************/
-int setLimiterSampleRate( int sampleRate);
-
-/******************************************************************************
-* setLimiterAttack                                                            *
-* limiter:    limiter handle                                                  *
-* attackMs:   attack time in ms ( <= maxAttackMs specified on create)         *
-* returns:    error code                                                      *
-******************************************************************************/
-int setLimiterAttack( float attackMs);
-
-/******************************************************************************
-* setLimiterRelease                                                           *
-* limiter:    limiter handle                                                  *
-* releaseMs:  release time in ms                                              *
-* returns:    error code                                                      *
-******************************************************************************/
-int setLimiterRelease( float releaseMs);
-
-/******************************************************************************
-* setLimiterThreshold                                                         *
-* limiter:    limiter handle                                                  *
-* threshold:  limiter threshold                                               *
-* returns:    error code                                                      *
-******************************************************************************/
-int setLimiterThreshold( float threshold);
-};
-
-#endif /* __peaklimiter_h__ */
+/*
+Copyright (c) 2016, UMR STMS 9912 - Ircam-Centre Pompidou / CNRS / UPMC
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the <organization> nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <stdlib.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <atomic>
+
+#ifndef __peaklimiter_h__
+#define __peaklimiter_h__
+
+#include "peakLimiterSimd.h"
+#include "peakLimiterRing.h"
+
+enum {
+  LIMITER_OK = 0,
+
+  __error_codes_start = -100,
+
+  LIMITER_INVALID_HANDLE,
+  LIMITER_INVALID_PARAMETER,
+
+  __error_codes_end
+};
+
+enum {
+  PEAKLIMITER_PROCESS_SAMPLE = 0,   /* detector, gain and delay line sample by sample */
+  PEAKLIMITER_PROCESS_BLOCK         /* detector, gain curve and delay line stage by stage on blocks */
+};
+
+enum {
+  PEAKLIMITER_MAX_SECTIONS = 0,     /* sqrt(attack) sections, rescanned when their maximum leaves the window */
+  PEAKLIMITER_MAX_VHGW              /* van Herk/Gil-Werman blocks, exact maximum at a constant cost per sample */
+};
+
+#define PEAKLIMITER_ATTACK_DEFAULT_MS      (20.0f)               /* default attack  time in ms */
+#define PEAKLIMITER_RELEASE_DEFAULT_MS     (20.0f)              /* default release time in ms */
+#define PEAKLIMITER_BLOCK_SIZE             (256)                /* samples per detector/gain pass */
+#define PEAKLIMITER_CROSSFADE_LEN          (64)                 /* crossfade of the delay line on an attack change */
+#define PEAKLIMITER_ALIGN                  (64)                 /* alignment of the state buffers, a cache line */
+#define PEAKLIMITER_TIMING_BINS            (32)                 /* log2 bins of the call duration histogram */
+
+/* counters of the processing events, see getLimiterStats. Off by default: the counting
+   is not compiled in and costs nothing, build with -DPEAKLIMITER_STATS=1 to turn it on */
+#ifndef PEAKLIMITER_STATS
+#define PEAKLIMITER_STATS                  (0)
+#endif
+
+/* maximum search and gain state of a channel group other than group 0, whose state is
+   the one of the limiter, see setLimiterChannelGroups. Swapped with the members of the
+   limiter of the same name while the gain curve of the group is computed */
+typedef struct {
+  float         fadedGain, smoothState;
+  int           maxBufferIndex, maxBufferSlowIndex;
+  int           maxBufferSectionIndex, maxBufferSectionCounter;
+  float         maxMaxBufferSlow, maxCurrentSection;
+  int           indexMaxBufferSlow;
+  int           vhgwIndex, vhgwBlock;
+  float         vhgwPrefixMax, vhgwLastBlockMax;
+  float         lastMaximum;
+  float*        pMaxBuffer;
+  float*        pMaxBufferSlow;
+  int*          pIndexMaxInSection;
+  float*        pVhgwValues;
+  float*        pVhgwSuffix;
+  float*        pPeakBuffer;
+  float*        pGainBuffer;
+} PeakLimiterGroup;
+
+/* upper bound of getLimiterMemorySize for an attack of maxAttack samples,
+   for memory sized at compile time, see PeakLimiterFixed. Includes the state
+   of maxChannels-1 channel groups besides the one of the limiter */
+#define PEAKLIMITER_MEMORY_BOUND(maxAttack, maxChannels) \
+  (sizeof(int) * ((maxAttack) + 1) * (maxChannels) \
+   + sizeof(float) * (6 * ((maxAttack) + 1) + (maxAttack) * (maxChannels) + 4 * PEAKLIMITER_BLOCK_SIZE \
+                      + (PEAKLIMITER_TRUEPEAK_TAPS - 1) * ((maxChannels) + 1)) \
+   + ((maxChannels) - 1) * (sizeof(float) * (5 * ((maxAttack) + 1) + 2 * PEAKLIMITER_BLOCK_SIZE) \
+                            + 7 * PEAKLIMITER_ALIGN) \
+   + (sizeof(PeakLimiterGroup) + sizeof(int) + 2 * sizeof(float*)) * (maxChannels) \
+   + 17 * PEAKLIMITER_ALIGN)
+
+/* parameters posted by a control thread, see setLimiterParameters */
+typedef struct {
+  float         attackMs;
+  float         releaseMs;
+  float         threshold;
+} PeakLimiterParameters;
+
+/* meter record of one applyLimiter call, see setLimiterMetering */
+typedef struct {
+  int64_t       position;           /* first input sample of the call, counted from the creation */
+  int           nSamples;           /* samples per channel, several calls when records were merged */
+  float         maxGainReduction;   /* maximum gain reduction in dB */
+  float         inputPeak;          /* maximum absolute input sample */
+  float         outputPeak;         /* maximum absolute output sample */
+  int           clipCount;          /* output samples clamped to +/- threshold by the hard clip */
+} PeakLimiterMeter;
+
+/* duration of the applyLimiter calls, see setLimiterTiming. Ticks are the CPU time stamp
+   counter (x86), the virtual counter (ARM64) or ns elsewhere, see getPeakLimiterTicks */
+typedef struct {
+  int64_t       calls;              /* applyLimiter calls since timing was enabled */
+  int64_t       samples;            /* samples per channel of these calls */
+  uint64_t      totalTicks;         /* ticks of all the calls */
+  uint64_t      lastTicks;          /* ticks of the last call */
+  uint64_t      maxTicks;           /* ticks of the longest call */
+  int           maxTicksSamples;    /* samples per channel of the longest call */
+  uint64_t      lastNs;             /* wall clock time of the last call in ns */
+  uint64_t      maxNs;              /* wall clock time of the longest call in ns */
+  int64_t       histogram[PEAKLIMITER_TIMING_BINS]; /* calls of 2^k to 2^(k+1)-1 ticks */
+} PeakLimiterTiming;
+
+/* applyLimiter entry points, for the calls counted in PeakLimiterStats */
+enum {
+  PEAKLIMITER_ENTRY_E = 0,          /* applyLimiter_E */
+  PEAKLIMITER_ENTRY_PLANAR,         /* applyLimiter */
+  PEAKLIMITER_ENTRY_I,              /* applyLimiter_I */
+  PEAKLIMITER_ENTRY_E_I,            /* applyLimiter_E_I */
+  PEAKLIMITER_ENTRY_E_INT16,
+  PEAKLIMITER_ENTRY_INT16,
+  PEAKLIMITER_ENTRY_E_INT24,
+  PEAKLIMITER_ENTRY_INT24,
+  PEAKLIMITER_ENTRY_E_INT32,
+  PEAKLIMITER_ENTRY_INT32,
+  PEAKLIMITER_NBR_ENTRIES
+};
+
+/* processing events since the creation or resetLimiterStats, see getLimiterStats.
+   Only counted when built with PEAKLIMITER_STATS */
+typedef struct {
+  int           enabled;            /* PEAKLIMITER_STATS of the build, all counters are 0 without it */
+  int64_t       calls[PEAKLIMITER_NBR_ENTRIES]; /* applyLimiter calls per entry point */
+  int64_t       samples;            /* samples per channel of these calls */
+  int64_t       sectionRescans;     /* sections engine: rescans of the current section, its maximum left the window */
+  int64_t       sectionRescanSamples; /* samples read by these rescans */
+  int64_t       slowRescans;        /* sections engine: rescans of all the section maxima, the overall maximum left the window */
+  int64_t       slowRescanSections; /* section maxima read by these rescans */
+  int64_t       quietBlocks;        /* blocks of the fast path below the threshold */
+  int64_t       quietSamples;       /* samples per channel of these blocks */
+  int64_t       limitedSamples;     /* samples with a gain below 1, once per group with channel groups */
+  int64_t       clipSamples;        /* output samples clamped to +/- threshold by the hard clip */
+} PeakLimiterStats;
+
+struct PeakLimiterProcess;
+
+class PeakLimiter
+{
+
+public:
+  int  m_attack;
+  float         m_attackConst, m_releaseConst;
+  float         m_attackMs, m_releaseMs, m_maxAttackMs;
+  float         m_threshold;
+  int  m_channels, m_maxChannels;
+  int  m_sampleRate, m_maxSampleRate;
+  char*         m_pMemory;                /* all the buffers below, cache line aligned */
+  char*         m_pMemoryBlock;           /* allocation of m_pMemory, NULL for caller memory */
+  float*        m_pMaxBuffer;
+  float*        m_pMaxBufferSlow;
+  float*        m_pDelayBuffer;
+  int  m_sectionLen, m_nbrMaxBufferSection;
+  int*          m_pIndexMaxInSection;
+  float*        m_pPeakBuffer;
+  float*        m_pGainBuffer;
+  int           m_processingMode;
+  int           m_truePeak;
+  int           m_zeroLookahead;          /* attack 0: gain applied to the current samples, see setLimiterAttack */
+  float*        m_pTruePeakHistory;
+  float*        m_pTruePeakBuffer;
+  const PeakLimiterKernels* m_pKernels;
+  int           m_maxEngine;
+  int           m_vhgwBlockLen;
+  float*        m_pVhgwValues;
+  float*        m_pVhgwSuffix;
+  const PeakLimiterProcess* m_pProcess;
+  float*        m_pPeakHistory;
+  PeakLimiterParameters m_params[3];      /* triple buffer: slots owned by the control thread, */
+  std::atomic<int> m_paramsMiddle;        /* the processing call, and in between (+ new flag)  */
+  int           m_paramsBack, m_paramsFront;
+  PeakLimiterRing<PeakLimiterMeter>* m_pMeterRing;
+  PeakLimiterMeter m_meterPending;        /* merged records waiting for room in the ring */
+  int           m_meterPendingValid;
+  int64_t       m_meterPosition;
+  float*        m_pMeterBuffer;
+  int           m_nGroups;                /* channel groups, see setLimiterChannelGroups */
+  PeakLimiterGroup* m_pGroups;            /* max/gain state of each group, [0] unused: the state of this limiter */
+  int*          m_pChannelGroup;          /* group of each channel */
+  float**       m_ppChannelPeak;          /* peak buffer of each channel, the one of its group */
+  const float** m_ppChannelGain;          /* gain curve of each channel, the one of its group */
+  int           m_timing;                 /* call durations, see setLimiterTiming */
+  int           m_flushDenormals;         /* see setLimiterFlushDenormals */
+  int           m_flushSoftware;          /* flush requested, without a hardware mode: the true peak filter flushes */
+  std::atomic<unsigned int> m_timingSeq;  /* odd while the counters below are updated */
+  std::atomic<int64_t>  m_timingCalls, m_timingSamples;
+  std::atomic<uint64_t> m_timingTotalTicks, m_timingLastTicks, m_timingMaxTicks;
+  std::atomic<int>      m_timingMaxTicksSamples;
+  std::atomic<uint64_t> m_timingLastNs, m_timingMaxNs;
+  std::atomic<int64_t>  m_timingHistogram[PEAKLIMITER_TIMING_BINS];
+
+  /* state written on every sample, padded on its own cache lines so that
+     limiters of an array processed by different threads do not share them */
+  char          m_padStateBegin[PEAKLIMITER_ALIGN];
+  float         m_fadedGain;
+  float         m_smoothState;
+  float         m_minGain;
+  int  m_maxBufferIndex, m_maxBufferSlowIndex, m_delayBufferIndex;
+  int  m_maxBufferSectionIndex, m_maxBufferSectionCounter;
+  float         m_maxMaxBufferSlow, m_maxCurrentSection;
+  int           m_indexMaxBufferSlow;
+  int           m_vhgwIndex, m_vhgwBlock;
+  float         m_vhgwPrefixMax, m_vhgwLastBlockMax;
+  float         m_lastMaximum;            /* lookahead maximum of the last sample */
+  int           m_delayUnchecked;         /* samples of the delay line not seen by the maximum search */
+  PeakLimiterStats m_stats;               /* see getLimiterStats, only updated with PEAKLIMITER_STATS */
+  char          m_padStateEnd[PEAKLIMITER_ALIGN];
+    
+public:
+
+/******************************************************************************
+* createLimiter                                                               *
+* maxAttackMs:   maximum attack/lookahead time in milliseconds, 0 for a       *
+*                limiter without lookahead, see setLimiterAttack              *
+* releaseMs:     release time in milliseconds (90% time constant)             *
+* threshold:     limiting threshold                                           *
+* maxChannels:   maximum number of channels                                   *
+* maxSampleRate: maximum sampling rate in Hz                                  *
+* maxEngine:     lookahead maximum search, PEAKLIMITER_MAX_SECTIONS (default) *
+*                or PEAKLIMITER_MAX_VHGW for a constant cost per sample       *
+* memory:        NULL (default): the limiter allocates its state itself       *
+*                otherwise memory of memorySize bytes for the state, at least *
+*                getLimiterMemorySize, owned by the caller and kept until the *
+*                limiter is destroyed. Any alignment, it is aligned inside.   *
+* returns:       limiter handle                                               *
+* all the state lives in a single cache line aligned block. If the block     *
+* cannot be allocated or the caller memory is too small, all buffers are     *
+* NULL and getLimiterMemory returns NULL                                      *
+******************************************************************************/
+PeakLimiter(               float         maxAttackMs, 
+                           float         releaseMs, 
+                           float         threshold, 
+                           int  maxChannels, 
+                           int  maxSampleRate,
+                           int  maxEngine = PEAKLIMITER_MAX_SECTIONS,
+                           void*         memory = NULL,
+                           size_t        memorySize = 0);
+
+/******************************************************************************
+* getLimiterMemorySize                                                        *
+* same parameters as the constructor                                          *
+* returns:       size in bytes of the memory for the limiter state, to place  *
+*                limiters in a caller arena or pool                           *
+******************************************************************************/
+static size_t getLimiterMemorySize(
+                           float         maxAttackMs,
+                           int  maxChannels,
+                           int  maxSampleRate,
+                           int  maxEngine = PEAKLIMITER_MAX_SECTIONS);
+
+/******************************************************************************
+* getLimiterMemory                                                            *
+* limiter: limiter handle                                                     *
+* returns: aligned state block, NULL when the limiter could not be created    *
+******************************************************************************/
+void* getLimiterMemory();
+
+~PeakLimiter();
+/******************************************************************************
+* resetLimiter                                                                *
+* limiter: limiter handle                                                     *
+* returns: error code                                                         *
+******************************************************************************/
+int resetLimiter();
+
+/******************************************************************************
+* destroyLimiter                                                              *
+* limiter: limiter handle                                                     *
+* returns: error code                                                         *
+******************************************************************************/
+int destroyLimiter();
+
+/******************************************************************************
+* applyLimiter                                                                *
+* limiter:  limiter handle                                                    *
+* samplesIn:  input buffer containing interleaved samples                *
+* samplesOut:  output buffer containing interleaved samples                *
+* nSamples: number of samples per channel                                     *
+* returns:  error code                                                        *
+******************************************************************************/
+int applyLimiter_E( 
+                 const float*       samplesIn, 
+                 float*       samplesOut, 
+                 int nSamples);
+
+/******************************************************************************
+* applyLimiter                                                                *
+* limiter:  limiter handle                                                    *
+* samplesIn:  input buffer containing no interleaved samples                *
+* samplesOut:  output buffer containing no interleaved samples             *
+* nSamples: number of samples per channel                                     *
+* returns:  error code                                                        *
+******************************************************************************/
+int applyLimiter(
+                 const float**       samplesIn, 
+                 float**       samplesOut, 
+                 int nSamples);
+
+/******************************************************************************
+* applyLimiter                                                                *
+* limiter:  limiter handle                                                    *
+* samples:  input/output buffer containing no interleaved samples                *
+* nSamples: number of samples per channel                                     *
+* returns:  error code                                                        *
+******************************************************************************/
+int applyLimiter_I(
+                 float**       samples, 
+                 int nSamples);
+
+/******************************************************************************
+* applyLimiter                                                                *
+* limiter:  limiter handle                                                    *
+* samples:  input/output buffer containing interleaved samples                *
+* nSamples: number of samples per channel                                     *
+* returns:  error code                                                        *
+******************************************************************************/
+int applyLimiter_E_I(
+                 float*       samples, 
+                 int nSamples);
+
+/******************************************************************************
+* analyzeLimiter_E                                                            *
+* limiter:  limiter handle                                                    *
+* samplesIn:  input buffer containing interleaved samples                     *
+* gain:     receives the gain of each output sample of applyLimiter_E on the  *
+*           same input, i.e. of the input delayed by getLimiterDelay(): the   *
+*           output is that sample times the gain, clamped to +/- threshold    *
+* nSamples: number of samples per channel                                     *
+* returns:  error code                                                        *
+* Detector and gain only, the delay line is not filled: reset the limiter     *
+* before applyLimiter calls. Not with channel groups                          *
+******************************************************************************/
+int analyzeLimiter_E(
+                 const float*       samplesIn,
+                 float*       gain,
+                 int nSamples);
+
+/******************************************************************************
+* applyLimiter_E_Int16, applyLimiter_E_Int24, applyLimiter_E_Int32           *
+* limiter:     limiter handle                                                 *
+* samplesIn:   input buffer containing interleaved integer samples            *
+*              (Int24: packed little endian, 3 bytes per sample)              *
+* samplesOut:  output buffer containing interleaved integer samples,          *
+*              may be the same buffer as samplesIn                            *
+* nSamples:    number of samples per channel                                  *
+* returns:     error code                                                     *
+* full scale is 1.0, the output is clipped to the threshold and saturated     *
+* to the integer range                                                        *
+******************************************************************************/
+int applyLimiter_E_Int16(
+                 const int16_t*     samplesIn,
+                 int16_t*           samplesOut,
+                 int nSamples);
+
+int applyLimiter_E_Int24(
+                 const uint8_t*     samplesIn,
+                 uint8_t*           samplesOut,
+                 int nSamples);
+
+int applyLimiter_E_Int32(
+                 const int32_t*     samplesIn,
+                 int32_t*           samplesOut,
+                 int nSamples);
+
+/******************************************************************************
+* applyLimiter_Int16, applyLimiter_Int24, applyLimiter_Int32                  *
+* limiter:     limiter handle                                                 *
+* samplesIn:   input buffers containing no interleaved integer samples        *
+* samplesOut:  output buffers containing no interleaved integer samples,      *
+*              may be the same buffers as samplesIn                           *
+* nSamples:    number of samples per channel                                  *
+* returns:     error code                                                     *
+******************************************************************************/
+int applyLimiter_Int16(
+                 const int16_t**    samplesIn,
+                 int16_t**          samplesOut,
+                 int nSamples);
+
+int applyLimiter_Int24(
+                 const uint8_t**    samplesIn,
+                 uint8_t**          samplesOut,
+                 int nSamples);
+
+int applyLimiter_Int32(
+                 const int32_t**    samplesIn,
+                 int32_t**          samplesOut,
+                 int nSamples);
+
+/******************************************************************************
+* getLimiterDelay                                                             *
+* limiter: limiter handle                                                     *
+* returns: exact delay caused by the limiter in samples, the attack in        *
+*          samples, 0 without lookahead                                       *
+******************************************************************************/
+ int getLimiterDelay();
+
+ int getLimiterSampleRate();
+
+float getLimiterAttack();
+
+float getLimiterRelease();
+
+float getLimiterThreshold();
+
+/******************************************************************************
+* getLimiterMaxGainReduction                                                  *
+* limiter: limiter handle                                                     *
+* returns: maximum gain reduction in last applyLimiter call in dB             *
+******************************************************************************/
+float getLimiterMaxGainReduction();
+
+/******************************************************************************
+* setLimiterMetering                                                          *
+* limiter:    limiter handle                                                  *
+* nRecords:   size of the meter ring, 0 (default) disables metering          *
+* returns:    error code                                                      *
+* each applyLimiter call pushes a PeakLimiterMeter record into a single       *
+* producer/single consumer lock-free ring. When the ring is full, the         *
+* records are merged until there is room, so no event is lost.               *
+* Allocates: not to be called while processing or reading the meters         *
+******************************************************************************/
+int setLimiterMetering( int nRecords);
+
+/******************************************************************************
+* readLimiterMeters                                                           *
+* limiter:    limiter handle                                                  *
+* records:    receives up to maxRecords records, oldest first                 *
+* returns:    number of records read                                          *
+* lock-free and allocation free, may be called from any one thread while     *
+* the limiter is processing                                                   *
+******************************************************************************/
+int readLimiterMeters( PeakLimiterMeter* records, int maxRecords);
+
+/******************************************************************************
+* setLimiterTiming                                                            *
+* limiter:    limiter handle                                                  *
+* timing:     0 (default): no timing                                          *
+*             1: each applyLimiter call is timed in ticks and in ns, the      *
+*             counters are cleared                                            *
+* returns:    error code                                                      *
+* Not to be called while processing. For a bounded cost per call whatever the *
+* signal, create the limiter with PEAKLIMITER_MAX_VHGW: the sections engine   *
+* rescans its slow buffer when the maximum leaves the window. The bound holds *
+* for calls without attack or sample rate change, which rebuild the delay     *
+* line and the maximum, and with setLimiterFlushDenormals on                  *
+******************************************************************************/
+int setLimiterTiming( int timing);
+
+/******************************************************************************
+* setLimiterFlushDenormals                                                    *
+* limiter:    limiter handle                                                  *
+* flush:      1 (default): each applyLimiter call runs with subnormal floats  *
+*             flushed to zero (FTZ/DAZ on x86, FZ on ARM), the floating point *
+*             mode of the caller is restored on return. Fading tails then do  *
+*             not slow the processing down. Where there is no such mode       *
+*             (WebAssembly) the true peak filter flushes its input samples    *
+*             below -600 dB.                                                  *
+*             Subnormal input samples, below -750 dB, may come out as 0.      *
+*             0: the floating point mode of the caller is used                *
+* returns:    error code                                                      *
+* Not to be called while processing                                           *
+******************************************************************************/
+int setLimiterFlushDenormals( int flush);
+
+/******************************************************************************
+* getLimiterTiming                                                            *
+* limiter:    limiter handle                                                  *
+* timing:     receives the counters, a consistent snapshot                    *
+* returns:    error code                                                      *
+* lock-free, may be called from any thread while the limiter is processing    *
+******************************************************************************/
+int getLimiterTiming( PeakLimiterTiming* timing);
+
+/******************************************************************************
+* getLimiterStats                                                             *
+* limiter:    limiter handle                                                  *
+* stats:      receives the counters of the processing events: calls per entry *
+*             point, rescans of the sections engine, fast path blocks, gain   *
+*             limited samples and hard clips. All 0, with enabled 0, unless   *
+*             the limiter is built with PEAKLIMITER_STATS                     *
+* returns:    error code                                                      *
+* Not to be called while processing                                           *
+******************************************************************************/
+int getLimiterStats( PeakLimiterStats* stats);
+
+/******************************************************************************
+* resetLimiterStats                                                           *
+* limiter:    limiter handle                                                  *
+* returns:    error code                                                      *
+* clears the counters of getLimiterStats, not to be called while processing   *
+******************************************************************************/
+int resetLimiterStats();
+
+/******************************************************************************
+* setLimiterNChannels                                                         *
+* limiter:   limiter handle                                                   *
+* nChannels: number of channels ( <= maxChannels specified on create)         *
+*            the limiter is not reset: the delayed samples of the remaining   *
+*            channels are kept, the new channels start with silence           *
+* returns:   error code                                                       *
+******************************************************************************/
+int setLimiterNChannels( int nChannels);
+
+/******************************************************************************
+* setLimiterChannelGroups                                                     *
+* limiter:       limiter handle                                               *
+* channelGroups: group of each channel, from 0 to nGroups-1, or NULL to link  *
+*                all channels (default)                                       *
+* nChannels:     number of entries of channelGroups ( <= maxChannels), the    *
+*                other channels go to group 0                                 *
+* returns:       error code                                                   *
+* each group has its own maximum search and gain, e.g. { 0, 0, 0, 1, 0, 0 }   *
+* limits the LFE of a 5.1 signal separately, { 0, 0, 1, 1, 2, 2 } three       *
+* stereo stems. All channels still share one delay line and one pass over     *
+* the samples. The new groups start from silence. Their state is part of      *
+* the limiter memory, sized for maxChannels groups: nothing is allocated,     *
+* but not to be called while processing                                       *
+******************************************************************************/
+int setLimiterChannelGroups( const int* channelGroups, int nChannels);
+
+/******************************************************************************
+* setLimiterSampleRate                                                        *
+* limiter:    limiter handle                                                  *
+* sampleRate: sampling rate in Hz ( <= maxSampleRate specified on create)     *
+* returns:    error code                                                      *
+******************************************************************************/
+int setLimiterSampleRate( int sampleRate);
+
+/******************************************************************************
+* setLimiterAttack                                                            *
+* limiter:    limiter handle                                                  *
+* attackMs:   attack time in ms ( <= maxAttackMs specified on create)         *
+*             the limiter is not reset: the delay line is shortened or        *
+*             lengthened with a PEAKLIMITER_CROSSFADE_LEN samples crossfade   *
+*             and the lookahead maximum is rebuilt from the last peaks        *
+* returns:    error code                                                      *
+* The lookahead, and the delay, is attackMs rounded down to whole samples,    *
+* at least 1 sample. Short lookaheads suit live monitoring: the gain cannot   *
+* fully follow the fastest peaks, the hard clip at the threshold then keeps   *
+* the ceiling. 0 removes the lookahead: no delay, the gain is applied to the  *
+* current samples with the attack smoothing of 1 sample, and the hard clip    *
+* catches every peak the gain has not reached yet. Switching to or from 0     *
+* jumps by the delay, without crossfade.                                      *
+******************************************************************************/
+int setLimiterAttack( float attackMs);
+
+/******************************************************************************
+* setLimiterRelease                                                           *
+* limiter:    limiter handle                                                  *
+* releaseMs:  release time in ms                                              *
+* returns:    error code                                                      *
+******************************************************************************/
+int setLimiterRelease( float releaseMs);
+
+/******************************************************************************
+* setLimiterThreshold                                                         *
+* limiter:    limiter handle                                                  *
+* threshold:  limiter threshold                                               *
+* returns:    error code                                                      *
+******************************************************************************/
+int setLimiterThreshold( float threshold);
+
+/******************************************************************************
+* setLimiterKernels                                                           *
+* limiter:    limiter handle                                                  *
+* isa:        instruction set used by the processing kernels, one of         *
+*             PEAKLIMITER_ISA_* (default: PEAKLIMITER_ISA_BEST)               *
+* returns:    error code                                                      *
+******************************************************************************/
+int setLimiterKernels( int isa);
+
+/******************************************************************************
+* setLimiterProcessingMode                                                    *
+* limiter:    limiter handle                                                  *
+* mode:       PEAKLIMITER_PROCESS_SAMPLE (default) or PEAKLIMITER_PROCESS_BLOCK *
+*             both modes give the same output, the block mode runs the        *
+*             detector, the gain curve and the delay line one after the other *
+*             on PEAKLIMITER_BLOCK_SIZE samples                               *
+* returns:    error code                                                      *
+******************************************************************************/
+int setLimiterProcessingMode( int mode);
+
+/******************************************************************************
+* setLimiterTruePeak                                                          *
+* limiter:    limiter handle                                                  *
+* truePeak:   0 (default): the detector uses the sample peaks                 *
+*             1: the detector also uses the inter-sample peaks, estimated by  *
+*             4x oversampling as in ITU-R BS.1770-4 Annex 2                   *
+* returns:    error code                                                      *
+******************************************************************************/
+int setLimiterTruePeak( int truePeak);
+
+/******************************************************************************
+* setLimiterParameters                                                        *
+* limiter:    limiter handle                                                  *
+* params:     attack, release and threshold, with the limits of the setters   *
+*             above                                                           *
+* returns:    error code                                                      *
+* lock-free handoff from a control thread: the parameters are picked up at    *
+* the start of the next applyLimiter call, without reset. Only the latest     *
+* parameters posted before that call are applied. The number of channels is  *
+* not part of it since it is tied to the buffers of the processing thread,   *
+* see setLimiterNChannels                                                     *
+******************************************************************************/
+int setLimiterParameters( const PeakLimiterParameters* params);
+
+private:
+static size_t layoutMemory( PeakLimiter* limiter, char* memory, int attack, int maxChannels, int maxEngine);
+void pollParameters();
+void updateParameters();
+void linearizeDelay();
+void changeAttack( int attack);
+void setAttackLength( int attack);
+void restartMax( int attack);
+void resetMax();
+float updateMaxSections( float peak);
+float updateMaxVhgw( float peak);
+float updateGain( float peak);
+void selectProcess();
+template <class Layout, int NCHANNELS> void detectTruePeak( const Layout& samples, int offset, int nSamples, int nChannels);
+template <class Layout, int NCHANNELS> void meterOutput( const Layout& samples, int offset, int nSamples, int nChannels,
+                                                         float* outputPeak, int* clipCount);
+void pushMeter( int nSamples, float minGain, float inputPeak, float outputPeak, int clipCount);
+void updateTiming( int nSamples, uint64_t ticks, uint64_t ns);
+template <class Layout, int NCHANNELS> int process( Layout samples, int nSamples);
+template <class Layout, int NCHANNELS> int processBlocks( Layout samples, int nSamples);
+template <class Layout, int NCHANNELS> int processQuiet( Layout samples, int offset, int nSamples, int nChannels);
+template <class Layout> int processGroups( Layout samples, int nSamples);
+void swapGroup( int group);
+template <class Format, int NCHANNELS> int processInterleaved( const void* samplesIn, void* samplesOut, int nSamples);
+template <class Format, int NCHANNELS> int processPlanar( const void* const* samplesIn, void* const* samplesOut, int nSamples);
+template <int NCHANNELS> static const PeakLimiterProcess* getProcess();
+};
+
+/******************************************************************************
+* PeakLimiterFixed                                                            *
+* limiter with its state inline, for compile-time limits: MAXATTACK samples   *
+* of attack and MAXCHANNELS channels. No allocation at all, e.g. as a member  *
+* or in an array. maxAttackMs and maxChannels of the constructor are clamped  *
+* to these limits.                                                            *
+******************************************************************************/
+template <int MAXATTACK, int MAXCHANNELS>
+class PeakLimiterFixed : public PeakLimiter
+{
+public:
+  char m_memoryInline[PEAKLIMITER_MEMORY_BOUND(MAXATTACK, MAXCHANNELS)];
+
+  PeakLimiterFixed(        float         maxAttackMs,
+                           float         releaseMs,
+                           float         threshold,
+                           int  maxChannels,
+                           int  maxSampleRate,
+                           int  maxEngine = PEAKLIMITER_MAX_SECTIONS)
+    : PeakLimiter(maxAttackMs * maxSampleRate / 1000 > MAXATTACK ? (float)MAXATTACK * 1000 / maxSampleRate : maxAttackMs,
+                  releaseMs, threshold,
+                  maxChannels > MAXCHANNELS ? MAXCHANNELS : maxChannels,
+                  maxSampleRate, maxEngine, m_memoryInline, sizeof(m_memoryInline))
+  {
+  }
+
+private:
+  PeakLimiterFixed(const PeakLimiterFixed&);
+  PeakLimiterFixed& operator=(const PeakLimiterFixed&);
+};
+
+#endif /* __peaklimiter_h__ */
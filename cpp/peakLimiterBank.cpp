@@ -0,0 +1,411 @@
+/*
+Copyright (c) 2016, UMR STMS 9912 - Ircam-Centre Pompidou / CNRS / UPMC
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the <organization> nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "peakLimiterBank.h"
+
+#ifndef min
+#define min(a, b)   (((a) < (b)) ? (a) : (b))
+#endif
+
+/* create limiter bank */
+PeakLimiterBank::PeakLimiterBank(
+                           float         attackMsIn,
+                           float         releaseMsIn,
+                           float         thresholdIn,
+                           int           nStreamsIn,
+                           int           nChannelsIn,
+                           int           sampleRateIn
+                           )
+{
+  /* calc m_attack time in samples */
+  m_attack = (int)(attackMsIn * sampleRateIn / 1000);
+
+  if (m_attack < 1) /* m_attack time is too short */
+    m_attack = 1;
+
+  m_streams      = nStreamsIn;
+  m_lanes        = (nStreamsIn + PEAKLIMITERBANK_LANE_ALIGN - 1) / PEAKLIMITERBANK_LANE_ALIGN * PEAKLIMITERBANK_LANE_ALIGN;
+  m_channels     = nChannelsIn;
+  m_vhgwBlockLen = (m_attack+1)/2;
+
+  /* alloc delay lines, block buffer and lane states */
+  m_pDelayBuffer      = new float[m_attack * m_channels * m_streams];
+  m_pBlockBuffer      = new float[PEAKLIMITERBANK_BLOCK_SIZE * m_lanes];
+  m_pMaximum          = new float[m_lanes];
+  m_pFadedGain        = new float[m_lanes];
+  m_pSmoothState      = new float[m_lanes];
+  m_pVhgwPrefixMax    = new float[m_lanes];
+  m_pVhgwLastBlockMax = new float[m_lanes];
+  m_pVhgwValues       = new float[2 * m_vhgwBlockLen * m_lanes];
+  m_pVhgwSuffix       = new float[2 * m_vhgwBlockLen * m_lanes];
+
+  m_attackMs      = attackMsIn;
+  m_releaseMs     = releaseMsIn;
+  m_attackConst   = (float)pow(0.1, 1.0 / (m_attack + 1));
+  m_releaseConst  = (float)pow(0.1, 1.0 / (releaseMsIn * sampleRateIn / 1000 + 1));
+  m_threshold     = thresholdIn;
+  m_sampleRate    = sampleRateIn;
+  m_pKernels      = getPeakLimiterKernels(PEAKLIMITER_ISA_BEST);
+  m_flushDenormals = 1;
+
+  memset(m_pBlockBuffer,0,sizeof(float)*PEAKLIMITERBANK_BLOCK_SIZE * m_lanes);
+  resetLimiter();
+}
+
+PeakLimiterBank::~PeakLimiterBank()
+{
+    destroyLimiter();
+}
+
+/* reset all the streams */
+int PeakLimiterBank::resetLimiter()
+{
+    int s;
+
+    m_delayBufferIndex = 0;
+    m_vhgwIndex = 0;
+    m_vhgwBlock = 0;
+
+    for (s = 0; s < m_lanes; s++) {
+      m_pMaximum[s] = 0;
+      m_pFadedGain[s] = 1.0f;
+      m_pSmoothState[s] = 1.0f;
+      m_pVhgwPrefixMax[s] = 0;
+      m_pVhgwLastBlockMax[s] = 0;
+    }
+
+    memset(m_pDelayBuffer,0,sizeof(float)*m_attack * m_channels * m_streams);
+    memset(m_pVhgwValues,0,sizeof(float)*2*m_vhgwBlockLen * m_lanes);
+    memset(m_pVhgwSuffix,0,sizeof(float)*2*m_vhgwBlockLen * m_lanes);
+
+    return LIMITER_OK;
+}
+
+/* reset one stream: silence in its lane of every row gives the same
+   output as a new limiter, whatever the position in the blocks */
+int PeakLimiterBank::resetLimiterStream(int stream)
+{
+    int k;
+
+    if ((stream < 0) || (stream >= m_streams)) return LIMITER_INVALID_PARAMETER;
+
+    m_pMaximum[stream] = 0;
+    m_pFadedGain[stream] = 1.0f;
+    m_pSmoothState[stream] = 1.0f;
+    m_pVhgwPrefixMax[stream] = 0;
+    m_pVhgwLastBlockMax[stream] = 0;
+
+    for (k = 0; k < 2 * m_vhgwBlockLen; k++) {
+      m_pVhgwValues[k * m_lanes + stream] = 0;
+      m_pVhgwSuffix[k * m_lanes + stream] = 0;
+    }
+    memset(m_pDelayBuffer + stream * m_attack * m_channels,0,sizeof(float)*m_attack * m_channels);
+
+    return LIMITER_OK;
+}
+
+/* destroy limiter bank */
+int PeakLimiterBank::destroyLimiter()
+{
+    if (m_pDelayBuffer)
+    {
+        delete [] m_pDelayBuffer;
+        m_pDelayBuffer = NULL;
+    }
+    if (m_pBlockBuffer)
+    {
+        delete [] m_pBlockBuffer;
+        m_pBlockBuffer = NULL;
+    }
+    if (m_pMaximum)
+    {
+        delete [] m_pMaximum;
+        m_pMaximum = NULL;
+    }
+    if (m_pFadedGain)
+    {
+        delete [] m_pFadedGain;
+        m_pFadedGain = NULL;
+    }
+    if (m_pSmoothState)
+    {
+        delete [] m_pSmoothState;
+        m_pSmoothState = NULL;
+    }
+    if (m_pVhgwPrefixMax)
+    {
+        delete [] m_pVhgwPrefixMax;
+        m_pVhgwPrefixMax = NULL;
+    }
+    if (m_pVhgwLastBlockMax)
+    {
+        delete [] m_pVhgwLastBlockMax;
+        m_pVhgwLastBlockMax = NULL;
+    }
+    if (m_pVhgwValues)
+    {
+        delete [] m_pVhgwValues;
+        m_pVhgwValues = NULL;
+    }
+    if (m_pVhgwSuffix)
+    {
+        delete [] m_pVhgwSuffix;
+        m_pVhgwSuffix = NULL;
+    }
+
+    return LIMITER_OK;
+}
+
+/* push one row of peaks into the van Herk/Gil-Werman blocks of all the lanes,
+   m_pMaximum receives the maximum over the last m_attack+1 samples of each lane.
+   Same steps as PeakLimiter::updateMaxVhgw, each one on a whole row */
+inline void PeakLimiterBank::updateMaxVhgw(const float* peak)
+{
+    int first;
+    float *values, *lastValues, *suffix, *lastSuffix, *tmp;
+
+    values     = m_pVhgwValues + m_vhgwBlock * m_vhgwBlockLen * m_lanes;
+    lastValues = m_pVhgwValues + (1 - m_vhgwBlock) * m_vhgwBlockLen * m_lanes;
+    suffix     = m_pVhgwSuffix + m_vhgwBlock * m_vhgwBlockLen * m_lanes;
+    lastSuffix = m_pVhgwSuffix + (1 - m_vhgwBlock) * m_vhgwBlockLen * m_lanes;
+
+    memcpy(values + m_vhgwIndex * m_lanes, peak, sizeof(float) * m_streams);
+    m_pKernels->laneMax(m_pVhgwPrefixMax, peak, m_pVhgwPrefixMax, m_streams);
+
+    /* one more row of suffix maxima of the previous block */
+    first = m_vhgwBlockLen - 1 - m_vhgwIndex;
+    if (m_vhgwIndex == 0)
+        memcpy(lastSuffix + first * m_lanes, lastValues + first * m_lanes, sizeof(float) * m_streams);
+    else
+        m_pKernels->laneMax(lastValues + first * m_lanes, lastSuffix + (first + 1) * m_lanes,
+                            lastSuffix + first * m_lanes, m_streams);
+
+    m_pKernels->laneMax(m_pVhgwLastBlockMax, m_pVhgwPrefixMax, m_pMaximum, m_streams);
+    first = m_vhgwIndex + 2 * m_vhgwBlockLen - m_attack;
+    if (first < m_vhgwBlockLen)
+        m_pKernels->laneMax(m_pMaximum, suffix + first * m_lanes, m_pMaximum, m_streams);
+
+    m_vhgwIndex++;
+    if (m_vhgwIndex >= m_vhgwBlockLen) {
+        m_vhgwIndex = 0;
+        m_vhgwBlock = 1 - m_vhgwBlock;
+        tmp = m_pVhgwLastBlockMax;
+        m_pVhgwLastBlockMax = m_pVhgwPrefixMax;
+        m_pVhgwPrefixMax = tmp;
+        memset(m_pVhgwPrefixMax,0,sizeof(float)*m_streams);
+    }
+}
+
+/* detector of one stream: maximum absolute value of all channels, at least
+   threshold, written to the lane of the stream in each row */
+template <int NCHANNELS>
+static inline void detectStream(const float* x, int nSamples, int nChannels, float threshold,
+                                float* peak, int lanes)
+{
+    int i, j;
+    float tmp, maximum;
+
+    if (NCHANNELS > 0)
+        nChannels = NCHANNELS;
+
+    for (i = 0; i < nSamples; i++, x += nChannels) {
+        maximum = threshold;
+        for (j = 0; j < nChannels; j++) {
+            tmp = (float)fabs(x[j]);
+            maximum = (maximum > tmp) ? maximum : tmp;
+        }
+        peak[i * lanes] = maximum;
+    }
+}
+
+/* delay line and gain of one stream, the gains are read from its lane of each row */
+template <int NCHANNELS>
+static inline void applyGainStream(const float* x, float* y, int nSamples, int nChannels, float threshold,
+                                   float* delayLine, int delayIndex, int delayLen,
+                                   const float* gain, int lanes)
+{
+    int i, j;
+    float tmp, g;
+    float* delay;
+
+    if (NCHANNELS > 0)
+        nChannels = NCHANNELS;
+
+    for (i = 0; i < nSamples; i++, x += nChannels, y += nChannels) {
+        g = gain[i * lanes];
+        delay = delayLine + delayIndex * nChannels;
+        for (j = 0; j < nChannels; j++) {
+            tmp = delay[j];
+            delay[j] = x[j];
+
+            tmp *= g;
+            if (tmp > threshold) tmp = threshold;
+            if (tmp < -threshold) tmp = -threshold;
+
+            y[j] = tmp;
+        }
+        delayIndex++;
+        if (delayIndex >= delayLen)
+            delayIndex = 0;
+    }
+}
+
+/* apply limiter bank: the detector and the delay lines go stream by stream through
+   the stream buffers, the maximum search and the gain update go sample by sample
+   through rows of all the streams */
+template <int NCHANNELS>
+inline int PeakLimiterBank::process(const float* const* samplesIn, float* const* samplesOut, int nSamples)
+{
+    int i, s, n, blockLen;
+    const int nChannels = (NCHANNELS > 0) ? NCHANNELS : m_channels;
+    const int lanes = m_lanes;
+    const float threshold = m_threshold;
+    float* row;
+
+    for (n = 0; n < nSamples; n += blockLen) {
+        blockLen = min(PEAKLIMITERBANK_BLOCK_SIZE, nSamples - n);
+
+        /* peaks */
+        for (s = 0; s < m_streams; s++)
+            detectStream<NCHANNELS>(samplesIn[s] + n * nChannels, blockLen, nChannels, threshold,
+                                    m_pBlockBuffer + s, lanes);
+
+        /* gains, written over the peaks */
+        for (i = 0; i < blockLen; i++) {
+            row = m_pBlockBuffer + i * lanes;
+            updateMaxVhgw(row);
+            m_pKernels->laneGain(m_pMaximum, m_pFadedGain, m_pSmoothState, row, m_streams,
+                                 threshold, m_attackConst, m_releaseConst);
+        }
+
+        /* fill delay lines, apply gain */
+        for (s = 0; s < m_streams; s++)
+            applyGainStream<NCHANNELS>(samplesIn[s] + n * nChannels, samplesOut[s] + n * nChannels, blockLen,
+                                       nChannels, threshold, m_pDelayBuffer + s * m_attack * nChannels,
+                                       m_delayBufferIndex, m_attack, m_pBlockBuffer + s, lanes);
+
+        m_delayBufferIndex = (m_delayBufferIndex + blockLen) % m_attack;
+    }
+
+    return LIMITER_OK;
+}
+
+/* apply limiter bank, with subnormals flushed to zero when setLimiterFlushDenormals is on */
+int PeakLimiterBank::applyLimiter_E(const float* const* samplesIn, float* const* samplesOut, int nSamples)
+{
+    int err;
+    uint64_t fpState = 0;
+
+    if (m_flushDenormals)
+        enterPeakLimiterFlushDenormals(&fpState);
+    switch (m_channels) {
+    case 1:  err = process<1>(samplesIn, samplesOut, nSamples); break;
+    case 2:  err = process<2>(samplesIn, samplesOut, nSamples); break;
+    default: err = process<0>(samplesIn, samplesOut, nSamples); break;
+    }
+    if (m_flushDenormals)
+        leavePeakLimiterFlushDenormals(fpState);
+
+    return err;
+}
+
+/* get delay in samples */
+int PeakLimiterBank::getLimiterDelay()
+{
+  return m_attack;
+}
+
+/* get number of streams */
+int PeakLimiterBank::getLimiterNStreams()
+{
+  return m_streams;
+}
+
+/* get attack in ms */
+float PeakLimiterBank::getLimiterAttack()
+{
+  return m_attackMs;
+}
+
+/* get release in ms */
+float PeakLimiterBank::getLimiterRelease()
+{
+  return m_releaseMs;
+}
+
+/* get limiter threshold */
+float PeakLimiterBank::getLimiterThreshold()
+{
+  return m_threshold;
+}
+
+/* get current gain reduction of one stream */
+float PeakLimiterBank::getLimiterGainReduction(int stream)
+{
+  if ((stream < 0) || (stream >= m_streams)) return 0;
+
+  return -20 * (float)log10(m_pSmoothState[stream]);
+}
+
+/* set release time */
+int PeakLimiterBank::setLimiterRelease(float releaseMsIn)
+{
+  m_releaseConst = (float)pow(0.1, 1.0 / (releaseMsIn * m_sampleRate / 1000 + 1));
+  m_releaseMs = releaseMsIn;
+
+  return LIMITER_OK;
+}
+
+/* set limiter threshold */
+int PeakLimiterBank::setLimiterThreshold(float thresholdIn)
+{
+  m_threshold = thresholdIn;
+
+  return LIMITER_OK;
+}
+
+/* select processing kernels */
+int PeakLimiterBank::setLimiterKernels(int isaIn)
+{
+  const PeakLimiterKernels* kernels = getPeakLimiterKernels(isaIn);
+
+  if (kernels == NULL) return LIMITER_INVALID_PARAMETER;
+
+  m_pKernels = kernels;
+
+  return LIMITER_OK;
+}
+
+/* flush subnormals to zero while processing */
+int PeakLimiterBank::setLimiterFlushDenormals(int flushIn)
+{
+  if ((flushIn != 0) && (flushIn != 1)) return LIMITER_INVALID_PARAMETER;
+
+  m_flushDenormals = flushIn;
+
+  return LIMITER_OK;
+}
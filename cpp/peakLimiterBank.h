@@ -0,0 +1,180 @@
+/*
+Copyright (c) 2016, UMR STMS 9912 - Ircam-Centre Pompidou / CNRS / UPMC
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the <organization> nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __peaklimiterbank_h__
+#define __peaklimiterbank_h__
+
+#include "peakLimiter.h"
+
+#define PEAKLIMITERBANK_BLOCK_SIZE         (32)    /* samples per detector/gain pass, the block buffer holds one row per sample */
+#define PEAKLIMITERBANK_LANE_ALIGN         (16)    /* rows of lanes are padded to a multiple of this number of floats */
+
+/******************************************************************************
+* PeakLimiterBank                                                             *
+* many independent limiters with the same settings, processed together.      *
+* The state is stored as rows of one float per stream (lane), so that the     *
+* maximum search and the gain update of all streams are single SIMD passes:   *
+* the van Herk/Gil-Werman maximum search is used, since its schedule does     *
+* not depend on the signal and is the same for all streams.                   *
+* Each stream gives the same output as a PeakLimiter created with             *
+* PEAKLIMITER_MAX_VHGW and the same settings.                                 *
+******************************************************************************/
+class PeakLimiterBank
+{
+
+public:
+  int           m_attack;
+  float         m_attackConst, m_releaseConst;
+  float         m_attackMs, m_releaseMs;
+  float         m_threshold;
+  int           m_streams, m_lanes, m_channels;
+  int           m_sampleRate;
+  float*        m_pDelayBuffer;         /* one delay line of m_attack frames per stream */
+  int           m_delayBufferIndex;
+  float*        m_pBlockBuffer;         /* one row per sample: peaks, then gains */
+  float*        m_pMaximum;
+  float*        m_pFadedGain;
+  float*        m_pSmoothState;
+  int           m_vhgwBlockLen, m_vhgwIndex, m_vhgwBlock;
+  float*        m_pVhgwPrefixMax;
+  float*        m_pVhgwLastBlockMax;
+  float*        m_pVhgwValues;          /* 2 * m_vhgwBlockLen rows */
+  float*        m_pVhgwSuffix;          /* 2 * m_vhgwBlockLen rows */
+  const PeakLimiterKernels* m_pKernels;
+  int           m_flushDenormals;       /* see setLimiterFlushDenormals */
+
+public:
+
+/******************************************************************************
+* createLimiterBank                                                           *
+* attackMs:    attack/lookahead time in milliseconds                          *
+* releaseMs:   release time in milliseconds (90% time constant)               *
+* threshold:   limiting threshold                                             *
+* nStreams:    number of independent streams                                  *
+* nChannels:   number of channels of each stream                              *
+* sampleRate:  sampling rate in Hz                                            *
+******************************************************************************/
+PeakLimiterBank(           float         attackMs,
+                           float         releaseMs,
+                           float         threshold,
+                           int           nStreams,
+                           int           nChannels,
+                           int           sampleRate);
+~PeakLimiterBank();
+
+/******************************************************************************
+* resetLimiter                                                                *
+* resets all the streams                                                      *
+* returns: error code                                                         *
+******************************************************************************/
+int resetLimiter();
+
+/******************************************************************************
+* resetLimiterStream                                                          *
+* stream:  index of the stream to reset, the other streams are not affected   *
+*          (e.g. a new listener taking over the stream)                       *
+* returns: error code                                                         *
+******************************************************************************/
+int resetLimiterStream( int stream);
+
+/******************************************************************************
+* destroyLimiter                                                              *
+* returns: error code                                                         *
+******************************************************************************/
+int destroyLimiter();
+
+/******************************************************************************
+* applyLimiter_E                                                              *
+* samplesIn:   nStreams input buffers containing interleaved samples          *
+* samplesOut:  nStreams output buffers containing interleaved samples,        *
+*              samplesOut[s] may be the same buffer as samplesIn[s]           *
+* nSamples:    number of samples per channel, the same for all streams        *
+* returns:     error code                                                     *
+******************************************************************************/
+int applyLimiter_E(
+                 const float* const* samplesIn,
+                 float* const*       samplesOut,
+                 int nSamples);
+
+/******************************************************************************
+* getLimiterDelay                                                             *
+* returns: exact delay caused by the limiter in samples                       *
+******************************************************************************/
+int getLimiterDelay();
+
+int getLimiterNStreams();
+
+float getLimiterAttack();
+
+float getLimiterRelease();
+
+float getLimiterThreshold();
+
+/******************************************************************************
+* getLimiterGainReduction                                                     *
+* stream:  stream index                                                       *
+* returns: current gain reduction of the stream in dB                         *
+******************************************************************************/
+float getLimiterGainReduction( int stream);
+
+/******************************************************************************
+* setLimiterRelease                                                           *
+* releaseMs:  release time in ms, for all streams                             *
+* returns:    error code                                                      *
+******************************************************************************/
+int setLimiterRelease( float releaseMs);
+
+/******************************************************************************
+* setLimiterThreshold                                                         *
+* threshold:  limiter threshold, for all streams                              *
+* returns:    error code                                                      *
+******************************************************************************/
+int setLimiterThreshold( float threshold);
+
+/******************************************************************************
+* setLimiterKernels                                                           *
+* isa:        instruction set used by the processing kernels, one of         *
+*             PEAKLIMITER_ISA_* (default: PEAKLIMITER_ISA_BEST)               *
+* returns:    error code                                                      *
+******************************************************************************/
+int setLimiterKernels( int isa);
+
+/******************************************************************************
+* setLimiterFlushDenormals                                                    *
+* flush:      1 (default): subnormal floats flushed to zero during            *
+*             applyLimiter_E, see PeakLimiter::setLimiterFlushDenormals       *
+*             0: the floating point mode of the caller is used                *
+* returns:    error code                                                      *
+******************************************************************************/
+int setLimiterFlushDenormals( int flush);
+
+private:
+void updateMaxVhgw( const float* peak);
+template <int NCHANNELS> int process( const float* const* samplesIn, float* const* samplesOut, int nSamples);
+};
+
+#endif /* __peaklimiterbank_h__ */
@@ -0,0 +1,845 @@
+/*
+Copyright (c) 2016, UMR STMS 9912 - Ircam-Centre Pompidou / CNRS / UPMC
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the <organization> nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* Benchmark of the applyLimiter entry points, with a check of their output.
+
+   build:  c++ -O2 -std=c++11 -pthread peakLimiterBench.cpp peakLimiter.cpp peakLimiterSimd.cpp peakLimiterStream.cpp \
+               peakLimiterOffline.cpp peakLimiterEnvelope.cpp peakLimiterExecutor.cpp \
+               peakLimiterBank.cpp -o peakLimiterBench
+   usage:  peakLimiterBench [-full] [-engine sections|vhgw] [-isa n] [-mode sample|block] [-repeat n]
+                            [-truepeak] [-denormals on|off]
+
+   Each case runs applyLimiter_E_I, applyLimiter_E, applyLimiter_I and applyLimiter on the same
+   signal, cut in blocks, and reports the samples per second (per channel), the ns per sample and
+   channel, and the 99th percentile and maximum time of one call. By default the matrix is swept one
+   axis at a time around 2 channels, 5 ms, 48 kHz, 256 samples, dense clipping; -full runs the
+   whole matrix.
+
+   The tail signal is clipping noise fading out over the whole signal, through the subnormal floats
+   (below -760 dB) in its second half. Its ns per sample and channel are also given for each quarter
+   of the signal. Once the gain is back to 1 the fast path below the threshold only copies the
+   tail; -truepeak adds the true peak filter, which does not skip it. With -truepeak the quarters
+   stay flat with -denormals on, the default (setLimiterFlushDenormals), while with -denormals off
+   the last two get about 40 times slower on x86.
+
+   The output of the first pass is compared, bit for bit, with a scalar reference:
+   - vhgw engine: a plain limiter written below, exact maximum over the lookahead window
+   - sections engine: its maximum is exact only up to the section boundaries, so the reference is
+     the limiter itself with the scalar kernels, sample by sample (PEAKLIMITER_ISA_SCALAR,
+     PEAKLIMITER_PROCESS_SAMPLE), which is the original code path
+   Outputs below FLT_MIN on both sides match: subnormals are flushed to zero, or not, depending on
+   the mode and on the path of the block. The plain limiter has no true peak filter: with -truepeak
+   and the vhgw engine the output is not checked.
+   Before the cases, the checks:
+   - limiters with an attack of 0 and of 1 sample change their sample rate and are compared with
+     limiters created at the new rate
+   - the delay compensated stream of peakLimiterFile (PeakLimiterStream), with an attack of 0 and
+     of 5 ms, against the output of a limiter shifted by its delay
+   - channel groups (setLimiterChannelGroups) against a limiter per group on its channels alone
+   - the chunks of PeakLimiterOffline, at the default pre-roll, against its serial run
+   - the gain envelope of PeakLimiterOffline::analyzeLimiter_E, through a file written in the
+     current directory and removed, against PeakLimiterOffline::applyLimiter_E
+   - PeakLimiterExecutor on 4 workers against its limiters run serially
+   - PeakLimiterBank against a limiter per stream
+   - the int16, packed int24 and int32 entry points against the float path on the same
+     quantized samples, its output quantized in turn
+
+   Built with -DPEAKLIMITER_STATS=1, each case is followed by the event counters of its last entry
+   point, per thousand samples: section and slow buffer rescans, fast path, limited samples, clips. */
+
+#include "peakLimiter.h"
+#include "peakLimiterStream.h"
+#include "peakLimiterOffline.h"
+#include "peakLimiterEnvelope.h"
+#include "peakLimiterExecutor.h"
+#include "peakLimiterBank.h"
+
+#include <float.h>
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <vector>
+
+#define BENCH_THRESHOLD     (0.5f)
+#define BENCH_RELEASE_MS    (50.0f)
+#define BENCH_MAX_SAMPLES   (1 << 22)     /* samples of all channels in the signal, 16 MB */
+#define BENCH_SECONDS       (2)
+
+enum {
+  BENCH_SILENCE = 0,
+  BENCH_SUB_THRESHOLD,
+  BENCH_DENSE_CLIPPING,
+  BENCH_BURSTS,
+  BENCH_TAIL,
+  BENCH_NSIGNALS
+};
+
+enum {
+  BENCH_E_I = 0,
+  BENCH_E,
+  BENCH_I,
+  BENCH_PLANAR,
+  BENCH_NENTRIES
+};
+
+static const char* signalNames[BENCH_NSIGNALS] = { "silence", "sub", "dense", "bursts", "tail" };
+static const char* entryNames[BENCH_NENTRIES] = { "E_I", "E", "I", "planar" };
+
+static const int   channelsList[]    = { 1, 2, 6, 8, 16, 64 };
+static const float attackList[]      = { 1.0f, 5.0f, 20.0f };
+static const int   sampleRateList[]  = { 44100, 48000, 96000, 192000 };
+static const int   blockSizeList[]   = { 32, 256, 1024, 4096 };
+
+#define LIST_LEN(list)   ((int)(sizeof(list) / sizeof(list[0])))
+
+typedef struct {
+  int   channels;
+  float attackMs;
+  int   sampleRate;
+  int   blockSize;
+  int   signal;
+} BenchCase;
+
+typedef struct {
+  int   engine;
+  int   isa;
+  int   mode;
+  int   repeat;
+  int   truePeak;
+  int   flushDenormals;
+} BenchSettings;
+
+/* deterministic pseudo-random numbers in [-1, 1] */
+static float noise(unsigned int* state)
+{
+  *state = *state * 1664525u + 1013904223u;
+  return (float)(*state >> 8) / (float)(1 << 23) - 1.0f;
+}
+
+/* interleaved test signal */
+static void makeSignal(std::vector<float>& x, int nFrames, int nChannels, int sampleRate, int signal)
+{
+  unsigned int state = 12345;
+  int i, j, burstLen = sampleRate / 1000, burstEnd = 0;
+  float burstGain = 0, tailGain = 0;
+  double position;
+
+  x.assign((size_t)nFrames * nChannels, 0.0f);
+  for (i = 0; i < nFrames; i++) {
+    if (signal == BENCH_BURSTS && i >= burstEnd + sampleRate / 20 && (noise(&state) > 0.99f)) {
+      burstEnd = i + burstLen;
+      burstGain = 3.0f + 2.0f * noise(&state);
+    }
+    if (signal == BENCH_TAIL) {
+      /* 2 down to FLT_MIN (-760 dB) in the first half, then down to the smallest subnormals */
+      position = 2.0 * i / nFrames;
+      tailGain = 2.0f * (float)pow(10.0, -38.2 * std::min(position, 1.0) - 6.8 * std::max(position - 1.0, 0.0));
+    }
+    for (j = 0; j < nChannels; j++) {
+      float* sample = &x[(size_t)i * nChannels + j];
+      switch (signal) {
+      case BENCH_SILENCE:
+        break;
+      case BENCH_SUB_THRESHOLD:
+        *sample = 0.6f * BENCH_THRESHOLD * (float)sin(2 * M_PI * 440.0 * (j + 1) * i / sampleRate);
+        break;
+      case BENCH_DENSE_CLIPPING:
+        *sample = 2.0f * noise(&state);
+        break;
+      case BENCH_BURSTS:
+        *sample = ((i < burstEnd) ? burstGain : 0.1f) * noise(&state);
+        break;
+      case BENCH_TAIL:
+        *sample = tailGain * noise(&state);
+        break;
+      }
+    }
+  }
+}
+
+/* plain limiter: exact maximum of the last attack+1 peaks, gain smoothing and delay line
+   written as simply as possible, one sample at a time */
+static void referenceLimiter(const PeakLimiter& limiter, const float* x, float* y, int nFrames, int nChannels)
+{
+  const int attack = limiter.m_attack;
+  const float threshold = limiter.m_threshold;
+  std::deque<int> window;                       /* indices of decreasing peaks */
+  std::vector<float> peaks(nFrames), delay((size_t)attack * nChannels, 0.0f);
+  float fadedGain = 1.0f, smoothState = 1.0f, gain, maximum, tmp;
+  int i, j, delayIndex = 0;
+
+  for (i = 0; i < nFrames; i++) {
+    peaks[i] = threshold;
+    for (j = 0; j < nChannels; j++)
+      peaks[i] = std::max(peaks[i], (float)fabs(x[(size_t)i * nChannels + j]));
+
+    while (!window.empty() && peaks[window.back()] <= peaks[i])
+      window.pop_back();
+    window.push_back(i);
+    if (window.front() <= i - (attack + 1))
+      window.pop_front();
+    maximum = peaks[window.front()];
+
+    gain = (maximum > threshold) ? threshold / maximum : 1;
+    if (gain < smoothState)
+      fadedGain = std::min(fadedGain, (gain - 0.1f * smoothState) * 1.11111111f);
+    else
+      fadedGain = gain;
+    if (fadedGain < smoothState) {
+      smoothState = limiter.m_attackConst * (smoothState - fadedGain) + fadedGain;
+      if (gain > smoothState)
+        smoothState = gain;
+    }
+    else {
+      tmp = limiter.m_releaseConst * (smoothState - fadedGain) + fadedGain;
+      smoothState = (tmp == smoothState) ? fadedGain : tmp;
+    }
+
+    for (j = 0; j < nChannels; j++) {
+      tmp = delay[(size_t)delayIndex * nChannels + j];
+      delay[(size_t)delayIndex * nChannels + j] = x[(size_t)i * nChannels + j];
+      tmp *= smoothState;
+      if (tmp > threshold) tmp = threshold;
+      if (tmp < -threshold) tmp = -threshold;
+      y[(size_t)i * nChannels + j] = tmp;
+    }
+    if (++delayIndex >= attack)
+      delayIndex = 0;
+  }
+}
+
+static PeakLimiter* createLimiter(const BenchCase& c, int engine, int isa, int mode, int truePeak, int flushDenormals)
+{
+  PeakLimiter* limiter = new PeakLimiter(c.attackMs, BENCH_RELEASE_MS, BENCH_THRESHOLD, c.channels, c.sampleRate, engine);
+
+  if (limiter->setLimiterKernels(isa) != LIMITER_OK)
+    limiter->setLimiterKernels(PEAKLIMITER_ISA_BEST);
+  limiter->setLimiterProcessingMode(mode);
+  limiter->setLimiterTruePeak(truePeak);
+  limiter->setLimiterFlushDenormals(flushDenormals);
+  return limiter;
+}
+
+/* same output, subnormals aside */
+static inline int sameOutput(float y, float reference)
+{
+  return (y == reference) || ((fabsf(y) < FLT_MIN) && (fabsf(reference) < FLT_MIN));
+}
+
+/* one entry point over the signal, output in interleaved order, returns the call times in ns */
+static void runEntry(PeakLimiter* limiter, int entry, const std::vector<float>& x, std::vector<float>& y,
+                     int nFrames, int nChannels, int blockSize, std::vector<double>& callNs)
+{
+  std::vector<float> work(x), planarIn((size_t)nFrames * nChannels), planarOut((size_t)nFrames * nChannels);
+  std::vector<const float*> in(nChannels);
+  std::vector<float*> out(nChannels), inOut(nChannels);
+  int i, j, n, blockLen;
+
+  for (i = 0; i < nFrames; i++)
+    for (j = 0; j < nChannels; j++)
+      planarIn[(size_t)j * nFrames + i] = x[(size_t)i * nChannels + j];
+  if (entry == BENCH_I)
+    planarOut = planarIn;
+
+  for (n = 0; n < nFrames; n += blockLen) {
+    blockLen = std::min(blockSize, nFrames - n);
+    for (j = 0; j < nChannels; j++) {
+      in[j] = &planarIn[(size_t)j * nFrames + n];
+      out[j] = inOut[j] = &planarOut[(size_t)j * nFrames + n];
+    }
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    switch (entry) {
+    case BENCH_E_I:
+      limiter->applyLimiter_E_I(&work[(size_t)n * nChannels], blockLen);
+      break;
+    case BENCH_E:
+      limiter->applyLimiter_E(&x[(size_t)n * nChannels], &y[(size_t)n * nChannels], blockLen);
+      break;
+    case BENCH_I:
+      limiter->applyLimiter_I(&inOut[0], blockLen);
+      break;
+    case BENCH_PLANAR:
+      limiter->applyLimiter(&in[0], &out[0], blockLen);
+      break;
+    }
+    callNs.push_back((double)std::chrono::duration_cast<std::chrono::nanoseconds>(
+                       std::chrono::steady_clock::now() - start).count());
+  }
+
+  if (entry == BENCH_E_I)
+    y = work;
+  else if (entry != BENCH_E)
+    for (i = 0; i < nFrames; i++)
+      for (j = 0; j < nChannels; j++)
+        y[(size_t)i * nChannels + j] = planarOut[(size_t)j * nFrames + i];
+}
+
+/* sample rate change of a limiter with an attack of 0 or of 1 sample, which rounds to 0 samples
+   at the new rate: the output must be the one of a limiter created at that rate, linked and
+   with one group per channel. Returns the number of mismatching outputs */
+static int checkRateChange()
+{
+  static const float attackMs[2] = { 0.0f, 1000.0f / 48000 };
+  static const int groups[2] = { 0, 1 };
+  const int nFrames = 44100, nChannels = 2;
+  std::vector<float> x, y, reference;
+  PeakLimiter *limiter, *fresh;
+  int a, g, i, bad, mismatches = 0;
+
+  makeSignal(x, nFrames, nChannels, 44100, BENCH_DENSE_CLIPPING);
+  for (a = 0; a < 2; a++) {
+    for (g = 0; g < 2; g++) {
+      limiter = new PeakLimiter(attackMs[a], BENCH_RELEASE_MS, BENCH_THRESHOLD, nChannels, 48000);
+      fresh = new PeakLimiter(attackMs[a], BENCH_RELEASE_MS, BENCH_THRESHOLD, nChannels, 44100);
+      bad = (limiter->setLimiterSampleRate(44100) != LIMITER_OK);
+      if (g) {
+        bad += (limiter->setLimiterChannelGroups(groups, nChannels) != LIMITER_OK);
+        fresh->setLimiterChannelGroups(groups, nChannels);
+      }
+      y = x;
+      reference = x;
+      limiter->applyLimiter_E_I(&y[0], nFrames);
+      fresh->applyLimiter_E_I(&reference[0], nFrames);
+      for (i = 0; i < nFrames * nChannels; i++)
+        bad += (y[i] != reference[i]);
+      printf("rate change, attack %.3f ms%s: %s\n", attackMs[a], g ? ", groups" : "", bad ? "MISMATCH" : "ok");
+      mismatches += bad;
+      delete limiter;
+      delete fresh;
+    }
+  }
+  return mismatches;
+}
+
+/* PeakLimiterStream between two temporary files, delay compensated, against a limiter whose
+   output is shifted by its delay, the tail flushed with silence: none with an attack of 0.
+   Returns the number of mismatching outputs */
+static int checkStream()
+{
+  static const float attackMs[2] = { 0.0f, 5.0f };
+  const int nFrames = 48000, nChannels = 2;
+  std::vector<float> x, y, reference;
+  PeakLimiter *limiter, *direct;
+  PeakLimiterStream* stream;
+  FILE *in, *out;
+  int a, i, delay, bad, mismatches = 0;
+
+  makeSignal(x, nFrames, nChannels, 48000, BENCH_DENSE_CLIPPING);
+  for (a = 0; a < 2; a++) {
+    limiter = new PeakLimiter(attackMs[a], BENCH_RELEASE_MS, BENCH_THRESHOLD, nChannels, 48000);
+    direct = new PeakLimiter(attackMs[a], BENCH_RELEASE_MS, BENCH_THRESHOLD, nChannels, 48000);
+    delay = direct->getLimiterDelay();
+    reference = x;
+    reference.resize((size_t)(nFrames + delay) * nChannels, 0.0f);
+    direct->applyLimiter_E_I(&reference[0], nFrames + delay);
+
+    in = tmpfile();
+    out = tmpfile();
+    fwrite(&x[0], sizeof(float), x.size(), in);
+    fflush(in);
+    rewind(in);
+    stream = new PeakLimiterStream(limiter, PEAKLIMITERSTREAM_FLOAT32, 1000);
+    bad = (stream->runLimiterStream(fileno(in), fileno(out)) != LIMITER_OK);
+    y.assign(x.size() + 1, 0.0f);
+    rewind(out);
+    bad += (fread(&y[0], sizeof(float), y.size(), out) != x.size());
+    for (i = 0; i < nFrames * nChannels; i++)
+      bad += (y[i] != reference[(size_t)delay * nChannels + i]);
+    printf("stream, attack %.0f ms (delay %d): %s\n", attackMs[a], delay, bad ? "MISMATCH" : "ok");
+    mismatches += bad;
+
+    fclose(in);
+    fclose(out);
+    delete stream;
+    delete limiter;
+    delete direct;
+  }
+  return mismatches;
+}
+
+/* channel groups of a 5.1 signal, the LFE apart, and of three stereo stems, with both engines
+   and an attack change half way: the output must be the one of a limiter per group on the
+   channels of the group alone. Returns the number of mismatching outputs */
+static int checkGroups()
+{
+  static const int groups[2][6] = { { 0, 0, 0, 1, 0, 0 }, { 0, 0, 1, 1, 2, 2 } };
+  static const int nGroups[2] = { 2, 3 };
+  const int nFrames = 48000, nChannels = 6, blockSize = 256;
+  std::vector<float> x, y, part, reference;
+  PeakLimiter *limiter, *single;
+  int k, e, g, i, j, n, nPart, blockLen, bad, mismatches = 0;
+
+  makeSignal(x, nFrames, nChannels, 48000, BENCH_BURSTS);
+  for (k = 0; k < 2; k++) {
+    for (e = PEAKLIMITER_MAX_SECTIONS; e <= PEAKLIMITER_MAX_VHGW; e++) {
+      limiter = new PeakLimiter(5.0f, BENCH_RELEASE_MS, BENCH_THRESHOLD, nChannels, 48000, e);
+      bad = (limiter->setLimiterChannelGroups(groups[k], nChannels) != LIMITER_OK);
+      y = x;
+      for (n = 0; n < nFrames; n += blockLen) {
+        blockLen = std::min(blockSize, nFrames - n);
+        if (n == nFrames / 2)
+          limiter->setLimiterAttack(2.0f);
+        limiter->applyLimiter_E_I(&y[(size_t)n * nChannels], blockLen);
+      }
+
+      /* the channels of each group, de-interleaved, through a limiter of their own */
+      reference.assign(x.size(), 0.0f);
+      for (g = 0; g < nGroups[k]; g++) {
+        part.clear();
+        for (i = 0; i < nFrames; i++)
+          for (j = 0; j < nChannels; j++)
+            if (groups[k][j] == g)
+              part.push_back(x[(size_t)i * nChannels + j]);
+        nPart = (int)(part.size() / nFrames);
+        single = new PeakLimiter(5.0f, BENCH_RELEASE_MS, BENCH_THRESHOLD, nPart, 48000, e);
+        for (n = 0; n < nFrames; n += blockLen) {
+          blockLen = std::min(blockSize, nFrames - n);
+          if (n == nFrames / 2)
+            single->setLimiterAttack(2.0f);
+          single->applyLimiter_E_I(&part[(size_t)n * nPart], blockLen);
+        }
+        for (i = 0, n = 0; i < nFrames; i++)
+          for (j = 0; j < nChannels; j++)
+            if (groups[k][j] == g)
+              reference[(size_t)i * nChannels + j] = part[n++];
+        delete single;
+      }
+
+      for (i = 0; i < nFrames * nChannels; i++)
+        bad += !sameOutput(y[i], reference[i]);
+      printf("groups, %d groups, %s engine: %s\n", nGroups[k], (e == PEAKLIMITER_MAX_VHGW) ? "vhgw" : "sections",
+             bad ? "MISMATCH" : "ok");
+      mismatches += bad;
+      delete limiter;
+    }
+  }
+  return mismatches;
+}
+
+/* sample of a signed integer PCM format of bits bits, full scale 1.0, as the integer entry points
+   round and saturate it */
+static int32_t quantize(float x, int bits)
+{
+  double fullScale = ldexp(1.0, bits - 1), v = (double)x * fullScale;
+
+  if (v >= fullScale - 1)
+    return (int32_t)(fullScale - 1);
+  if (v <= -fullScale)
+    return (int32_t)-fullScale;
+  return (int32_t)lrint(v);
+}
+
+/* integer entry points, interleaved and planar, on the bursts signal quantized to 16, 24 and
+   32 bits, with 2 channels (scalar code) and 8 channels (SIMD kernels): the output must be the
+   one of the float path on the same quantized samples, quantized in turn. Returns the number of
+   mismatching outputs */
+static int checkIntegers()
+{
+  static const int bitsList[3] = { 16, 24, 32 };
+  static const int nChannelsList[2] = { 2, 8 };
+  const int nFrames = 48000;
+  std::vector<float> x, xq, reference;
+  std::vector<int32_t> q, y;
+  std::vector<int16_t> buffer16;
+  std::vector<uint8_t> buffer24;
+  std::vector<int32_t> buffer32;
+  std::vector<int16_t*> planar16;
+  std::vector<uint8_t*> planar24;
+  std::vector<int32_t*> planar32;
+  PeakLimiter *limiter, *floatLimiter;
+  int b, c, planar, bits, nChannels, i, j, k, bad, mismatches = 0;
+  size_t nTotal;
+  uint32_t v;
+
+  for (c = 0; c < 2; c++) {
+    nChannels = nChannelsList[c];
+    nTotal = (size_t)nFrames * nChannels;
+    makeSignal(x, nFrames, nChannels, 48000, BENCH_BURSTS);
+    for (b = 0; b < 3; b++) {
+      bits = bitsList[b];
+      q.resize(nTotal);
+      xq.resize(nTotal);
+      for (k = 0; k < (int)nTotal; k++) {
+        q[k] = quantize(x[k], bits);
+        xq[k] = (float)q[k] * (float)ldexp(1.0, 1 - bits);
+      }
+      floatLimiter = new PeakLimiter(5.0f, BENCH_RELEASE_MS, BENCH_THRESHOLD, nChannels, 48000);
+      reference.resize(nTotal);
+      floatLimiter->applyLimiter_E(&xq[0], &reference[0], nFrames);
+      delete floatLimiter;
+
+      for (planar = 0; planar < 2; planar++) {
+        /* interleaved, or planar with channel j at j * nFrames */
+        buffer16.resize(nTotal);
+        buffer24.resize(3 * nTotal);
+        buffer32.resize(nTotal);
+        for (i = 0; i < nFrames; i++)
+          for (j = 0; j < nChannels; j++) {
+            k = planar ? j * nFrames + i : i * nChannels + j;
+            v = (uint32_t)q[(size_t)i * nChannels + j];
+            buffer16[k] = (int16_t)q[(size_t)i * nChannels + j];
+            buffer32[k] = q[(size_t)i * nChannels + j];
+            buffer24[3 * k] = (uint8_t)(v & 0xff);
+            buffer24[3 * k + 1] = (uint8_t)((v >> 8) & 0xff);
+            buffer24[3 * k + 2] = (uint8_t)((v >> 16) & 0xff);
+          }
+        planar16.resize(nChannels);
+        planar24.resize(nChannels);
+        planar32.resize(nChannels);
+        for (j = 0; j < nChannels; j++) {
+          planar16[j] = &buffer16[(size_t)j * nFrames];
+          planar24[j] = &buffer24[(size_t)3 * j * nFrames];
+          planar32[j] = &buffer32[(size_t)j * nFrames];
+        }
+
+        limiter = new PeakLimiter(5.0f, BENCH_RELEASE_MS, BENCH_THRESHOLD, nChannels, 48000);
+        if (planar) {
+          if (bits == 16)
+            bad = limiter->applyLimiter_Int16((const int16_t**)&planar16[0], &planar16[0], nFrames);
+          else if (bits == 24)
+            bad = limiter->applyLimiter_Int24((const uint8_t**)&planar24[0], &planar24[0], nFrames);
+          else
+            bad = limiter->applyLimiter_Int32((const int32_t**)&planar32[0], &planar32[0], nFrames);
+        }
+        else {
+          if (bits == 16)
+            bad = limiter->applyLimiter_E_Int16(&buffer16[0], &buffer16[0], nFrames);
+          else if (bits == 24)
+            bad = limiter->applyLimiter_E_Int24(&buffer24[0], &buffer24[0], nFrames);
+          else
+            bad = limiter->applyLimiter_E_Int32(&buffer32[0], &buffer32[0], nFrames);
+        }
+        bad = (bad != LIMITER_OK);
+        delete limiter;
+
+        y.resize(nTotal);
+        for (i = 0; i < nFrames; i++)
+          for (j = 0; j < nChannels; j++) {
+            k = planar ? j * nFrames + i : i * nChannels + j;
+            if (bits == 16)
+              y[(size_t)i * nChannels + j] = buffer16[k];
+            else if (bits == 24)
+              y[(size_t)i * nChannels + j] = (int32_t)(((uint32_t)buffer24[3 * k] << 8) | ((uint32_t)buffer24[3 * k + 1] << 16)
+                                                       | ((uint32_t)buffer24[3 * k + 2] << 24)) >> 8;
+            else
+              y[(size_t)i * nChannels + j] = buffer32[k];
+          }
+        for (k = 0; k < (int)nTotal; k++)
+          bad += (y[k] != quantize(reference[k], bits));
+        printf("int%d, %s, %d channels: %s\n", bits, planar ? "planar" : "interleaved", nChannels, bad ? "MISMATCH" : "ok");
+        mismatches += bad;
+      }
+    }
+  }
+  return mismatches;
+}
+
+/* bank of 8 streams, each with its own part of the bursts signal, in place: the output must be
+   the one of a limiter per stream with the vhgw engine of the bank. Returns the number of
+   mismatching outputs */
+static int checkBank()
+{
+  const int nStreams = 8, nFrames = 48000, nChannels = 2, blockSize = 256;
+  std::vector<float> x, y, reference;
+  std::vector<float*> streams(nStreams);
+  PeakLimiterBank* bank;
+  PeakLimiter* limiter;
+  int k, i, n, blockLen, bad = 0;
+
+  makeSignal(x, nFrames * nStreams, nChannels, 48000, BENCH_BURSTS);
+  bank = new PeakLimiterBank(5.0f, BENCH_RELEASE_MS, BENCH_THRESHOLD, nStreams, nChannels, 48000);
+  y = x;
+  for (n = 0; n < nFrames; n += blockLen) {
+    blockLen = std::min(blockSize, nFrames - n);
+    for (k = 0; k < nStreams; k++)
+      streams[k] = &y[((size_t)k * nFrames + n) * nChannels];
+    bad += (bank->applyLimiter_E(&streams[0], &streams[0], blockLen) != LIMITER_OK);
+  }
+
+  reference = x;
+  for (k = 0; k < nStreams; k++) {
+    limiter = new PeakLimiter(5.0f, BENCH_RELEASE_MS, BENCH_THRESHOLD, nChannels, 48000, PEAKLIMITER_MAX_VHGW);
+    for (n = 0; n < nFrames; n += blockLen) {
+      blockLen = std::min(blockSize, nFrames - n);
+      limiter->applyLimiter_E_I(&reference[((size_t)k * nFrames + n) * nChannels], blockLen);
+    }
+    delete limiter;
+  }
+  for (i = 0; i < nFrames * nStreams * nChannels; i++)
+    bad += !sameOutput(y[i], reference[i]);
+  printf("bank, %d streams: %s\n", nStreams, bad ? "MISMATCH" : "ok");
+
+  delete bank;
+  return bad;
+}
+
+/* executor of 16 instances on 4 workers, not pinned, each instance with its own part of the
+   bursts signal, period by period: the output must be the one of a limiter per instance
+   run serially. Returns the number of mismatching outputs */
+static int checkExecutor()
+{
+  const int nInstances = 16, nFrames = 48000, nChannels = 2, period = 256;
+  std::vector<float> x, y, reference;
+  PeakLimiterExecutor* executor;
+  PeakLimiter* limiter;
+  int k, i, n, blockLen, bad;
+
+  makeSignal(x, nFrames * nInstances, nChannels, 48000, BENCH_BURSTS);
+  executor = new PeakLimiterExecutor(nInstances, 5.0f, BENCH_RELEASE_MS, BENCH_THRESHOLD, nChannels, 48000,
+                                     PEAKLIMITER_MAX_SECTIONS, 4, 0);
+  y = x;
+  bad = 0;
+  for (n = 0; n < nFrames; n += blockLen) {
+    blockLen = std::min(period, nFrames - n);
+    for (k = 0; k < nInstances; k++)
+      bad += (executor->setExecutorBuffer(k, &y[((size_t)k * nFrames + n) * nChannels]) != LIMITER_OK);
+    bad += (executor->runExecutorPeriod(blockLen) != LIMITER_OK);
+  }
+
+  reference = x;
+  for (k = 0; k < nInstances; k++) {
+    limiter = new PeakLimiter(5.0f, BENCH_RELEASE_MS, BENCH_THRESHOLD, nChannels, 48000);
+    for (n = 0; n < nFrames; n += blockLen) {
+      blockLen = std::min(period, nFrames - n);
+      limiter->applyLimiter_E_I(&reference[((size_t)k * nFrames + n) * nChannels], blockLen);
+    }
+    delete limiter;
+  }
+  for (i = 0; i < nFrames * nInstances * nChannels; i++)
+    bad += !sameOutput(y[i], reference[i]);
+  printf("executor, %d instances on %d workers: %s\n", nInstances, executor->getExecutorNWorkers(), bad ? "MISMATCH" : "ok");
+
+  delete executor;
+  return bad;
+}
+
+/* chunked offline limiter verified against its serial run (setLimiterVerify), with both
+   engines on the bursts and dense clipping signals: with the default pre-roll the chunks
+   must join without any deviation. Returns the number of failed runs */
+static int checkOffline()
+{
+  static const int signals[2] = { BENCH_BURSTS, BENCH_DENSE_CLIPPING };
+  const int nFrames = 4 * 48000, nChannels = 2;
+  std::vector<float> x, y((size_t)nFrames * nChannels);
+  PeakLimiterOffline* offline;
+  int e, k, bad, mismatches = 0;
+
+  for (k = 0; k < 2; k++) {
+    makeSignal(x, nFrames, nChannels, 48000, signals[k]);
+    for (e = PEAKLIMITER_MAX_SECTIONS; e <= PEAKLIMITER_MAX_VHGW; e++) {
+      offline = new PeakLimiterOffline(5.0f, BENCH_RELEASE_MS, BENCH_THRESHOLD, nChannels, 48000, e);
+      offline->setLimiterChunkSize(48000);
+      offline->setLimiterVerify(1);
+      bad = (offline->applyLimiter_E(&x[0], &y[0], nFrames) != LIMITER_OK);
+      bad += (offline->getLimiterMaxDeviation() != 0.0f);
+      printf("offline, %s, %s engine, pre-roll %d: deviation %g, %s\n", signalNames[signals[k]],
+             (e == PEAKLIMITER_MAX_VHGW) ? "vhgw" : "sections", (int)offline->getLimiterPreRoll(),
+             offline->getLimiterMaxDeviation(), bad ? "MISMATCH" : "ok");
+      mismatches += bad;
+      delete offline;
+    }
+  }
+  return mismatches;
+}
+
+/* gain envelope of the offline analysis, written to a file, opened again and applied in two
+   parts, the second one first after a seek: the output must be the one of the offline
+   limiter. Returns the number of mismatching outputs */
+static int checkEnvelope()
+{
+  static const char* path = "peakLimiterBench.env";
+  const int nFrames = 4 * 48000, nChannels = 2, split = nFrames / 3;
+  std::vector<float> x, y, gain(nFrames), reference;
+  PeakLimiterOffline* offline;
+  PeakLimiterEnvelope envelope, file;
+  int i, bad;
+
+  makeSignal(x, nFrames, nChannels, 48000, BENCH_BURSTS);
+  offline = new PeakLimiterOffline(5.0f, BENCH_RELEASE_MS, BENCH_THRESHOLD, nChannels, 48000);
+  offline->setLimiterChunkSize(48000);
+  reference.assign(x.size(), 0.0f);
+  bad = (offline->applyLimiter_E(&x[0], &reference[0], nFrames) != LIMITER_OK);
+  bad += (offline->analyzeLimiter_E(&x[0], &gain[0], nFrames) != LIMITER_OK);
+
+  bad += (envelope.createEnvelope(&gain[0], nFrames, BENCH_THRESHOLD, 5.0f, BENCH_RELEASE_MS, nChannels, 48000) != LIMITER_OK);
+  bad += (envelope.writeEnvelope(path) != LIMITER_OK);
+  bad += (file.openEnvelope(path) != LIMITER_OK);
+  y.assign(x.size(), 0.0f);
+  bad += (file.seekEnvelope(split) != LIMITER_OK);
+  bad += (file.applyEnvelope_E(&x[(size_t)split * nChannels], &y[(size_t)split * nChannels], nFrames - split, nChannels) != LIMITER_OK);
+  bad += (file.seekEnvelope(0) != LIMITER_OK);
+  bad += (file.applyEnvelope_E(&x[0], &y[0], split, nChannels) != LIMITER_OK);
+  for (i = 0; i < nFrames * nChannels; i++)
+    bad += !sameOutput(y[i], reference[i]);
+  printf("envelope, %d bytes for %d samples: %s\n", (int)file.getEnvelopeSize(), nFrames, bad ? "MISMATCH" : "ok");
+
+  remove(path);
+  delete offline;
+  return bad;
+}
+
+/* runs all entry points on one case, returns the number of mismatching outputs */
+static int runCase(const BenchCase& c, const BenchSettings& s)
+{
+  int nFrames = std::min(BENCH_SECONDS * c.sampleRate, BENCH_MAX_SAMPLES / c.channels);
+  std::vector<float> x, reference((size_t)nFrames * c.channels), y((size_t)nFrames * c.channels);
+  int entry, r, i, q, mismatches = 0;
+  PeakLimiter* limiter;
+
+  makeSignal(x, nFrames, c.channels, c.sampleRate, c.signal);
+
+  limiter = createLimiter(c, s.engine, PEAKLIMITER_ISA_SCALAR, PEAKLIMITER_PROCESS_SAMPLE, s.truePeak, s.flushDenormals);
+  if (s.engine == PEAKLIMITER_MAX_VHGW)
+    referenceLimiter(*limiter, &x[0], &reference[0], nFrames, c.channels);
+  else
+    limiter->applyLimiter_E(&x[0], &reference[0], nFrames);
+  delete limiter;
+
+  for (entry = 0; entry < BENCH_NENTRIES; entry++) {
+    std::vector<double> callNs;
+    double totalNs = 0, p99, maxNs, quarterNs[4] = { 0, 0, 0, 0 };
+    int bad = 0, nCalls;
+    PeakLimiterStats stats;
+
+    limiter = createLimiter(c, s.engine, s.isa, s.mode, s.truePeak, s.flushDenormals);
+    for (r = 0; r < s.repeat; r++) {
+      runEntry(limiter, entry, x, y, nFrames, c.channels, c.blockSize, callNs);
+      if ((r == 0) && !(s.truePeak && (s.engine == PEAKLIMITER_MAX_VHGW)))
+        for (i = 0; i < nFrames * c.channels; i++)
+          bad += !sameOutput(y[i], reference[i]);
+    }
+    limiter->getLimiterStats(&stats);
+    delete limiter;
+
+    nCalls = (int)callNs.size() / s.repeat;
+    for (i = 0; i < (int)callNs.size(); i++) {
+      totalNs += callNs[i];
+      quarterNs[4 * (i % nCalls) / nCalls] += callNs[i];
+    }
+    std::sort(callNs.begin(), callNs.end());
+    p99 = callNs[(callNs.size() * 99) / 100];
+    maxNs = callNs.back();
+
+    printf("%-6s %3d %5.1f %6d %5d %-7s %9.2f %8.3f %9.2f %9.2f  %s\n",
+           entryNames[entry], c.channels, c.attackMs, c.sampleRate, c.blockSize, signalNames[c.signal],
+           (double)nFrames * s.repeat / totalNs * 1e3,
+           totalNs / ((double)nFrames * s.repeat * c.channels),
+           p99 * 1e-3, maxNs * 1e-3,
+           bad ? "MISMATCH" : "ok");
+    if (bad)
+      printf("       %d samples differ from the reference\n", bad);
+    if (c.signal == BENCH_TAIL) {
+      printf("       ns/smp by quarter:");
+      for (q = 0; q < 4; q++)
+        printf(" %8.3f", quarterNs[q] * 4 / ((double)nFrames * s.repeat * c.channels));
+      printf("\n");
+    }
+    if (stats.enabled && (entry == BENCH_NENTRIES - 1))
+      printf("       per 1000 samples: rescans %.2f (%.1f samples), slow rescans %.2f (%.1f sections), "
+             "quiet %.1f, limited %.1f, clips %.2f\n",
+             1e3 * stats.sectionRescans / stats.samples, 1e3 * stats.sectionRescanSamples / stats.samples,
+             1e3 * stats.slowRescans / stats.samples, 1e3 * stats.slowRescanSections / stats.samples,
+             1e3 * stats.quietSamples / stats.samples, 1e3 * stats.limitedSamples / stats.samples,
+             1e3 * stats.clipSamples / stats.samples);
+    mismatches += bad;
+  }
+  return mismatches;
+}
+
+int main(int argc, char* argv[])
+{
+  BenchSettings s = { PEAKLIMITER_MAX_SECTIONS, PEAKLIMITER_ISA_BEST, PEAKLIMITER_PROCESS_SAMPLE, 3, 0, 1 };
+  const BenchCase base = { 2, 5.0f, 48000, 256, BENCH_DENSE_CLIPPING };
+  std::vector<BenchCase> cases;
+  BenchCase c;
+  int full = 0, i, a, b, d, e, mismatches = 0;
+
+  for (i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "-full"))
+      full = 1;
+    else if (!strcmp(argv[i], "-engine") && i + 1 < argc)
+      s.engine = !strcmp(argv[++i], "vhgw") ? PEAKLIMITER_MAX_VHGW : PEAKLIMITER_MAX_SECTIONS;
+    else if (!strcmp(argv[i], "-isa") && i + 1 < argc)
+      s.isa = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-mode") && i + 1 < argc)
+      s.mode = !strcmp(argv[++i], "block") ? PEAKLIMITER_PROCESS_BLOCK : PEAKLIMITER_PROCESS_SAMPLE;
+    else if (!strcmp(argv[i], "-repeat") && i + 1 < argc)
+      s.repeat = std::max(1, atoi(argv[++i]));
+    else if (!strcmp(argv[i], "-truepeak"))
+      s.truePeak = 1;
+    else if (!strcmp(argv[i], "-denormals") && i + 1 < argc)
+      s.flushDenormals = strcmp(argv[++i], "off") ? 1 : 0;
+    else {
+      printf("usage: %s [-full] [-engine sections|vhgw] [-isa n] [-mode sample|block] [-repeat n] "
+             "[-truepeak] [-denormals on|off]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  if (full) {
+    for (i = 0; i < LIST_LEN(channelsList); i++)
+      for (a = 0; a < LIST_LEN(attackList); a++)
+        for (b = 0; b < LIST_LEN(sampleRateList); b++)
+          for (d = 0; d < LIST_LEN(blockSizeList); d++)
+            for (e = 0; e < BENCH_NSIGNALS; e++) {
+              c.channels = channelsList[i]; c.attackMs = attackList[a]; c.sampleRate = sampleRateList[b];
+              c.blockSize = blockSizeList[d]; c.signal = e;
+              cases.push_back(c);
+            }
+  }
+  else {
+    for (i = 0; i < LIST_LEN(channelsList); i++)     { c = base; c.channels = channelsList[i];     cases.push_back(c); }
+    for (i = 0; i < LIST_LEN(attackList); i++)       { c = base; c.attackMs = attackList[i];       cases.push_back(c); }
+    for (i = 0; i < LIST_LEN(sampleRateList); i++)   { c = base; c.sampleRate = sampleRateList[i]; cases.push_back(c); }
+    for (i = 0; i < LIST_LEN(blockSizeList); i++)    { c = base; c.blockSize = blockSizeList[i];   cases.push_back(c); }
+    for (i = 0; i < BENCH_NSIGNALS; i++)             { c = base; c.signal = i;                     cases.push_back(c); }
+  }
+
+  mismatches += checkRateChange();
+  mismatches += checkStream();
+  mismatches += checkGroups();
+  mismatches += checkOffline();
+  mismatches += checkEnvelope();
+  mismatches += checkExecutor();
+  mismatches += checkBank();
+  mismatches += checkIntegers();
+
+  printf("engine %s, kernels %s, %s mode, %d passes%s, denormals %s\n",
+         (s.engine == PEAKLIMITER_MAX_VHGW) ? "vhgw" : "sections",
+         getPeakLimiterKernels(s.isa) ? getPeakLimiterKernels(s.isa)->name : getPeakLimiterKernels(PEAKLIMITER_ISA_BEST)->name,
+         (s.mode == PEAKLIMITER_PROCESS_BLOCK) ? "block" : "sample", s.repeat, s.truePeak ? ", true peak" : "",
+         s.flushDenormals ? "flushed" : "kept");
+  printf("%-6s %3s %5s %6s %5s %-7s %9s %8s %9s %9s  %s\n",
+         "entry", "ch", "ms", "rate", "block", "signal", "Msmp/s", "ns/smp", "p99 us", "max us", "check");
+
+  for (i = 0; i < (int)cases.size(); i++)
+    mismatches += runCase(cases[i], s);
+
+  printf("%s\n", mismatches ? "MISMATCH against the reference" : "all outputs match the reference");
+  return mismatches ? 1 : 0;
+}
@@ -0,0 +1,484 @@
+/*
+Copyright (c) 2016, UMR STMS 9912 - Ircam-Centre Pompidou / CNRS / UPMC
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the <organization> nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "peakLimiterEnvelope.h"
+
+#include <stdio.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifndef max
+#define max(a, b)   (((a) > (b)) ? (a) : (b))
+#endif
+#ifndef min
+#define min(a, b)   (((a) < (b)) ? (a) : (b))
+#endif
+
+/* gains are compared bit for bit, so that the runs give back the exact floats */
+static inline uint32_t gainBits(float gain)
+{
+  uint32_t bits;
+
+  memcpy(&bits, &gain, sizeof(bits));
+  return bits;
+}
+
+/* bit pattern difference of two gains, zigzag coded: small either way */
+static inline uint32_t zigzag(uint32_t bits, uint32_t prevBits)
+{
+  const uint32_t delta = bits - prevBits;
+
+  return (delta << 1) ^ (0u - (delta >> 31));
+}
+
+static inline uint32_t unzigzag(uint32_t z)
+{
+  return (z >> 1) ^ (0u - (z & 1));
+}
+
+/* bytes of the LEB128 code of z */
+static inline int codeBytes(uint32_t z)
+{
+  int n = 1;
+
+  for (; z >= 0x80; z >>= 7)
+    n++;
+  return n;
+}
+
+/* next difference of a delta run, checked by attachEnvelope */
+static inline uint32_t readDelta(const uint8_t** p)
+{
+  uint32_t z = 0;
+  int shift = 0;
+  uint8_t byte;
+
+  do {
+    byte = *(*p)++;
+    z |= (uint32_t)(byte & 0x7f) << shift;
+    shift += 7;
+  } while (byte & 0x80);
+
+  return unzigzag(z);
+}
+
+/* delta run of n gains into words, NULL to count them only: returns the number of words */
+static size_t encodeDelta(const float* gain, int n, uint32_t* words)
+{
+  size_t nBytes = sizeof(float);
+  int i;
+  uint32_t z;
+  uint8_t* p;
+
+  if (n == 0) return 0;
+
+  for (i = 1; i < n; i++)
+    nBytes += codeBytes(zigzag(gainBits(gain[i]), gainBits(gain[i - 1])));
+  nBytes = (nBytes + sizeof(uint32_t) - 1) / sizeof(uint32_t);   /* now in words */
+
+  if (words) {
+    words[0] = (uint32_t)n << 1;
+    words[1] = (uint32_t)nBytes;
+    memset(words + 2, 0, nBytes * sizeof(uint32_t));
+    memcpy(words + 2, gain, sizeof(float));
+    p = (uint8_t*)(words + 3);
+    for (i = 1; i < n; i++) {
+      for (z = zigzag(gainBits(gain[i]), gainBits(gain[i - 1])); z >= 0x80; z >>= 7)
+        *p++ = (uint8_t)(z | 0x80);
+      *p++ = (uint8_t)z;
+    }
+  }
+  return 2 + nBytes;
+}
+
+/* runs of one block into words, NULL to count them only: returns the number of words.
+   Equal gains make a constant run from PEAKLIMITERENVELOPE_MIN_RUN samples on, the
+   gains in between go in delta runs */
+static size_t encodeBlock(const float* gain, int n, uint32_t* words)
+{
+  size_t nWords = 0;
+  int i = 0, r, start = 0;
+
+  while (i < n) {
+    for (r = 1; (i + r < n) && (gainBits(gain[i + r]) == gainBits(gain[i])); r++)
+      ;
+    if (r < PEAKLIMITERENVELOPE_MIN_RUN) {
+      i += r;
+      continue;
+    }
+    nWords += encodeDelta(gain + start, i - start, words ? words + nWords : NULL);
+    if (words) {
+      words[nWords] = ((uint32_t)r << 1) | 1;
+      memcpy(words + nWords + 1, gain + i, sizeof(float));
+    }
+    nWords += 2;
+    i += r;
+    start = i;
+  }
+  nWords += encodeDelta(gain + start, n - start, words ? words + nWords : NULL);
+
+  return nWords;
+}
+
+/* run after this one */
+static inline const uint32_t* nextRun(const uint32_t* run)
+{
+  return run + ((run[0] & 1) ? 2 : 2 + run[1]);
+}
+
+/* check one run within [run, end[: its size, and for a delta run that its differences are
+   complete codes of at most 32 bits inside the run. Returns its length, 0 if invalid */
+static int checkRun(const uint32_t* run, const uint32_t* end)
+{
+  const uint8_t *p, *last;
+  int i, k, len;
+
+  if (end - run < 2) return 0;
+  len = (int)(run[0] >> 1);
+  if (run[0] & 1)
+    return len;
+
+  if ((run[1] < 1) || (run[1] > (uint64_t)(end - run - 2))) return 0;
+  p = (const uint8_t*)(run + 3);
+  last = (const uint8_t*)(run + 2 + run[1]);
+  for (i = 1; i < len; i++) {
+    for (k = 0; (p < last) && (*p & 0x80); k++)
+      p++;
+    if ((p >= last) || (k > 4) || ((k == 4) && (*p > 0x0f)))
+      return 0;
+    p++;
+  }
+  return len;
+}
+
+/* out = in * gain clamped to +/- threshold, the arithmetic of the hard clip of the limiter */
+static inline void applyGainClip(const float* in, float* out, int n, float gain, float threshold)
+{
+  int k;
+  float tmp;
+
+  for (k = 0; k < n; k++) {
+    tmp = in[k] * gain;
+    if (tmp > threshold) tmp = threshold;
+    if (tmp < -threshold) tmp = -threshold;
+    out[k] = tmp;
+  }
+}
+
+PeakLimiterEnvelope::PeakLimiterEnvelope()
+{
+  m_pData    = NULL;
+  m_dataSize = 0;
+  m_pMap     = NULL;
+  m_mapSize  = 0;
+  closeEnvelope();
+}
+
+PeakLimiterEnvelope::~PeakLimiterEnvelope()
+{
+  closeEnvelope();
+}
+
+void PeakLimiterEnvelope::closeEnvelope()
+{
+  if (m_pData)
+  {
+    delete [] m_pData;
+    m_pData = NULL;
+  }
+  m_dataSize = 0;
+  if (m_pMap)
+  {
+    munmap(m_pMap, m_mapSize);
+    m_pMap = NULL;
+  }
+  m_mapSize = 0;
+
+  memset(&m_header, 0, sizeof(m_header));
+  m_pIndex   = NULL;
+  m_pRuns    = NULL;
+  m_position = 0;
+  m_pRun     = NULL;
+  m_runDone  = 0;
+  m_gainBits = 0;
+  m_pDelta   = NULL;
+}
+
+/* check an envelope in memory and use it: header, index and the lengths of all the runs,
+   so that applyEnvelope_E never reads outside of it */
+int PeakLimiterEnvelope::attachEnvelope(const char* data, size_t size)
+{
+  PeakLimiterEnvelopeHeader header;
+  const uint64_t* index;
+  const uint32_t *run, *end;
+  int64_t b, n, blockSamples;
+  int len;
+
+  if (size < sizeof(header)) return LIMITER_INVALID_PARAMETER;
+  memcpy(&header, data, sizeof(header));
+
+  if (memcmp(header.magic, PEAKLIMITERENVELOPE_MAGIC, sizeof(header.magic)) || (header.version != PEAKLIMITERENVELOPE_VERSION))
+    return LIMITER_INVALID_PARAMETER;
+  if ((header.blockLen < 1) || (header.nSamples < 0) || (header.runsSize < 0) || (header.runsSize % sizeof(uint32_t)))
+    return LIMITER_INVALID_PARAMETER;
+  if ((header.nBlocks != (header.nSamples + header.blockLen - 1) / header.blockLen)
+      || ((uint64_t)header.nBlocks >= (size - sizeof(header)) / sizeof(uint64_t))
+      || (size != sizeof(header) + sizeof(uint64_t) * (header.nBlocks + 1) + (uint64_t)header.runsSize))
+    return LIMITER_INVALID_PARAMETER;
+
+  index = (const uint64_t*)(data + sizeof(header));
+  if ((index[0] != 0) || (index[header.nBlocks] != (uint64_t)header.runsSize))
+    return LIMITER_INVALID_PARAMETER;
+
+  for (b = 0; b < header.nBlocks; b++) {
+    if ((index[b + 1] < index[b]) || (index[b + 1] > (uint64_t)header.runsSize) || (index[b + 1] % sizeof(uint32_t)))
+      return LIMITER_INVALID_PARAMETER;
+    run = (const uint32_t*)(index + header.nBlocks + 1) + index[b] / sizeof(uint32_t);
+    end = (const uint32_t*)(index + header.nBlocks + 1) + index[b + 1] / sizeof(uint32_t);
+    blockSamples = min((int64_t)header.blockLen, header.nSamples - b * header.blockLen);
+    for (n = 0; run < end; run = nextRun(run)) {
+      len = checkRun(run, end);
+      if (len == 0)
+        return LIMITER_INVALID_PARAMETER;
+      n += len;
+    }
+    if (n != blockSamples)
+      return LIMITER_INVALID_PARAMETER;
+  }
+
+  m_header = header;
+  m_pIndex = index;
+  m_pRuns  = (const uint32_t*)(index + header.nBlocks + 1);
+
+  return seekEnvelope(0);
+}
+
+/* encode a gain curve */
+int PeakLimiterEnvelope::createEnvelope(const float* gain, int64_t nSamples, float threshold,
+                                        float attackMs, float releaseMs, int nChannels, int sampleRate)
+{
+  PeakLimiterEnvelopeHeader header;
+  uint64_t* index;
+  uint32_t* runs;
+  int64_t b, nBlocks;
+  size_t nWords, size;
+  int blockSamples;
+
+  if ((gain == NULL) || (nSamples < 0)) return LIMITER_INVALID_PARAMETER;
+
+  closeEnvelope();
+
+  /* count the words of the runs, then write them */
+  nBlocks = (nSamples + PEAKLIMITERENVELOPE_BLOCK - 1) / PEAKLIMITERENVELOPE_BLOCK;
+  nWords = 0;
+  for (b = 0; b < nBlocks; b++) {
+    blockSamples = (int)min((int64_t)PEAKLIMITERENVELOPE_BLOCK, nSamples - b * PEAKLIMITERENVELOPE_BLOCK);
+    nWords += encodeBlock(gain + b * PEAKLIMITERENVELOPE_BLOCK, blockSamples, NULL);
+  }
+
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, PEAKLIMITERENVELOPE_MAGIC, sizeof(header.magic));
+  header.version    = PEAKLIMITERENVELOPE_VERSION;
+  header.blockLen   = PEAKLIMITERENVELOPE_BLOCK;
+  header.nSamples   = nSamples;
+  header.nBlocks    = nBlocks;
+  header.runsSize   = (int64_t)(nWords * sizeof(uint32_t));
+  header.threshold  = threshold;
+  header.attackMs   = attackMs;
+  header.releaseMs  = releaseMs;
+  header.channels   = nChannels;
+  header.sampleRate = sampleRate;
+
+  size = sizeof(header) + sizeof(uint64_t) * (nBlocks + 1) + nWords * sizeof(uint32_t);
+  m_pData = new char[size];
+  m_dataSize = size;
+  memcpy(m_pData, &header, sizeof(header));
+  index = (uint64_t*)(m_pData + sizeof(header));
+  runs = (uint32_t*)(index + nBlocks + 1);
+
+  nWords = 0;
+  for (b = 0; b < nBlocks; b++) {
+    blockSamples = (int)min((int64_t)PEAKLIMITERENVELOPE_BLOCK, nSamples - b * PEAKLIMITERENVELOPE_BLOCK);
+    index[b] = nWords * sizeof(uint32_t);
+    nWords += encodeBlock(gain + b * PEAKLIMITERENVELOPE_BLOCK, blockSamples, runs + nWords);
+  }
+  index[nBlocks] = nWords * sizeof(uint32_t);
+
+  return attachEnvelope(m_pData, m_dataSize);
+}
+
+/* store the envelope */
+int PeakLimiterEnvelope::writeEnvelope(const char* path)
+{
+  FILE* file;
+  const char* data = m_pData ? m_pData : (const char*)m_pMap;
+  size_t size = getEnvelopeSize();
+  int err = LIMITER_OK;
+
+  if (data == NULL) return LIMITER_INVALID_HANDLE;
+  if (path == NULL) return LIMITER_INVALID_PARAMETER;
+
+  file = fopen(path, "wb");
+  if (file == NULL) return LIMITER_INVALID_PARAMETER;
+  if (fwrite(data, 1, size, file) != size)
+    err = LIMITER_INVALID_PARAMETER;
+  if (fclose(file) != 0)
+    err = LIMITER_INVALID_PARAMETER;
+
+  return err;
+}
+
+/* map and check an envelope file */
+int PeakLimiterEnvelope::openEnvelope(const char* path)
+{
+  struct stat st;
+  void* map;
+  int fd, err;
+
+  if (path == NULL) return LIMITER_INVALID_PARAMETER;
+
+  closeEnvelope();
+
+  fd = open(path, O_RDONLY);
+  if (fd < 0) return LIMITER_INVALID_PARAMETER;
+  if ((fstat(fd, &st) != 0) || (st.st_size < (off_t)sizeof(PeakLimiterEnvelopeHeader))) {
+    close(fd);
+    return LIMITER_INVALID_PARAMETER;
+  }
+  map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) return LIMITER_INVALID_PARAMETER;
+  madvise(map, (size_t)st.st_size, MADV_SEQUENTIAL);
+
+  m_pMap = map;
+  m_mapSize = (size_t)st.st_size;
+  err = attachEnvelope((const char*)map, m_mapSize);
+  if (err != LIMITER_OK)
+    closeEnvelope();
+
+  return err;
+}
+
+/* move the stream position: from the index entry of its block, through the runs */
+int PeakLimiterEnvelope::seekEnvelope(int64_t position)
+{
+  int64_t b, skip;
+
+  if (m_pRuns == NULL) return LIMITER_INVALID_HANDLE;
+  if ((position < 0) || (position > m_header.nSamples)) return LIMITER_INVALID_PARAMETER;
+
+  /* the end of the signal is the end of the runs */
+  b = (position == m_header.nSamples) ? m_header.nBlocks : position / m_header.blockLen;
+  m_pRun = m_pRuns + m_pIndex[b] / sizeof(uint32_t);
+  m_runDone = 0;
+  skip = (b == m_header.nBlocks) ? 0 : position - b * m_header.blockLen;
+  while ((skip > 0) && (skip >= (int64_t)(m_pRun[0] >> 1))) {
+    skip -= m_pRun[0] >> 1;
+    m_pRun = nextRun(m_pRun);
+  }
+  m_position = position - skip;
+  processRuns(NULL, NULL, (int)skip, 0);
+
+  return LIMITER_OK;
+}
+
+/* go through the runs: a multiply and clamp per sample, on whole frames of a constant run at
+   once, the gains of a delta run decoded on the way. Without samplesIn, the stream position only
+   moves forward */
+void PeakLimiterEnvelope::processRuns(const float* samplesIn, float* samplesOut, int nSamples, int nChannels)
+{
+  int i, n, len;
+  float gain;
+
+  while (nSamples > 0) {
+    len = (int)(m_pRun[0] >> 1);
+    n = min(len - m_runDone, nSamples);
+
+    if (m_pRun[0] & 1) {
+      memcpy(&gain, m_pRun + 1, sizeof(gain));
+      if (samplesIn)
+        applyGainClip(samplesIn, samplesOut, n * nChannels, gain, m_header.threshold);
+    }
+    else {
+      for (i = 0; i < n; i++) {
+        if (m_runDone + i == 0) {
+          m_gainBits = m_pRun[2];
+          m_pDelta = (const uint8_t*)(m_pRun + 3);
+        }
+        else
+          m_gainBits += readDelta(&m_pDelta);
+        if (samplesIn) {
+          memcpy(&gain, &m_gainBits, sizeof(gain));
+          applyGainClip(samplesIn + i * nChannels, samplesOut + i * nChannels, nChannels, gain, m_header.threshold);
+        }
+      }
+    }
+
+    if (samplesIn) {
+      samplesIn  += n * nChannels;
+      samplesOut += n * nChannels;
+    }
+    nSamples   -= n;
+    m_position += n;
+    m_runDone  += n;
+    if (m_runDone == len) {
+      m_pRun = nextRun(m_pRun);
+      m_runDone = 0;
+    }
+  }
+}
+
+/* apply the gain curve, with subnormals flushed to zero as by the limiter */
+int PeakLimiterEnvelope::applyEnvelope_E(const float* samplesIn, float* samplesOut, int nSamples, int nChannels)
+{
+  uint64_t fpState;
+
+  if (m_pRuns == NULL) return LIMITER_INVALID_HANDLE;
+  if ((samplesIn == NULL) || (samplesOut == NULL) || (nSamples < 0) || (nChannels < 1)
+      || (nSamples > m_header.nSamples - m_position))
+    return LIMITER_INVALID_PARAMETER;
+
+  enterPeakLimiterFlushDenormals(&fpState);
+  processRuns(samplesIn, samplesOut, nSamples, nChannels);
+  leavePeakLimiterFlushDenormals(fpState);
+
+  return LIMITER_OK;
+}
+
+/* get number of samples per channel */
+int64_t PeakLimiterEnvelope::getEnvelopeLength()
+{
+  return m_header.nSamples;
+}
+
+/* get size in bytes */
+size_t PeakLimiterEnvelope::getEnvelopeSize()
+{
+  return m_pData ? m_dataSize : m_mapSize;
+}
@@ -0,0 +1,164 @@
+/*
+Copyright (c) 2016, UMR STMS 9912 - Ircam-Centre Pompidou / CNRS / UPMC
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the <organization> nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __peaklimiterenvelope_h__
+#define __peaklimiterenvelope_h__
+
+#include "peakLimiter.h"
+
+#define PEAKLIMITERENVELOPE_MAGIC       "PLENVLP"   /* 8 bytes with the terminating 0 */
+#define PEAKLIMITERENVELOPE_VERSION     (1)
+#define PEAKLIMITERENVELOPE_BLOCK       (1 << 16)   /* samples per block of the index, the unit of seeking */
+#define PEAKLIMITERENVELOPE_MIN_RUN     (16)        /* shortest run of equal gains stored as a constant run */
+
+/* envelope file: this header, the index (nBlocks + 1 byte offsets, uint64_t, of the runs of each
+   block from the start of the runs), then the runs, in 32 bit words. Runs do not cross blocks.
+   - constant run: word (length << 1 | 1), the gain
+   - delta run: word (length << 1), the number of words that follow, the first gain, then
+     length-1 differences of the bit patterns of consecutive gains, zigzag LEB128 bytes, padded
+     to a word with zeros. Smooth gain curves take about 2 bytes per gain, and the floats are
+     exact.
+   Native byte order, for little endian hosts */
+typedef struct {
+  char          magic[8];
+  int32_t       version;
+  int32_t       blockLen;           /* samples per block of the index */
+  int64_t       nSamples;           /* samples per channel */
+  int64_t       nBlocks;
+  int64_t       runsSize;           /* bytes of the runs */
+  float         threshold;          /* hard clip of the apply pass */
+  float         attackMs;           /* settings of the analysis, for information */
+  float         releaseMs;
+  int32_t       channels;
+  int32_t       sampleRate;
+  int32_t       reserved;
+} PeakLimiterEnvelopeHeader;
+
+/******************************************************************************
+* PeakLimiterEnvelope                                                         *
+* gain curve of a limiter, run length encoded, so that the same signal can be *
+* limited again without the detector and the gain smoothing: the apply pass   *
+* only multiplies and clamps, a pass at memory bandwidth.                     *
+* Analysis: PeakLimiterOffline::analyzeLimiter_E gives the gains, which       *
+* createEnvelope encodes and writeEnvelope stores. Apply: openEnvelope maps   *
+* the file, applyEnvelope_E streams the signal through it. The output is the  *
+* one of PeakLimiterOffline::applyLimiter_E with the same settings, bit for   *
+* bit (subnormal input samples aside, flushed to zero like the limiter does   *
+* on most of its paths). One object per thread: the mapping is read only and  *
+* shared, only the stream position is per object.                             *
+******************************************************************************/
+class PeakLimiterEnvelope
+{
+
+public:
+  PeakLimiterEnvelopeHeader m_header;
+  const uint64_t* m_pIndex;
+  const uint32_t* m_pRuns;
+  char*         m_pData;                /* header, index and runs made by createEnvelope */
+  size_t        m_dataSize;
+  void*         m_pMap;                 /* mapping of the file opened by openEnvelope */
+  size_t        m_mapSize;
+  int64_t       m_position;             /* next sample of applyEnvelope_E */
+  const uint32_t* m_pRun;               /* run of this sample */
+  int           m_runDone;              /* samples of this run already applied */
+  uint32_t      m_gainBits;             /* delta run: gain of the last sample applied */
+  const uint8_t* m_pDelta;              /* delta run: difference of the next sample */
+
+public:
+
+PeakLimiterEnvelope();
+~PeakLimiterEnvelope();
+
+/******************************************************************************
+* createEnvelope                                                              *
+* gain:        gain of each sample, see PeakLimiterOffline::analyzeLimiter_E  *
+* nSamples:    number of samples per channel                                  *
+* threshold:   limiting threshold, the hard clip of the apply pass            *
+* attackMs, releaseMs, nChannels, sampleRate: settings of the analysis,       *
+*              stored for information                                         *
+* returns:     error code                                                     *
+******************************************************************************/
+int createEnvelope(        const float*  gain,
+                           int64_t       nSamples,
+                           float         threshold,
+                           float         attackMs,
+                           float         releaseMs,
+                           int           nChannels,
+                           int           sampleRate);
+
+/******************************************************************************
+* writeEnvelope                                                               *
+* path:        file written with the envelope of createEnvelope               *
+* returns:     error code                                                     *
+******************************************************************************/
+int writeEnvelope( const char* path);
+
+/******************************************************************************
+* openEnvelope                                                                *
+* path:        envelope file, mapped read only and checked                    *
+* returns:     error code                                                     *
+******************************************************************************/
+int openEnvelope( const char* path);
+
+/******************************************************************************
+* seekEnvelope                                                                *
+* position:    sample of the next applyEnvelope_E call                        *
+* returns:     error code                                                     *
+******************************************************************************/
+int seekEnvelope( int64_t position);
+
+/******************************************************************************
+* applyEnvelope_E                                                             *
+* samplesIn:   input buffer containing interleaved samples                    *
+* samplesOut:  output buffer containing interleaved samples, may be the same  *
+*              buffer as samplesIn                                            *
+* nSamples:    number of samples per channel, the signal continues from the   *
+*              previous call, or from seekEnvelope                            *
+* nChannels:   number of channels                                             *
+* returns:     error code                                                     *
+******************************************************************************/
+int applyEnvelope_E(
+                 const float*       samplesIn,
+                 float*             samplesOut,
+                 int                nSamples,
+                 int                nChannels);
+
+int64_t getEnvelopeLength();
+
+/******************************************************************************
+* getEnvelopeSize                                                             *
+* returns: bytes of the envelope, header and index included                   *
+******************************************************************************/
+size_t getEnvelopeSize();
+
+private:
+void closeEnvelope();
+int attachEnvelope( const char* data, size_t size);
+void processRuns( const float* samplesIn, float* samplesOut, int nSamples, int nChannels);
+};
+
+#endif /* __peaklimiterenvelope_h__ */
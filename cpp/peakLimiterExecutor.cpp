@@ -0,0 +1,331 @@
+/*
+Copyright (c) 2016, UMR STMS 9912 - Ircam-Centre Pompidou / CNRS / UPMC
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the <organization> nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "peakLimiterExecutor.h"
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#ifndef max
+#define max(a, b)   (((a) > (b)) ? (a) : (b))
+#endif
+#ifndef min
+#define min(a, b)   (((a) < (b)) ? (a) : (b))
+#endif
+
+/* create executor: the limiters, the queues and the worker threads */
+PeakLimiterExecutor::PeakLimiterExecutor(
+                           int           nInstancesIn,
+                           float         attackMsIn,
+                           float         releaseMsIn,
+                           float         thresholdIn,
+                           int           nChannelsIn,
+                           int           sampleRateIn,
+                           int           maxEngineIn,
+                           int           nWorkersIn,
+                           int           affinityIn,
+                           int           firstCoreIn
+                           )
+{
+  int i, k, nCores, core;
+
+  m_instances  = max(nInstancesIn, 0);
+  m_channels   = nChannelsIn;
+  m_sampleRate = sampleRateIn;
+  nCores       = (int)std::thread::hardware_concurrency();
+  m_workers    = max((nWorkersIn > 0) ? nWorkersIn : nCores, 1);
+
+  m_ppLimiters = new PeakLimiter*[max(m_instances, 1)];
+  m_ppBuffers  = new float*[max(m_instances, 1)];
+  for (i = 0; i < m_instances; i++) {
+    m_ppLimiters[i] = new PeakLimiter(attackMsIn, releaseMsIn, thresholdIn, nChannelsIn, sampleRateIn, maxEngineIn);
+    m_ppBuffers[i]  = NULL;
+  }
+
+  /* worker k queues the instances k, k + m_workers, ... */
+  m_pWorkers = new PeakLimiterExecutorWorker[m_workers];
+  for (k = 0; k < m_workers; k++) {
+    m_pWorkers[k].range  = 0;
+    m_pWorkers[k].tasks  = new int[max((m_instances + m_workers - 1) / m_workers, 1)];
+    m_pWorkers[k].nTasks = 0;
+    m_pWorkers[k].stats.core = -1;
+  }
+
+  m_deadlineUs = 0;
+  m_nSamples   = 0;
+  m_period     = 0;
+  m_quit       = 0;
+  m_remaining  = 0;
+  m_lateTasks  = 0;
+  resetExecutorStats();
+
+  m_pThreads = new std::thread[max(m_workers - 1, 1)];
+  for (k = 1; k < m_workers; k++) {
+    m_pThreads[k - 1] = std::thread(&PeakLimiterExecutor::workerThread, this, k);
+#if defined(__linux__)
+    if (affinityIn && (nCores > 0)) {
+      cpu_set_t set;
+
+      core = (firstCoreIn + k - 1) % nCores;
+      CPU_ZERO(&set);
+      CPU_SET(core, &set);
+      if (pthread_setaffinity_np(m_pThreads[k - 1].native_handle(), sizeof(set), &set) == 0)
+        m_pWorkers[k].stats.core = core;
+    }
+#else
+    (void)affinityIn;
+    (void)firstCoreIn;
+    (void)core;
+#endif
+  }
+}
+
+PeakLimiterExecutor::~PeakLimiterExecutor()
+{
+  int i, k;
+
+  m_quit.store(1, std::memory_order_relaxed);
+  m_period.fetch_add(1, std::memory_order_release);
+  for (k = 1; k < m_workers; k++)
+    m_pThreads[k - 1].join();
+
+  if (m_pThreads)
+  {
+    delete [] m_pThreads;
+    m_pThreads = NULL;
+  }
+  if (m_pWorkers)
+  {
+    for (k = 0; k < m_workers; k++)
+      delete [] m_pWorkers[k].tasks;
+    delete [] m_pWorkers;
+    m_pWorkers = NULL;
+  }
+  if (m_ppLimiters)
+  {
+    for (i = 0; i < m_instances; i++)
+      delete m_ppLimiters[i];
+    delete [] m_ppLimiters;
+    m_ppLimiters = NULL;
+  }
+  if (m_ppBuffers)
+  {
+    delete [] m_ppBuffers;
+    m_ppBuffers = NULL;
+  }
+}
+
+/* take a task from a queue: the owner from the head, a thief from the tail.
+   Returns the instance, -1 if the queue is empty */
+static int takeTask(PeakLimiterExecutorWorker* worker, int steal)
+{
+  uint64_t range = worker->range.load(std::memory_order_acquire), next;
+  uint32_t head, tail;
+
+  for (;;) {
+    head = (uint32_t)range;
+    tail = (uint32_t)(range >> 32);
+    if (head >= tail)
+      return -1;
+    if (steal)
+      next = ((uint64_t)(tail - 1) << 32) | head;
+    else
+      next = ((uint64_t)tail << 32) | (head + 1);
+    if (worker->range.compare_exchange_weak(range, next, std::memory_order_acquire, std::memory_order_acquire))
+      return worker->tasks[steal ? tail - 1 : head];
+  }
+}
+
+/* process the tasks of the own queue, then steal from the other queues until all are empty.
+   The statistics of a task are written before it is counted as done */
+void PeakLimiterExecutor::runWorker(int k)
+{
+  PeakLimiterExecutorWorker* worker = &m_pWorkers[k];
+  std::chrono::steady_clock::time_point start, end;
+  int i, task, steal;
+
+  for (;;) {
+    task = takeTask(worker, 0);
+    steal = 0;
+    for (i = 1; (task < 0) && (i < m_workers); i++) {
+      task = takeTask(&m_pWorkers[(k + i) % m_workers], 1);
+      steal = 1;
+    }
+    if (task < 0)
+      break;
+
+    start = std::chrono::steady_clock::now();
+    m_ppLimiters[task]->applyLimiter_E_I(m_ppBuffers[task], m_nSamples);
+    end = std::chrono::steady_clock::now();
+
+    worker->stats.tasks++;
+    worker->stats.steals += steal;
+    worker->stats.samples += m_nSamples;
+    worker->stats.busyUs += std::chrono::duration<double, std::micro>(end - start).count();
+    if (end > m_deadline)
+      m_lateTasks.fetch_add(1, std::memory_order_relaxed);
+    m_remaining.fetch_sub(1, std::memory_order_release);
+  }
+}
+
+/* worker thread: waits for a period, yielding then sleeping, and takes part in it */
+void PeakLimiterExecutor::workerThread(int k)
+{
+  unsigned int period = 0, current;
+  int spins;
+
+  for (;;) {
+    spins = 0;
+    while ((current = m_period.load(std::memory_order_acquire)) == period) {
+      if (++spins < PEAKLIMITEREXECUTOR_SPINS)
+        std::this_thread::yield();
+      else
+        std::this_thread::sleep_for(std::chrono::microseconds(PEAKLIMITEREXECUTOR_SLEEP_US));
+    }
+    period = current;
+    if (m_quit.load(std::memory_order_relaxed))
+      break;
+
+    runWorker(k);
+  }
+}
+
+/* get limiter of an instance */
+PeakLimiter* PeakLimiterExecutor::getExecutorLimiter(int instance)
+{
+  if ((instance < 0) || (instance >= m_instances)) return NULL;
+
+  return m_ppLimiters[instance];
+}
+
+/* set buffer of an instance */
+int PeakLimiterExecutor::setExecutorBuffer(int instance, float* samples)
+{
+  if ((instance < 0) || (instance >= m_instances)) return LIMITER_INVALID_PARAMETER;
+
+  m_ppBuffers[instance] = samples;
+
+  return LIMITER_OK;
+}
+
+/* run one period: queue the instances with a buffer, wake the workers up, take part as
+   worker 0 and wait for the tasks taken by the others. The queues are published by the
+   release stores of their ranges, so a worker still draining the previous period only
+   finds the tasks of this one once they are ready */
+int PeakLimiterExecutor::runExecutorPeriod(int nSamples)
+{
+  std::chrono::steady_clock::time_point start, end;
+  double deadlineUs, periodUs;
+  int i, k, nTasks = 0;
+  PeakLimiterExecutorWorker* worker;
+
+  if (nSamples < 0) return LIMITER_INVALID_PARAMETER;
+
+  start = std::chrono::steady_clock::now();
+  deadlineUs = (m_deadlineUs > 0) ? m_deadlineUs : 1e6 * nSamples / m_sampleRate;
+  m_deadline = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                         std::chrono::duration<double, std::micro>(deadlineUs));
+  m_nSamples = nSamples;
+
+  for (k = 0; k < m_workers; k++)
+    m_pWorkers[k].nTasks = 0;
+  for (i = 0; i < m_instances; i++) {
+    if (m_ppBuffers[i] == NULL)
+      continue;
+    worker = &m_pWorkers[i % m_workers];
+    worker->tasks[worker->nTasks++] = i;
+    nTasks++;
+  }
+  m_lateTasks.store(0, std::memory_order_relaxed);
+  m_remaining.store(nTasks, std::memory_order_relaxed);
+  for (k = 0; k < m_workers; k++)
+    m_pWorkers[k].range.store((uint64_t)m_pWorkers[k].nTasks << 32, std::memory_order_release);
+  m_period.fetch_add(1, std::memory_order_release);
+
+  runWorker(0);
+  while (m_remaining.load(std::memory_order_acquire) > 0)
+    std::this_thread::yield();
+
+  end = std::chrono::steady_clock::now();
+  periodUs = std::chrono::duration<double, std::micro>(end - start).count();
+  m_totalPeriodUs += periodUs;
+
+  m_stats.periods++;
+  m_stats.deadlineMisses += (end > m_deadline);
+  m_stats.lateTasks += m_lateTasks.load(std::memory_order_relaxed);
+  m_stats.deadlineUs = deadlineUs;
+  m_stats.lastPeriodUs = periodUs;
+  m_stats.meanPeriodUs = m_totalPeriodUs / m_stats.periods;
+  m_stats.maxPeriodUs = max(m_stats.maxPeriodUs, periodUs);
+  for (k = 0; k < m_workers; k++)
+    m_pWorkers[k].stats.load = (float)(m_pWorkers[k].stats.busyUs / m_totalPeriodUs);
+
+  return LIMITER_OK;
+}
+
+/* set deadline of the periods */
+int PeakLimiterExecutor::setExecutorDeadline(double deadlineUsIn)
+{
+  if (deadlineUsIn < 0) return LIMITER_INVALID_PARAMETER;
+
+  m_deadlineUs = deadlineUsIn;
+
+  return LIMITER_OK;
+}
+
+const PeakLimiterExecutorStats* PeakLimiterExecutor::getExecutorStats()
+{
+  return &m_stats;
+}
+
+const PeakLimiterExecutorWorkerStats* PeakLimiterExecutor::getExecutorWorkerStats(int worker)
+{
+  if ((worker < 0) || (worker >= m_workers)) return NULL;
+
+  return &m_pWorkers[worker].stats;
+}
+
+int PeakLimiterExecutor::getExecutorNWorkers()
+{
+  return m_workers;
+}
+
+/* clear statistics, the cores of the workers are kept */
+void PeakLimiterExecutor::resetExecutorStats()
+{
+  int k, core;
+
+  memset(&m_stats, 0, sizeof(m_stats));
+  m_totalPeriodUs = 0;
+  for (k = 0; k < m_workers; k++) {
+    core = m_pWorkers[k].stats.core;
+    memset(&m_pWorkers[k].stats, 0, sizeof(m_pWorkers[k].stats));
+    m_pWorkers[k].stats.core = core;
+  }
+}
@@ -0,0 +1,199 @@
+/*
+Copyright (c) 2016, UMR STMS 9912 - Ircam-Centre Pompidou / CNRS / UPMC
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the <organization> nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __peaklimiterexecutor_h__
+#define __peaklimiterexecutor_h__
+
+#include "peakLimiter.h"
+
+#include <chrono>
+#include <thread>
+
+#define PEAKLIMITEREXECUTOR_CACHE_LINE    (64)
+#define PEAKLIMITEREXECUTOR_SPINS         (64)      /* yields of a waiting worker before it sleeps */
+#define PEAKLIMITEREXECUTOR_SLEEP_US      (50)      /* sleep of a waiting worker */
+
+/* statistics of the periods, see getExecutorStats */
+typedef struct {
+  int64_t       periods;
+  int64_t       deadlineMisses;     /* periods that ended after their deadline */
+  int64_t       lateTasks;          /* instances processed after the deadline of their period */
+  double        deadlineUs;         /* deadline of the last period */
+  double        lastPeriodUs;       /* duration of the last period */
+  double        meanPeriodUs;
+  double        maxPeriodUs;
+} PeakLimiterExecutorStats;
+
+/* statistics of one worker, see getExecutorWorkerStats */
+typedef struct {
+  int           core;               /* core the worker is pinned to, -1 if it is not */
+  int64_t       tasks;              /* instances processed */
+  int64_t       steals;             /* of them, taken from the queue of another worker */
+  int64_t       samples;            /* samples per channel processed */
+  double        busyUs;             /* time spent in the limiters */
+  float         load;               /* busyUs over the total duration of the periods */
+} PeakLimiterExecutorWorkerStats;
+
+/* work queue and statistics of one worker, on their own cache lines. The queue is the
+   range [head, tail[ of tasks, packed in one word: the owner takes from the head,
+   the other workers steal from the tail */
+typedef struct {
+  std::atomic<uint64_t> range;      /* tail << 32 | head */
+  int*          tasks;              /* instances queued for the period */
+  int           nTasks;
+  PeakLimiterExecutorWorkerStats stats;
+  char          pad[PEAKLIMITEREXECUTOR_CACHE_LINE];
+} PeakLimiterExecutorWorker;
+
+/******************************************************************************
+* PeakLimiterExecutor                                                         *
+* many limiters, one per session, processed period by period on a fixed set   *
+* of worker threads instead of one thread per session.                        *
+* Each period, every instance with a buffer is one task, queued on worker     *
+* instance % nWorkers, so that an instance stays on the same core and its     *
+* state in the same cache from period to period. A worker that runs out of    *
+* tasks steals from the end of the queues of the others. The calling thread   *
+* is worker 0; the other workers are threads of the executor, pinned to       *
+* consecutive cores on Linux. Between periods they yield, then sleep          *
+* PEAKLIMITEREXECUTOR_SLEEP_US, which is about their wake-up latency.         *
+* Each period has a deadline, by default its duration at the sample rate:     *
+* periods ending after it and instances processed after it are counted, with  *
+* the time spent by each worker in the limiters.                              *
+******************************************************************************/
+class PeakLimiterExecutor
+{
+
+public:
+  int           m_instances;
+  int           m_channels;
+  int           m_sampleRate;
+  PeakLimiter** m_ppLimiters;
+  float**       m_ppBuffers;            /* interleaved buffer of each instance, NULL: not processed */
+  int           m_workers;
+  PeakLimiterExecutorWorker* m_pWorkers;
+  std::thread*  m_pThreads;             /* workers 1 .. m_workers - 1 */
+  double        m_deadlineUs;           /* 0: the duration of the period */
+  double        m_totalPeriodUs;
+  PeakLimiterExecutorStats m_stats;
+  char          m_pad0[PEAKLIMITEREXECUTOR_CACHE_LINE];
+  std::atomic<unsigned int> m_period;   /* incremented to wake the workers up */
+  std::atomic<int> m_quit;
+  int           m_nSamples;             /* samples per channel of the period */
+  std::chrono::steady_clock::time_point m_deadline;
+  char          m_pad1[PEAKLIMITEREXECUTOR_CACHE_LINE];
+  std::atomic<int> m_remaining;         /* tasks of the period not processed yet */
+  std::atomic<int64_t> m_lateTasks;
+  char          m_pad2[PEAKLIMITEREXECUTOR_CACHE_LINE];
+
+public:
+
+/******************************************************************************
+* createLimiterExecutor                                                       *
+* nInstances:  number of limiters                                             *
+* attackMs, releaseMs, threshold, nChannels, sampleRate, maxEngine: settings  *
+*              of the limiters, see PeakLimiter                               *
+* nWorkers:    number of workers, the calling thread included, 0 (default):   *
+*              one per hardware thread                                        *
+* affinity:    1 (default): each worker thread is pinned to a core, from      *
+*              firstCore on (Linux only), 0: not pinned                       *
+* firstCore:   core of worker 1 (default 1, worker 0 being the caller)        *
+******************************************************************************/
+PeakLimiterExecutor(       int           nInstances,
+                           float         attackMs,
+                           float         releaseMs,
+                           float         threshold,
+                           int           nChannels,
+                           int           sampleRate,
+                           int           maxEngine = PEAKLIMITER_MAX_SECTIONS,
+                           int           nWorkers = 0,
+                           int           affinity = 1,
+                           int           firstCore = 1);
+~PeakLimiterExecutor();
+
+/******************************************************************************
+* getExecutorLimiter                                                          *
+* instance:    0 .. nInstances - 1                                            *
+* returns:     the limiter of the instance, NULL if out of range. Its         *
+*              parameters may be set from any thread, they are taken at the   *
+*              start of its next task, see PeakLimiter::setLimiterThreshold   *
+******************************************************************************/
+PeakLimiter* getExecutorLimiter( int instance);
+
+/******************************************************************************
+* setExecutorBuffer                                                           *
+* instance:    0 .. nInstances - 1                                            *
+* samples:     interleaved buffer of the instance, processed in place by the  *
+*              next periods, NULL: the instance is idle                       *
+* returns:     error code                                                     *
+* Not to be called during runExecutorPeriod                                   *
+******************************************************************************/
+int setExecutorBuffer( int instance, float* samples);
+
+/******************************************************************************
+* runExecutorPeriod                                                           *
+* nSamples:    samples per channel in the buffer of each instance             *
+* returns:     error code                                                     *
+* applyLimiter_E_I on the buffer of every instance, on all the workers.       *
+* Returns when all of them are processed; one thread calls it at a time       *
+******************************************************************************/
+int runExecutorPeriod( int nSamples);
+
+/******************************************************************************
+* setExecutorDeadline                                                         *
+* deadlineUs:  deadline of each period in microseconds from the call of       *
+*              runExecutorPeriod, 0 (default): nSamples / sampleRate          *
+* returns:     error code                                                     *
+******************************************************************************/
+int setExecutorDeadline( double deadlineUs);
+
+/******************************************************************************
+* getExecutorStats                                                            *
+* returns:     statistics of the periods since the creation or the last reset *
+******************************************************************************/
+const PeakLimiterExecutorStats* getExecutorStats();
+
+/******************************************************************************
+* getExecutorWorkerStats                                                      *
+* worker:      0 .. getExecutorNWorkers() - 1, 0 is the calling thread        *
+* returns:     statistics of the worker, NULL if out of range                 *
+******************************************************************************/
+const PeakLimiterExecutorWorkerStats* getExecutorWorkerStats( int worker);
+
+int getExecutorNWorkers();
+
+/******************************************************************************
+* resetExecutorStats                                                          *
+* clears the statistics, not to be called during runExecutorPeriod            *
+******************************************************************************/
+void resetExecutorStats();
+
+private:
+void workerThread( int worker);
+void runWorker( int worker);
+};
+
+#endif /* __peaklimiterexecutor_h__ */
@@ -0,0 +1,425 @@
+/*
+Copyright (c) 2016, UMR STMS 9912 - Ircam-Centre Pompidou / CNRS / UPMC
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the <organization> nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* Command line limiter for WAV, RF64 and raw PCM files, processed in place in memory maps.
+
+   build:  c++ -O2 -std=c++11 -pthread peakLimiterFile.cpp peakLimiterStream.cpp peakLimiter.cpp peakLimiterSimd.cpp \
+               -o peakLimiterFile
+   usage:  peakLimiterFile [options] input output
+           -threshold dB     limiting threshold in dBFS (default -1)
+           -attack ms        attack/lookahead time (default 20)
+           -release ms       release time (default 20)
+           -vhgw             exact lookahead maximum (PEAKLIMITER_MAX_VHGW)
+           -truepeak         detector on the inter-sample peaks
+           -raw s16|s24|s32|f32 -channels n -rate hz
+                             raw little endian input, the output is raw too
+           -block frames     frames per block of the stream mode (default 1024)
+           -depth blocks     blocks in flight in the stream mode (default 8)
+
+   The input and output files are mapped and the limiter reads and writes the mapped pages
+   directly, in blocks of PEAKLIMITERFILE_BLOCK frames: no copy of the samples. The output has
+   the same format as the input and is sample aligned with it: the first getLimiterDelay() frames
+   out of the limiter (the lookahead) are dropped and the tail is flushed with silence. WAV input
+   of 16/24/32 bit integer or 32 bit float PCM, the output is a WAV file, or RF64 when it does not
+   fit in 4 GB. POSIX, 64 bit, little endian hosts.
+
+   With - as input or output, e.g. in a pipe, the raw samples are streamed instead by
+   PeakLimiterStream: reader, limiter and writer threads, with the stalls and ring fill levels
+   reported at the end. */
+
+#include "peakLimiter.h"
+#include "peakLimiterStream.h"
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define PEAKLIMITERFILE_BLOCK   (1 << 16)     /* frames per applyLimiter call */
+#define PEAKLIMITERFILE_HEADER  (36)          /* JUNK or ds64 chunk reserved in the WAV header, with its header */
+
+typedef struct {
+  int           format;             /* PEAKLIMITERSTREAM_* */
+  int           channels;
+  int           sampleRate;
+  int           wav;                /* 0 for raw */
+  const uint8_t* fmtChunk;          /* fmt chunk of the input, with its header, copied to the output */
+  uint32_t      fmtChunkSize;
+  uint64_t      dataOffset;
+  uint64_t      dataSize;
+} FileInfo;
+
+static uint16_t readU16(const uint8_t* p) { return (uint16_t)(p[0] | (p[1] << 8)); }
+static uint32_t readU32(const uint8_t* p) { return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24); }
+static uint64_t readU64(const uint8_t* p) { return (uint64_t)readU32(p) | ((uint64_t)readU32(p + 4) << 32); }
+
+static void writeU16(uint8_t* p, uint16_t v) { p[0] = (uint8_t)v; p[1] = (uint8_t)(v >> 8); }
+static void writeU32(uint8_t* p, uint32_t v) { writeU16(p, (uint16_t)v); writeU16(p + 2, (uint16_t)(v >> 16)); }
+static void writeU64(uint8_t* p, uint64_t v) { writeU32(p, (uint32_t)v); writeU32(p + 4, (uint32_t)(v >> 32)); }
+
+/* parse a WAV or RF64 header, returns 0 on success */
+static int parseWav(const uint8_t* file, uint64_t fileSize, FileInfo* info)
+{
+  uint64_t pos = 12, chunkSize, ds64DataSize = 0;
+  int rf64, tag, bits;
+
+  if (fileSize < 12 || memcmp(file + 8, "WAVE", 4))
+    return -1;
+  if (!memcmp(file, "RIFF", 4))
+    rf64 = 0;
+  else if (!memcmp(file, "RF64", 4))
+    rf64 = 1;
+  else
+    return -1;
+
+  info->fmtChunk = NULL;
+  while (pos + 8 <= fileSize) {
+    chunkSize = readU32(file + pos + 4);
+    if (!memcmp(file + pos, "ds64", 4) && chunkSize >= 24 && pos + 8 + 24 <= fileSize)
+      ds64DataSize = readU64(file + pos + 8 + 8);
+    else if (!memcmp(file + pos, "fmt ", 4) && chunkSize >= 16 && pos + 8 + chunkSize <= fileSize) {
+      info->fmtChunk = file + pos;
+      info->fmtChunkSize = (uint32_t)(8 + chunkSize);
+    }
+    else if (!memcmp(file + pos, "data", 4)) {
+      if (rf64 && chunkSize == 0xFFFFFFFF)
+        chunkSize = ds64DataSize;
+      info->dataOffset = pos + 8;
+      info->dataSize = std::min(chunkSize, fileSize - info->dataOffset);
+      break;
+    }
+    pos += 8 + chunkSize + (chunkSize & 1);
+  }
+  if (info->fmtChunk == NULL || pos + 8 > fileSize)
+    return -1;
+
+  tag = readU16(info->fmtChunk + 8);
+  info->channels = readU16(info->fmtChunk + 10);
+  info->sampleRate = (int)readU32(info->fmtChunk + 12);
+  bits = readU16(info->fmtChunk + 22);
+  if (tag == 0xFFFE && info->fmtChunkSize >= 8 + 40)
+    tag = readU16(info->fmtChunk + 8 + 24);                /* sub format of WAVE_FORMAT_EXTENSIBLE */
+
+  if (tag == 1 && bits == 16)
+    info->format = PEAKLIMITERSTREAM_INT16;
+  else if (tag == 1 && bits == 24)
+    info->format = PEAKLIMITERSTREAM_INT24;
+  else if (tag == 1 && bits == 32)
+    info->format = PEAKLIMITERSTREAM_INT32;
+  else if (tag == 3 && bits == 32)
+    info->format = PEAKLIMITERSTREAM_FLOAT32;
+  else
+    return -1;
+  if (info->channels < 1 || info->sampleRate < 1)
+    return -1;
+
+  info->wav = 1;
+  return 0;
+}
+
+/* size of the output header, data chunk header included */
+static uint64_t wavHeaderSize(const FileInfo* info)
+{
+  return 12 + PEAKLIMITERFILE_HEADER + info->fmtChunkSize + (info->fmtChunkSize & 1) + 8;
+}
+
+/* WAV header with a JUNK chunk, replaced by a ds64 chunk (RF64) when the file is larger than 4 GB */
+static void writeWavHeader(uint8_t* p, const FileInfo* info)
+{
+  uint64_t headerSize = wavHeaderSize(info);
+  uint64_t riffSize = headerSize - 8 + info->dataSize + (info->dataSize & 1);
+  int rf64 = (riffSize > 0xFFFFFFFFu);
+
+  memset(p, 0, (size_t)headerSize);
+  memcpy(p, rf64 ? "RF64" : "RIFF", 4);
+  writeU32(p + 4, rf64 ? 0xFFFFFFFF : (uint32_t)riffSize);
+  memcpy(p + 8, "WAVE", 4);
+  p += 12;
+
+  memcpy(p, rf64 ? "ds64" : "JUNK", 4);
+  writeU32(p + 4, PEAKLIMITERFILE_HEADER - 8);
+  if (rf64) {
+    writeU64(p + 8, riffSize);
+    writeU64(p + 16, info->dataSize);
+    writeU64(p + 24, info->dataSize / ((uint64_t)PeakLimiterStream::getFormatBytes(info->format) * info->channels));
+  }
+  p += PEAKLIMITERFILE_HEADER;
+
+  memcpy(p, info->fmtChunk, info->fmtChunkSize);
+  writeU32(p + 4, info->fmtChunkSize - 8);
+  p += info->fmtChunkSize + (info->fmtChunkSize & 1);
+
+  memcpy(p, "data", 4);
+  writeU32(p + 4, rf64 ? 0xFFFFFFFF : (uint32_t)info->dataSize);
+}
+
+/* limiter on nFrames input frames whose output is frame outIndex of the output data:
+   the frames before the start of the output (outIndex < 0, the lookahead) go to the scratch.
+   Returns the maximum gain reduction in dB */
+static float processFrames(PeakLimiter* limiter, int format, size_t frameBytes, const uint8_t* in, int64_t nFrames,
+                           uint8_t* outData, int64_t outIndex, uint8_t* scratch)
+{
+  float maxGainReduction = 0;
+  int64_t blockLen;
+  uint8_t* out;
+
+  while (nFrames > 0) {
+    blockLen = std::min(nFrames, (int64_t)PEAKLIMITERFILE_BLOCK);
+    if (outIndex < 0) {
+      blockLen = std::min(blockLen, -outIndex);
+      out = scratch;
+    }
+    else
+      out = outData + outIndex * frameBytes;
+
+    PeakLimiterStream::applyLimiterFormat(limiter, format, in, out, (int)blockLen);
+    maxGainReduction = std::max(maxGainReduction, limiter->getLimiterMaxGainReduction());
+
+    in += blockLen * frameBytes;
+    outIndex += blockLen;
+    nFrames -= blockLen;
+  }
+  return maxGainReduction;
+}
+
+/* stream mode: raw samples through the three stages of PeakLimiterStream */
+static int streamFiles(PeakLimiter* limiter, int format, int blockFrames, int depth, const char* inName, const char* outName)
+{
+  int inFile = !strcmp(inName, "-") ? STDIN_FILENO : open(inName, O_RDONLY);
+  int outFile = !strcmp(outName, "-") ? STDOUT_FILENO : open(outName, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  const PeakLimiterStreamStats* stats;
+  int error;
+
+  if (inFile < 0 || outFile < 0) {
+    perror(inFile < 0 ? inName : outName);
+    return 1;
+  }
+  if (limiter->getLimiterMemory() == NULL) {
+    fprintf(stderr, "cannot create the limiter\n");
+    return 1;
+  }
+
+  /* a closed output pipe is reported as a write error */
+  signal(SIGPIPE, SIG_IGN);
+
+  PeakLimiterStream stream(limiter, format, blockFrames, depth);
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  error = stream.runLimiterStream(inFile, outFile);
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  stats = stream.getStreamStats();
+  fprintf(stderr, "%lld frames, %lld blocks, %.2f s, max gain reduction %.2f dB\n"
+                  "stalls: reader %lld (output backpressure), limiter %lld (%.1f ms, input starvation), writer %lld\n"
+                  "blocks waiting: limiter %.2f (max %d), writer %.2f (max %d) of %d\n",
+          (long long)stats->frames, (long long)stats->blocks, seconds, stats->maxGainReduction,
+          (long long)stats->readerStalls, (long long)stats->limiterStalls, stats->limiterStallMs,
+          (long long)stats->writerStalls,
+          stats->inputFillMean, stats->inputFillMax, stats->outputFillMean, stats->outputFillMax, stream.m_depth);
+  if (error != LIMITER_OK)
+    fprintf(stderr, "read or write error\n");
+
+  if (inFile != STDIN_FILENO)
+    close(inFile);
+  if (outFile != STDOUT_FILENO)
+    close(outFile);
+  return (error != LIMITER_OK);
+}
+
+static int usage(const char* name)
+{
+  fprintf(stderr, "usage: %s [-threshold dB] [-attack ms] [-release ms] [-vhgw] [-truepeak]\n"
+                  "       [-raw s16|s24|s32|f32 -channels n -rate hz] [-block frames] [-depth blocks] input output\n", name);
+  return 1;
+}
+
+int main(int argc, char* argv[])
+{
+  float thresholdDb = -1.0f, attackMs = PEAKLIMITER_ATTACK_DEFAULT_MS, releaseMs = PEAKLIMITER_RELEASE_DEFAULT_MS;
+  int engine = PEAKLIMITER_MAX_SECTIONS, truePeak = 0, raw = 0, i;
+  int blockFrames = PEAKLIMITERSTREAM_BLOCK_DEFAULT, depth = PEAKLIMITERSTREAM_DEPTH_DEFAULT;
+  const char *inName = NULL, *outName = NULL;
+  FileInfo info;
+  struct stat inStat, outStat;
+  const uint8_t* inMap = NULL;
+  uint8_t* outMap = NULL;
+  uint64_t outHeaderSize = 0, outSize;
+  int64_t nFrames, delay;
+  float maxGainReduction = 0;
+  size_t frameBytes;
+  int inFile, outFile;
+  PeakLimiter* limiter;
+  std::vector<uint8_t> scratch, silence;
+
+  memset(&info, 0, sizeof(info));
+  for (i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "-threshold") && i + 1 < argc)
+      thresholdDb = (float)atof(argv[++i]);
+    else if (!strcmp(argv[i], "-attack") && i + 1 < argc)
+      attackMs = (float)atof(argv[++i]);
+    else if (!strcmp(argv[i], "-release") && i + 1 < argc)
+      releaseMs = (float)atof(argv[++i]);
+    else if (!strcmp(argv[i], "-vhgw"))
+      engine = PEAKLIMITER_MAX_VHGW;
+    else if (!strcmp(argv[i], "-truepeak"))
+      truePeak = 1;
+    else if (!strcmp(argv[i], "-raw") && i + 1 < argc) {
+      raw = 1;
+      i++;
+      if (!strcmp(argv[i], "s16"))      info.format = PEAKLIMITERSTREAM_INT16;
+      else if (!strcmp(argv[i], "s24")) info.format = PEAKLIMITERSTREAM_INT24;
+      else if (!strcmp(argv[i], "s32")) info.format = PEAKLIMITERSTREAM_INT32;
+      else if (!strcmp(argv[i], "f32")) info.format = PEAKLIMITERSTREAM_FLOAT32;
+      else return usage(argv[0]);
+    }
+    else if (!strcmp(argv[i], "-channels") && i + 1 < argc)
+      info.channels = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-rate") && i + 1 < argc)
+      info.sampleRate = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-block") && i + 1 < argc)
+      blockFrames = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-depth") && i + 1 < argc)
+      depth = atoi(argv[++i]);
+    else if ((argv[i][0] != '-' || !strcmp(argv[i], "-")) && inName == NULL)
+      inName = argv[i];
+    else if ((argv[i][0] != '-' || !strcmp(argv[i], "-")) && outName == NULL)
+      outName = argv[i];
+    else
+      return usage(argv[0]);
+  }
+  if (inName == NULL || outName == NULL || (raw && (info.channels < 1 || info.sampleRate < 1)))
+    return usage(argv[0]);
+
+  if (!strcmp(inName, "-") || !strcmp(outName, "-")) {
+    if (!raw) {
+      fprintf(stderr, "streaming needs raw samples, see -raw\n");
+      return 1;
+    }
+    limiter = new PeakLimiter(attackMs, releaseMs, (float)pow(10.0, thresholdDb / 20.0), info.channels, info.sampleRate, engine);
+    limiter->setLimiterTruePeak(truePeak);
+    i = streamFiles(limiter, info.format, blockFrames, depth, inName, outName);
+    delete limiter;
+    return i;
+  }
+
+  /* map the input */
+  inFile = open(inName, O_RDONLY);
+  if (inFile < 0 || fstat(inFile, &inStat)) {
+    perror(inName);
+    return 1;
+  }
+  if (inStat.st_size > 0) {
+    inMap = (const uint8_t*)mmap(NULL, (size_t)inStat.st_size, PROT_READ, MAP_SHARED, inFile, 0);
+    if (inMap == MAP_FAILED) {
+      perror(inName);
+      return 1;
+    }
+    madvise((void*)inMap, (size_t)inStat.st_size, MADV_SEQUENTIAL);
+  }
+
+  if (raw) {
+    info.dataOffset = 0;
+    info.dataSize = (uint64_t)inStat.st_size;
+  }
+  else if (parseWav(inMap, (uint64_t)inStat.st_size, &info)) {
+    fprintf(stderr, "%s: not a 16/24/32 bit integer or 32 bit float WAV/RF64 file\n", inName);
+    return 1;
+  }
+  frameBytes = (size_t)PeakLimiterStream::getFormatBytes(info.format) * info.channels;
+  nFrames = (int64_t)(info.dataSize / frameBytes);
+  info.dataSize = (uint64_t)nFrames * frameBytes;
+
+  /* map the output, a file of its final size */
+  outFile = open(outName, O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (outFile < 0 || fstat(outFile, &outStat)) {
+    perror(outName);
+    return 1;
+  }
+  if (outStat.st_dev == inStat.st_dev && outStat.st_ino == inStat.st_ino) {
+    fprintf(stderr, "%s: the output must be another file than the input\n", outName);
+    return 1;
+  }
+  if (info.wav)
+    outHeaderSize = wavHeaderSize(&info);
+  outSize = outHeaderSize + info.dataSize + (info.wav ? (info.dataSize & 1) : 0);
+  if (ftruncate(outFile, (off_t)outSize)) {
+    perror(outName);
+    return 1;
+  }
+  if (outSize > 0) {
+    outMap = (uint8_t*)mmap(NULL, (size_t)outSize, PROT_READ | PROT_WRITE, MAP_SHARED, outFile, 0);
+    if (outMap == MAP_FAILED) {
+      perror(outName);
+      return 1;
+    }
+    madvise(outMap, (size_t)outSize, MADV_SEQUENTIAL);
+  }
+  if (info.wav)
+    writeWavHeader(outMap, &info);
+
+  limiter = new PeakLimiter(attackMs, releaseMs, (float)pow(10.0, thresholdDb / 20.0), info.channels, info.sampleRate, engine);
+  if (limiter->getLimiterMemory() == NULL) {
+    fprintf(stderr, "cannot create the limiter\n");
+    return 1;
+  }
+  limiter->setLimiterTruePeak(truePeak);
+  delay = limiter->getLimiterDelay();
+  scratch.resize((size_t)delay * frameBytes);
+  silence.assign((size_t)delay * frameBytes, 0);
+
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+  /* the whole input, then the tail flushed with silence, shifted by the delay.
+     Without lookahead (attack 0) the delay, the scratch and the tail are empty */
+  if (nFrames > 0)
+    maxGainReduction = processFrames(limiter, info.format, frameBytes, inMap + info.dataOffset, nFrames,
+                  outMap + outHeaderSize, -delay, scratch.data());
+  if (delay > 0)
+    maxGainReduction = std::max(maxGainReduction,
+                                processFrames(limiter, info.format, frameBytes, silence.data(), delay,
+                                              outMap + outHeaderSize, nFrames - delay, scratch.data()));
+
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  fprintf(stderr, "%lld frames, %d channels, %.2f s, %.1f MB/s, max gain reduction %.2f dB\n",
+          (long long)nFrames, info.channels, seconds, seconds > 0 ? 2.0 * info.dataSize / seconds * 1e-6 : 0.0,
+          maxGainReduction);
+
+  delete limiter;
+  if (outMap != NULL && munmap(outMap, (size_t)outSize)) {
+    perror(outName);
+    return 1;
+  }
+  if (inMap != NULL)
+    munmap((void*)inMap, (size_t)inStat.st_size);
+  close(outFile);
+  close(inFile);
+  return 0;
+}
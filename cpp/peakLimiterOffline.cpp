@@ -0,0 +1,271 @@
+/*
+Copyright (c) 2016, UMR STMS 9912 - Ircam-Centre Pompidou / CNRS / UPMC
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the <organization> nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "peakLimiterOffline.h"
+
+#include <thread>
+#include <atomic>
+#include <vector>
+
+#ifndef max
+#define max(a, b)   (((a) > (b)) ? (a) : (b))
+#endif
+#ifndef min
+#define min(a, b)   (((a) < (b)) ? (a) : (b))
+#endif
+
+/* create offline limiter */
+PeakLimiterOffline::PeakLimiterOffline(
+                           float         attackMsIn,
+                           float         releaseMsIn,
+                           float         thresholdIn,
+                           int           nChannelsIn,
+                           int           sampleRateIn,
+                           int           maxEngineIn
+                           )
+{
+  m_attackMs     = attackMsIn;
+  m_releaseMs    = releaseMsIn;
+  m_threshold    = thresholdIn;
+  m_channels     = nChannelsIn;
+  m_sampleRate   = sampleRateIn;
+  m_maxEngine    = maxEngineIn;
+
+  /* same as PeakLimiter */
+  m_attack = (int)(attackMsIn * sampleRateIn / 1000);
+  if (m_attack < 1)
+    m_attack = 1;
+  m_delay = (attackMsIn == 0) ? 0 : m_attack;
+
+  m_threads      = 0;
+  m_chunkLen     = (int64_t)PEAKLIMITEROFFLINE_CHUNK_DEFAULT_S * sampleRateIn;
+  m_preRoll      = m_attack + 1 + (int64_t)(PEAKLIMITEROFFLINE_PREROLL_RELEASES * releaseMsIn * sampleRateIn / 1000);
+  m_verify       = 0;
+  m_maxDeviation = -1;
+}
+
+PeakLimiterOffline::~PeakLimiterOffline()
+{
+}
+
+/* limiter of a thread, NULL if its memory cannot be allocated */
+PeakLimiter* PeakLimiterOffline::createChunkLimiter()
+{
+  PeakLimiter* limiter = new PeakLimiter(m_attackMs, m_releaseMs, m_threshold, m_channels, m_sampleRate, m_maxEngine);
+
+  if (limiter->getLimiterMemory() == NULL) {
+    delete limiter;
+    return NULL;
+  }
+
+  return limiter;
+}
+
+/* limited samples [first, last[ of the signal: the limiter starts preRoll samples
+   before first and runs getLimiterDelay() samples past last, silence after the end
+   of the signal, only the delayed output of [first, last[ is kept.
+   The start is rounded down to a multiple of m_attack+1, the period of the maximum
+   buffer sections, which then cover the same samples as in a serial run.
+   With gain, the gain curve is kept instead of the output (samplesOut is not used),
+   scratch then holds a block of gains after the block of samples */
+void PeakLimiterOffline::processChunk(PeakLimiter* limiter, float* scratch, const float* samplesIn, float* samplesOut, float* gain,
+                                      int64_t nSamples, int64_t first, int64_t last, int64_t preRoll)
+{
+  int64_t start, end, pos, keep, avail;
+  int len;
+  float* gainScratch = scratch + PEAKLIMITEROFFLINE_SCRATCH_SIZE * m_channels;
+
+  start = max(first - preRoll, (int64_t)0);
+  start -= start % (m_attack + 1);
+  end   = last + m_delay;
+
+  limiter->resetLimiter();
+
+  for (pos = start; pos < end; pos += len) {
+    len = (int)min(end - pos, (int64_t)PEAKLIMITEROFFLINE_SCRATCH_SIZE);
+
+    avail = min(max(nSamples - pos, (int64_t)0), (int64_t)len);
+    memcpy(scratch, samplesIn + pos * m_channels, sizeof(float) * avail * m_channels);
+    memset(scratch + avail * m_channels, 0, sizeof(float) * (len - avail) * m_channels);
+
+    if (gain)
+      limiter->analyzeLimiter_E(scratch, gainScratch, len);
+    else
+      limiter->applyLimiter_E_I(scratch, len);
+
+    /* output sample pos+k is the input sample pos+k-m_delay */
+    keep = max(first + m_delay - pos, (int64_t)0);
+    if (keep >= len)
+      continue;
+    if (gain)
+      memcpy(gain + pos + keep - m_delay, gainScratch + keep, sizeof(float) * (len - keep));
+    else
+      memcpy(samplesOut + (pos + keep - m_delay) * m_channels, scratch + keep * m_channels,
+             sizeof(float) * (len - keep) * m_channels);
+  }
+}
+
+/* the whole signal, output or gain: the chunks are taken in order by the threads.
+   A thread without a limiter takes no chunk, the others process them all: it fails
+   only if chunks are left */
+int PeakLimiterOffline::processChunks(const float* samplesIn, float* samplesOut, float* gain, int64_t nSamples)
+{
+  int k, nThreads;
+  int64_t nChunks;
+  std::atomic<int64_t> nextChunk(0);
+  std::vector<std::thread> threads;
+
+  nChunks = (nSamples + m_chunkLen - 1) / m_chunkLen;
+  nThreads = (m_threads > 0) ? m_threads : (int)std::thread::hardware_concurrency();
+  nThreads = (int)max(min((int64_t)nThreads, nChunks), (int64_t)1);
+
+  for (k = 0; k < nThreads; k++) {
+    threads.push_back(std::thread([this, samplesIn, samplesOut, gain, nSamples, nChunks, &nextChunk]() {
+      std::vector<float> scratch(PEAKLIMITEROFFLINE_SCRATCH_SIZE * (m_channels + 1));
+      PeakLimiter* limiter = createChunkLimiter();
+      int64_t chunk;
+
+      if (limiter == NULL)
+        return;
+      while ((chunk = nextChunk++) < nChunks)
+        processChunk(limiter, &scratch[0], samplesIn, samplesOut, gain, nSamples,
+                     chunk * m_chunkLen, min((chunk + 1) * m_chunkLen, nSamples), m_preRoll);
+
+      delete limiter;
+    }));
+  }
+  for (k = 0; k < nThreads; k++)
+    threads[k].join();
+
+  return (nextChunk.load() < nChunks) ? LIMITER_INVALID_HANDLE : LIMITER_OK;
+}
+
+/* apply limiter on the whole signal */
+int PeakLimiterOffline::applyLimiter_E(const float* samplesIn, float* samplesOut, int64_t nSamples)
+{
+  std::vector<float> serial;
+  std::thread serialThread;
+  int err, serialDone = 0;
+
+  if ((samplesIn == NULL) || (samplesOut == NULL) || (nSamples < 0)) return LIMITER_INVALID_PARAMETER;
+  if ((samplesOut < samplesIn + nSamples * m_channels) && (samplesIn < samplesOut + nSamples * m_channels))
+    return LIMITER_INVALID_PARAMETER;
+
+  /* reference: the whole signal as a single chunk */
+  m_maxDeviation = -1;
+  if (m_verify) {
+    serial.resize((size_t)(nSamples * m_channels));
+    serialThread = std::thread([this, samplesIn, &serial, &serialDone, nSamples]() {
+      std::vector<float> scratch(PEAKLIMITEROFFLINE_SCRATCH_SIZE * (m_channels + 1));
+      PeakLimiter* limiter = createChunkLimiter();
+      if (limiter == NULL)
+        return;
+      processChunk(limiter, &scratch[0], samplesIn, serial.data(), NULL, nSamples, 0, nSamples, 0);
+      delete limiter;
+      serialDone = 1;
+    });
+  }
+
+  err = processChunks(samplesIn, samplesOut, NULL, nSamples);
+
+  if (m_verify)
+    serialThread.join();
+  if (m_verify && serialDone && (err == LIMITER_OK)) {
+    int64_t i;
+    float deviation = 0;
+
+    for (i = 0; i < nSamples * m_channels; i++)
+      deviation = max(deviation, (float)fabs(samplesOut[i] - serial[(size_t)i]));
+    m_maxDeviation = deviation;
+  }
+
+  return err;
+}
+
+/* gain curve of applyLimiter_E on the whole signal */
+int PeakLimiterOffline::analyzeLimiter_E(const float* samplesIn, float* gain, int64_t nSamples)
+{
+  if ((samplesIn == NULL) || (gain == NULL) || (nSamples < 0)) return LIMITER_INVALID_PARAMETER;
+
+  return processChunks(samplesIn, NULL, gain, nSamples);
+}
+
+/* get maximum deviation from a serial run */
+float PeakLimiterOffline::getLimiterMaxDeviation()
+{
+  return m_maxDeviation;
+}
+
+/* get delay compensated by applyLimiter_E */
+int PeakLimiterOffline::getLimiterDelay()
+{
+  return m_delay;
+}
+
+/* get pre-roll in samples */
+int64_t PeakLimiterOffline::getLimiterPreRoll()
+{
+  return m_preRoll;
+}
+
+/* set number of threads */
+int PeakLimiterOffline::setLimiterThreads(int nThreadsIn)
+{
+  if (nThreadsIn < 0) return LIMITER_INVALID_PARAMETER;
+
+  m_threads = nThreadsIn;
+
+  return LIMITER_OK;
+}
+
+/* set chunk length */
+int PeakLimiterOffline::setLimiterChunkSize(int64_t chunkLenIn)
+{
+  if (chunkLenIn < 1) return LIMITER_INVALID_PARAMETER;
+
+  m_chunkLen = chunkLenIn;
+
+  return LIMITER_OK;
+}
+
+/* set pre-roll */
+int PeakLimiterOffline::setLimiterPreRoll(int64_t preRollIn)
+{
+  if (preRollIn < m_attack + 1) return LIMITER_INVALID_PARAMETER;
+
+  m_preRoll = preRollIn;
+
+  return LIMITER_OK;
+}
+
+/* enable verification against a serial run */
+int PeakLimiterOffline::setLimiterVerify(int verifyIn)
+{
+  m_verify = (verifyIn != 0);
+
+  return LIMITER_OK;
+}
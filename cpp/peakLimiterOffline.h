@@ -0,0 +1,167 @@
+/*
+Copyright (c) 2016, UMR STMS 9912 - Ircam-Centre Pompidou / CNRS / UPMC
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the <organization> nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __peaklimiteroffline_h__
+#define __peaklimiteroffline_h__
+
+#include "peakLimiter.h"
+
+#define PEAKLIMITEROFFLINE_CHUNK_DEFAULT_S    (10)     /* default chunk length in seconds */
+#define PEAKLIMITEROFFLINE_PREROLL_RELEASES   (6)      /* default pre-roll: attack + this many release times */
+#define PEAKLIMITEROFFLINE_SCRATCH_SIZE       (4096)   /* frames per PeakLimiter call */
+
+/******************************************************************************
+* PeakLimiterOffline                                                          *
+* offline processing of a whole signal in memory, split in chunks processed   *
+* in parallel by one PeakLimiter per thread.                                  *
+* Each chunk is preceded by a pre-roll: the limiter runs over the preceding   *
+* samples and drops their output, so that the maximum search (exact after     *
+* the attack time) and the gain smoothing (error divided by 10 at least every *
+* release time) have converged to the state of a serial run when the chunk    *
+* starts. The first chunk is exact.                                           *
+* The output is delay compensated: samplesOut[i] is the limited samplesIn[i], *
+* i.e. the output of a serial PeakLimiter shifted by getLimiterDelay()        *
+* samples, the end of the signal being flushed with silence.                  *
+******************************************************************************/
+class PeakLimiterOffline
+{
+
+public:
+  float         m_attackMs, m_releaseMs;
+  float         m_threshold;
+  int           m_channels;
+  int           m_sampleRate;
+  int           m_maxEngine;
+  int           m_attack;
+  int           m_delay;                /* delay of the limiters, compensated: m_attack, 0 without lookahead */
+  int           m_threads;
+  int64_t       m_chunkLen;
+  int64_t       m_preRoll;
+  int           m_verify;
+  float         m_maxDeviation;
+
+public:
+
+/******************************************************************************
+* createLimiterOffline                                                        *
+* attackMs:    attack/lookahead time in milliseconds                          *
+* releaseMs:   release time in milliseconds (90% time constant)               *
+* threshold:   limiting threshold                                             *
+* nChannels:   number of channels                                             *
+* sampleRate:  sampling rate in Hz                                            *
+* maxEngine:   lookahead maximum search of the limiters (PEAKLIMITER_MAX_*)   *
+******************************************************************************/
+PeakLimiterOffline(        float         attackMs,
+                           float         releaseMs,
+                           float         threshold,
+                           int           nChannels,
+                           int           sampleRate,
+                           int           maxEngine = PEAKLIMITER_MAX_SECTIONS);
+~PeakLimiterOffline();
+
+/******************************************************************************
+* applyLimiter_E                                                              *
+* samplesIn:   input buffer containing the whole interleaved signal           *
+* samplesOut:  output buffer containing the whole interleaved signal, delay   *
+*              compensated, must not overlap samplesIn                        *
+* nSamples:    number of samples per channel                                  *
+* returns:     error code, LIMITER_INVALID_HANDLE if no limiter could be      *
+*              allocated                                                      *
+******************************************************************************/
+int applyLimiter_E(
+                 const float*       samplesIn,
+                 float*             samplesOut,
+                 int64_t            nSamples);
+
+/******************************************************************************
+* analyzeLimiter_E                                                            *
+* samplesIn:   input buffer containing the whole interleaved signal           *
+* gain:        receives the gain of each sample, delay compensated: the       *
+*              output of applyLimiter_E is samplesIn[i] times gain[i],        *
+*              clamped to +/- threshold, see PeakLimiterEnvelope              *
+* nSamples:    number of samples per channel                                  *
+* returns:     error code, LIMITER_INVALID_HANDLE if no limiter could be      *
+*              allocated                                                      *
+* Same chunks and pre-roll as applyLimiter_E, so the same output              *
+******************************************************************************/
+int analyzeLimiter_E(
+                 const float*       samplesIn,
+                 float*             gain,
+                 int64_t            nSamples);
+
+/******************************************************************************
+* getLimiterMaxDeviation                                                      *
+* returns: maximum absolute difference between the output of the last         *
+*          applyLimiter_E call and a serial run, -1 if not verified           *
+******************************************************************************/
+float getLimiterMaxDeviation();
+
+int getLimiterDelay();
+
+int64_t getLimiterPreRoll();
+
+/******************************************************************************
+* setLimiterThreads                                                           *
+* nThreads:   number of threads, 0 (default): one per hardware thread         *
+* returns:    error code                                                      *
+******************************************************************************/
+int setLimiterThreads( int nThreads);
+
+/******************************************************************************
+* setLimiterChunkSize                                                         *
+* chunkLen:   samples per channel in each chunk                               *
+*             (default: PEAKLIMITEROFFLINE_CHUNK_DEFAULT_S seconds)           *
+* returns:    error code                                                      *
+******************************************************************************/
+int setLimiterChunkSize( int64_t chunkLen);
+
+/******************************************************************************
+* setLimiterPreRoll                                                           *
+* preRoll:    samples per channel processed before each chunk, at least the   *
+*             attack time plus one sample (default: attack time +             *
+*             PEAKLIMITEROFFLINE_PREROLL_RELEASES release times)              *
+* returns:    error code                                                      *
+******************************************************************************/
+int setLimiterPreRoll( int64_t preRoll);
+
+/******************************************************************************
+* setLimiterVerify                                                            *
+* verify:     1: applyLimiter_E also runs the whole signal serially on one    *
+*             more thread and measures the maximum deviation of the chunked   *
+*             output, see getLimiterMaxDeviation                              *
+* returns:    error code                                                      *
+******************************************************************************/
+int setLimiterVerify( int verify);
+
+private:
+PeakLimiter* createChunkLimiter();
+void processChunk( PeakLimiter* limiter, float* scratch, const float* samplesIn, float* samplesOut, float* gain,
+                   int64_t nSamples, int64_t first, int64_t last, int64_t preRoll);
+int processChunks( const float* samplesIn, float* samplesOut, float* gain, int64_t nSamples);
+};
+
+#endif /* __peaklimiteroffline_h__ */
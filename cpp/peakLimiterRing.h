@@ -0,0 +1,140 @@
+/*
+Copyright (c) 2016, UMR STMS 9912 - Ircam-Centre Pompidou / CNRS / UPMC
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the <organization> nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __peaklimiterring_h__
+#define __peaklimiterring_h__
+
+#include <atomic>
+
+#define PEAKLIMITERRING_CACHE_LINE   (64)
+
+/******************************************************************************
+* PeakLimiterRing                                                             *
+* single producer / single consumer lock-free ring of fixed size items.       *
+* The items are allocated once on creation, push and pop never block nor     *
+* allocate. One thread only pushes, one thread only pops.                     *
+* The read and write indices run freely and live on separate cache lines.     *
+******************************************************************************/
+template <class T>
+class PeakLimiterRing
+{
+
+public:
+  T*            m_pItems;
+  unsigned int  m_size, m_mask;
+  char          m_pad0[PEAKLIMITERRING_CACHE_LINE];
+  std::atomic<unsigned int> m_writeIndex;   /* written by the producer */
+  unsigned int  m_cachedReadIndex;          /* producer copy of m_readIndex */
+  char          m_pad1[PEAKLIMITERRING_CACHE_LINE];
+  std::atomic<unsigned int> m_readIndex;    /* written by the consumer */
+  unsigned int  m_cachedWriteIndex;         /* consumer copy of m_writeIndex */
+  char          m_pad2[PEAKLIMITERRING_CACHE_LINE];
+
+public:
+
+/******************************************************************************
+* createRing                                                                  *
+* size:      number of items, rounded up to a power of two                    *
+******************************************************************************/
+PeakLimiterRing( unsigned int size)
+{
+  m_size = 1;
+  while (m_size < size)
+    m_size <<= 1;
+  m_mask = m_size - 1;
+  m_pItems = new T[m_size];
+  m_writeIndex = 0;
+  m_readIndex = 0;
+  m_cachedReadIndex = 0;
+  m_cachedWriteIndex = 0;
+}
+
+~PeakLimiterRing()
+{
+  delete [] m_pItems;
+}
+
+/******************************************************************************
+* push                                                                        *
+* producer thread only                                                        *
+* returns:   1 if the item was pushed, 0 if the ring is full                  *
+******************************************************************************/
+int push( const T& item)
+{
+  unsigned int write = m_writeIndex.load(std::memory_order_relaxed);
+
+  if (write - m_cachedReadIndex >= m_size) {
+    m_cachedReadIndex = m_readIndex.load(std::memory_order_acquire);
+    if (write - m_cachedReadIndex >= m_size)
+      return 0;
+  }
+  m_pItems[write & m_mask] = item;
+  m_writeIndex.store(write + 1, std::memory_order_release);
+
+  return 1;
+}
+
+/******************************************************************************
+* pop                                                                         *
+* consumer thread only                                                        *
+* items:     receives up to maxItems items, oldest first                      *
+* returns:   number of items read                                             *
+******************************************************************************/
+unsigned int pop( T* items, unsigned int maxItems)
+{
+  unsigned int read = m_readIndex.load(std::memory_order_relaxed);
+  unsigned int k, n;
+
+  if (m_cachedWriteIndex - read < maxItems)
+    m_cachedWriteIndex = m_writeIndex.load(std::memory_order_acquire);
+  n = m_cachedWriteIndex - read;
+  if (n > maxItems)
+    n = maxItems;
+
+  for (k = 0; k < n; k++)
+    items[k] = m_pItems[(read + k) & m_mask];
+  m_readIndex.store(read + n, std::memory_order_release);
+
+  return n;
+}
+
+/******************************************************************************
+* count                                                                       *
+* any thread                                                                  *
+* returns:   number of items in the ring, a snapshot for statistics           *
+******************************************************************************/
+unsigned int count() const
+{
+  return m_writeIndex.load(std::memory_order_relaxed) - m_readIndex.load(std::memory_order_relaxed);
+}
+
+private:
+PeakLimiterRing( const PeakLimiterRing&);
+PeakLimiterRing& operator=( const PeakLimiterRing&);
+};
+
+#endif /* __peaklimiterring_h__ */
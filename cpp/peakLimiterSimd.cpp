@@ -0,0 +1,1044 @@
+/*
+Copyright (c) 2016, UMR STMS 9912 - Ircam-Centre Pompidou / CNRS / UPMC
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the <organization> nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "peakLimiterSimd.h"
+
+#include <math.h>
+#include <stddef.h>
+#include <chrono>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define PEAKLIMITER_HAVE_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64)
+#define PEAKLIMITER_HAVE_NEON
+#include <arm_neon.h>
+#elif defined(__wasm_simd128__)
+#define PEAKLIMITER_HAVE_WASM
+#include <wasm_simd128.h>
+#endif
+
+/* all kernels must round the same way: no multiply-add contraction, which
+   GCC would otherwise do on the AVX-512 intrinsics */
+#if defined(__clang__)
+#pragma clang fp contract(off)
+#elif defined(__GNUC__)
+#pragma GCC optimize("fp-contract=off")
+#endif
+
+/* the AVX2/AVX-512 kernels are compiled for their instruction set whatever
+   the global compiler flags are, and only called if the CPU supports them */
+#if defined(__GNUC__) || defined(__clang__)
+#define PEAKLIMITER_TARGET(isa) __attribute__((target(isa)))
+#else
+#define PEAKLIMITER_TARGET(isa)
+#endif
+
+/* ITU-R BS.1770-4 Annex 2 interpolation filter, one row per phase */
+static const float truePeakCoefs[PEAKLIMITER_TRUEPEAK_PHASES][PEAKLIMITER_TRUEPEAK_TAPS] = {
+  {  0.0017089843750f,  0.0109863281250f, -0.0196533203125f,  0.0332031250000f,
+    -0.0594482421875f,  0.1373291015625f,  0.9721679687500f, -0.1022949218750f,
+     0.0476074218750f, -0.0266113281250f,  0.0148925781250f, -0.0083007812500f },
+  { -0.0291748046875f,  0.0292968750000f, -0.0517578125000f,  0.0891113281250f,
+    -0.1665039062500f,  0.4650878906250f,  0.7797851562500f, -0.2003173828125f,
+     0.1015625000000f, -0.0582275390625f,  0.0330810546875f, -0.0189208984375f },
+  { -0.0189208984375f,  0.0330810546875f, -0.0582275390625f,  0.1015625000000f,
+    -0.2003173828125f,  0.7797851562500f,  0.4650878906250f, -0.1665039062500f,
+     0.0891113281250f, -0.0517578125000f,  0.0292968750000f, -0.0291748046875f },
+  { -0.0083007812500f,  0.0148925781250f, -0.0266113281250f,  0.0476074218750f,
+    -0.1022949218750f,  0.9721679687500f,  0.1373291015625f, -0.0594482421875f,
+     0.0332031250000f, -0.0196533203125f,  0.0109863281250f,  0.0017089843750f }
+};
+
+/******************************************************************************
+* scalar reference kernels                                                    *
+* the SIMD kernels below perform the same operations in the same order        *
+* (no fused multiply-add), so all instruction sets give the same results      *
+******************************************************************************/
+
+static float maxAbs_scalar(const float* frame, int nChannels, float init)
+{
+  int j;
+  float maximum = init, tmp;
+
+  for (j = 0; j < nChannels; j++) {
+    tmp = (float)fabs(frame[j]);
+    maximum = (maximum > tmp) ? maximum : tmp;
+  }
+  return maximum;
+}
+
+static void maxAbsPlanar_scalar(const float* const* samples, int nChannels,
+                                int offset, int nSamples, float init, float* peak)
+{
+  int i, j;
+  float tmp;
+
+  for (i = 0; i < nSamples; i++)
+    peak[i] = init;
+
+  for (j = 0; j < nChannels; j++) {
+    const float* x = samples[j] + offset;
+    for (i = 0; i < nSamples; i++) {
+      tmp = (float)fabs(x[i]);
+      peak[i] = (peak[i] > tmp) ? peak[i] : tmp;
+    }
+  }
+}
+
+static void applyGain_scalar(const float* in, float* out, float* delay, int nChannels,
+                             float gain, float threshold)
+{
+  int j;
+  float tmp;
+
+  for (j = 0; j < nChannels; j++) {
+    tmp = delay[j];
+    delay[j] = in[j];
+
+    tmp *= gain;
+    if (tmp > threshold) tmp = threshold;
+    if (tmp < -threshold) tmp = -threshold;
+
+    out[j] = tmp;
+  }
+}
+
+static void truePeak_scalar(const float* x, int nSamples, float* peak)
+{
+  int i, k, t;
+  float acc, maximum;
+
+  for (i = 0; i < nSamples; i++) {
+    maximum = peak[i];
+    for (k = 0; k < PEAKLIMITER_TRUEPEAK_PHASES; k++) {
+      acc = 0.0f;
+      for (t = 0; t < PEAKLIMITER_TRUEPEAK_TAPS; t++)
+        acc = acc + truePeakCoefs[k][t] * x[i - t];
+      acc = (float)fabs(acc);
+      maximum = (maximum > acc) ? maximum : acc;
+    }
+    peak[i] = maximum;
+  }
+}
+
+static void laneMax_scalar(const float* a, const float* b, float* y, int nLanes)
+{
+  int s;
+
+  for (s = 0; s < nLanes; s++)
+    y[s] = (a[s] > b[s]) ? a[s] : b[s];
+}
+
+static void laneGain_scalar(const float* maximum, float* fadedGain, float* smoothState,
+                            float* gain, int nLanes,
+                            float threshold, float attackConst, float releaseConst)
+{
+  int s;
+  float g, t, faded, smooth;
+
+  for (s = 0; s < nLanes; s++) {
+    g = (maximum[s] > threshold) ? threshold / maximum[s] : 1.0f;
+    smooth = smoothState[s];
+    faded = fadedGain[s];
+
+    if (g < smooth) {
+      t = (g - 0.1f * smooth) * 1.11111111f;
+      faded = (faded < t) ? faded : t;
+    }
+    else
+      faded = g;
+
+    if (faded < smooth) {
+      smooth = attackConst * (smooth - faded) + faded;
+      smooth = (g > smooth) ? g : smooth;
+    }
+    else {
+      t = releaseConst * (smooth - faded) + faded;
+      smooth = (t == smooth) ? faded : t;
+    }
+
+    fadedGain[s] = faded;
+    smoothState[s] = smooth;
+    gain[s] = smooth;
+  }
+}
+
+static const PeakLimiterKernels kernels_scalar = {
+  PEAKLIMITER_ISA_SCALAR, "scalar",
+  maxAbs_scalar, maxAbsPlanar_scalar, applyGain_scalar, truePeak_scalar,
+  laneMax_scalar, laneGain_scalar
+};
+
+#ifdef PEAKLIMITER_HAVE_X86
+
+/******************************************************************************
+* SSE2 kernels                                                                *
+* _mm_max_ps(a, b) and _mm_min_ps(a, b) return b when the comparison fails,   *
+* which gives exactly the same results as the scalar code above.              *
+******************************************************************************/
+
+static inline float hmax_sse2(__m128 v)
+{
+  v = _mm_max_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 0, 3, 2)));
+  v = _mm_max_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1)));
+  return _mm_cvtss_f32(v);
+}
+
+static float maxAbs_sse2(const float* frame, int nChannels, float init)
+{
+  const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+  __m128 maximum = _mm_set1_ps(init);
+  int j = 0;
+
+  for (; j + 4 <= nChannels; j += 4)
+    maximum = _mm_max_ps(maximum, _mm_and_ps(_mm_loadu_ps(frame + j), absMask));
+
+  return maxAbs_scalar(frame + j, nChannels - j, hmax_sse2(maximum));
+}
+
+static void maxAbsPlanar_sse2(const float* const* samples, int nChannels,
+                              int offset, int nSamples, float init, float* peak)
+{
+  const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+  const __m128 vinit = _mm_set1_ps(init);
+  int i, j;
+  float tmp;
+
+  for (i = 0; i + 4 <= nSamples; i += 4)
+    _mm_storeu_ps(peak + i, vinit);
+  for (; i < nSamples; i++)
+    peak[i] = init;
+
+  for (j = 0; j < nChannels; j++) {
+    const float* x = samples[j] + offset;
+    for (i = 0; i + 4 <= nSamples; i += 4)
+      _mm_storeu_ps(peak + i, _mm_max_ps(_mm_loadu_ps(peak + i),
+                                         _mm_and_ps(_mm_loadu_ps(x + i), absMask)));
+    for (; i < nSamples; i++) {
+      tmp = (float)fabs(x[i]);
+      peak[i] = (peak[i] > tmp) ? peak[i] : tmp;
+    }
+  }
+}
+
+static void applyGain_sse2(const float* in, float* out, float* delay, int nChannels,
+                           float gain, float threshold)
+{
+  const __m128 vgain = _mm_set1_ps(gain);
+  const __m128 vthr = _mm_set1_ps(threshold);
+  const __m128 vnthr = _mm_set1_ps(-threshold);
+  __m128 tmp;
+  int j = 0;
+
+  for (; j + 4 <= nChannels; j += 4) {
+    tmp = _mm_mul_ps(_mm_loadu_ps(delay + j), vgain);
+    _mm_storeu_ps(delay + j, _mm_loadu_ps(in + j));
+    tmp = _mm_min_ps(vthr, tmp);
+    tmp = _mm_max_ps(vnthr, tmp);
+    _mm_storeu_ps(out + j, tmp);
+  }
+  applyGain_scalar(in + j, out + j, delay + j, nChannels - j, gain, threshold);
+}
+
+static void truePeak_sse2(const float* x, int nSamples, float* peak)
+{
+  const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+  __m128 acc, maximum;
+  int i = 0, k, t;
+
+  for (; i + 4 <= nSamples; i += 4) {
+    maximum = _mm_loadu_ps(peak + i);
+    for (k = 0; k < PEAKLIMITER_TRUEPEAK_PHASES; k++) {
+      acc = _mm_setzero_ps();
+      for (t = 0; t < PEAKLIMITER_TRUEPEAK_TAPS; t++)
+        acc = _mm_add_ps(acc, _mm_mul_ps(_mm_set1_ps(truePeakCoefs[k][t]), _mm_loadu_ps(x + i - t)));
+      maximum = _mm_max_ps(maximum, _mm_and_ps(acc, absMask));
+    }
+    _mm_storeu_ps(peak + i, maximum);
+  }
+  truePeak_scalar(x + i, nSamples - i, peak + i);
+}
+
+static void laneMax_sse2(const float* a, const float* b, float* y, int nLanes)
+{
+  int s = 0;
+
+  for (; s + 4 <= nLanes; s += 4)
+    _mm_storeu_ps(y + s, _mm_max_ps(_mm_loadu_ps(a + s), _mm_loadu_ps(b + s)));
+  laneMax_scalar(a + s, b + s, y + s, nLanes - s);
+}
+
+/* both branches of the scalar code are computed and blended, the division of
+   the lanes below the threshold is thrown away */
+static void laneGain_sse2(const float* maximum, float* fadedGain, float* smoothState,
+                          float* gain, int nLanes,
+                          float threshold, float attackConst, float releaseConst)
+{
+  const __m128 vthr = _mm_set1_ps(threshold);
+  const __m128 vone = _mm_set1_ps(1.0f);
+  const __m128 vtenth = _mm_set1_ps(0.1f);
+  const __m128 vfade = _mm_set1_ps(1.11111111f);
+  const __m128 vatt = _mm_set1_ps(attackConst);
+  const __m128 vrel = _mm_set1_ps(releaseConst);
+  __m128 m, g, faded, smooth, t, mask, att, rel;
+  int s = 0;
+
+  for (; s + 4 <= nLanes; s += 4) {
+    m = _mm_loadu_ps(maximum + s);
+    mask = _mm_cmpgt_ps(m, vthr);
+    g = _mm_or_ps(_mm_and_ps(mask, _mm_div_ps(vthr, m)), _mm_andnot_ps(mask, vone));
+    smooth = _mm_loadu_ps(smoothState + s);
+    faded = _mm_loadu_ps(fadedGain + s);
+
+    t = _mm_mul_ps(_mm_sub_ps(g, _mm_mul_ps(vtenth, smooth)), vfade);
+    mask = _mm_cmplt_ps(g, smooth);
+    faded = _mm_or_ps(_mm_and_ps(mask, _mm_min_ps(faded, t)), _mm_andnot_ps(mask, g));
+
+    att = _mm_add_ps(_mm_mul_ps(vatt, _mm_sub_ps(smooth, faded)), faded);
+    att = _mm_max_ps(g, att);
+    rel = _mm_add_ps(_mm_mul_ps(vrel, _mm_sub_ps(smooth, faded)), faded);
+    mask = _mm_cmpeq_ps(rel, smooth);
+    rel = _mm_or_ps(_mm_and_ps(mask, faded), _mm_andnot_ps(mask, rel));
+    mask = _mm_cmplt_ps(faded, smooth);
+    smooth = _mm_or_ps(_mm_and_ps(mask, att), _mm_andnot_ps(mask, rel));
+
+    _mm_storeu_ps(fadedGain + s, faded);
+    _mm_storeu_ps(smoothState + s, smooth);
+    _mm_storeu_ps(gain + s, smooth);
+  }
+  laneGain_scalar(maximum + s, fadedGain + s, smoothState + s, gain + s, nLanes - s,
+                  threshold, attackConst, releaseConst);
+}
+
+static const PeakLimiterKernels kernels_sse2 = {
+  PEAKLIMITER_ISA_SSE2, "sse2",
+  maxAbs_sse2, maxAbsPlanar_sse2, applyGain_sse2, truePeak_sse2,
+  laneMax_sse2, laneGain_sse2
+};
+
+/******************************************************************************
+* AVX2 kernels                                                                *
+******************************************************************************/
+
+PEAKLIMITER_TARGET("avx2")
+static float maxAbs_avx2(const float* frame, int nChannels, float init)
+{
+  const __m256 absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+  __m256 maximum = _mm256_set1_ps(init);
+  __m128 half;
+  int j = 0;
+
+  for (; j + 8 <= nChannels; j += 8)
+    maximum = _mm256_max_ps(maximum, _mm256_and_ps(_mm256_loadu_ps(frame + j), absMask));
+
+  half = _mm_max_ps(_mm256_castps256_ps128(maximum), _mm256_extractf128_ps(maximum, 1));
+  if (j + 4 <= nChannels) {
+    half = _mm_max_ps(half, _mm_and_ps(_mm_loadu_ps(frame + j), _mm256_castps256_ps128(absMask)));
+    j += 4;
+  }
+  return maxAbs_scalar(frame + j, nChannels - j, hmax_sse2(half));
+}
+
+PEAKLIMITER_TARGET("avx2")
+static void maxAbsPlanar_avx2(const float* const* samples, int nChannels,
+                              int offset, int nSamples, float init, float* peak)
+{
+  const __m256 absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+  const __m256 vinit = _mm256_set1_ps(init);
+  int i, j;
+  float tmp;
+
+  for (i = 0; i + 8 <= nSamples; i += 8)
+    _mm256_storeu_ps(peak + i, vinit);
+  for (; i < nSamples; i++)
+    peak[i] = init;
+
+  for (j = 0; j < nChannels; j++) {
+    const float* x = samples[j] + offset;
+    for (i = 0; i + 8 <= nSamples; i += 8)
+      _mm256_storeu_ps(peak + i, _mm256_max_ps(_mm256_loadu_ps(peak + i),
+                                               _mm256_and_ps(_mm256_loadu_ps(x + i), absMask)));
+    for (; i < nSamples; i++) {
+      tmp = (float)fabs(x[i]);
+      peak[i] = (peak[i] > tmp) ? peak[i] : tmp;
+    }
+  }
+}
+
+PEAKLIMITER_TARGET("avx2")
+static void applyGain_avx2(const float* in, float* out, float* delay, int nChannels,
+                           float gain, float threshold)
+{
+  const __m256 vgain = _mm256_set1_ps(gain);
+  const __m256 vthr = _mm256_set1_ps(threshold);
+  const __m256 vnthr = _mm256_set1_ps(-threshold);
+  __m256 tmp;
+  int j = 0;
+
+  for (; j + 8 <= nChannels; j += 8) {
+    tmp = _mm256_mul_ps(_mm256_loadu_ps(delay + j), vgain);
+    _mm256_storeu_ps(delay + j, _mm256_loadu_ps(in + j));
+    tmp = _mm256_min_ps(vthr, tmp);
+    tmp = _mm256_max_ps(vnthr, tmp);
+    _mm256_storeu_ps(out + j, tmp);
+  }
+  applyGain_sse2(in + j, out + j, delay + j, nChannels - j, gain, threshold);
+}
+
+PEAKLIMITER_TARGET("avx2")
+static void truePeak_avx2(const float* x, int nSamples, float* peak)
+{
+  const __m256 absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+  __m256 acc, maximum;
+  int i = 0, k, t;
+
+  for (; i + 8 <= nSamples; i += 8) {
+    maximum = _mm256_loadu_ps(peak + i);
+    for (k = 0; k < PEAKLIMITER_TRUEPEAK_PHASES; k++) {
+      acc = _mm256_setzero_ps();
+      for (t = 0; t < PEAKLIMITER_TRUEPEAK_TAPS; t++)
+        acc = _mm256_add_ps(acc, _mm256_mul_ps(_mm256_set1_ps(truePeakCoefs[k][t]), _mm256_loadu_ps(x + i - t)));
+      maximum = _mm256_max_ps(maximum, _mm256_and_ps(acc, absMask));
+    }
+    _mm256_storeu_ps(peak + i, maximum);
+  }
+  truePeak_sse2(x + i, nSamples - i, peak + i);
+}
+
+PEAKLIMITER_TARGET("avx2")
+static void laneMax_avx2(const float* a, const float* b, float* y, int nLanes)
+{
+  int s = 0;
+
+  for (; s + 8 <= nLanes; s += 8)
+    _mm256_storeu_ps(y + s, _mm256_max_ps(_mm256_loadu_ps(a + s), _mm256_loadu_ps(b + s)));
+  laneMax_sse2(a + s, b + s, y + s, nLanes - s);
+}
+
+PEAKLIMITER_TARGET("avx2")
+static void laneGain_avx2(const float* maximum, float* fadedGain, float* smoothState,
+                          float* gain, int nLanes,
+                          float threshold, float attackConst, float releaseConst)
+{
+  const __m256 vthr = _mm256_set1_ps(threshold);
+  const __m256 vone = _mm256_set1_ps(1.0f);
+  const __m256 vtenth = _mm256_set1_ps(0.1f);
+  const __m256 vfade = _mm256_set1_ps(1.11111111f);
+  const __m256 vatt = _mm256_set1_ps(attackConst);
+  const __m256 vrel = _mm256_set1_ps(releaseConst);
+  __m256 m, g, faded, smooth, t, att, rel;
+  int s = 0;
+
+  for (; s + 8 <= nLanes; s += 8) {
+    m = _mm256_loadu_ps(maximum + s);
+    g = _mm256_blendv_ps(vone, _mm256_div_ps(vthr, m), _mm256_cmp_ps(m, vthr, _CMP_GT_OQ));
+    smooth = _mm256_loadu_ps(smoothState + s);
+    faded = _mm256_loadu_ps(fadedGain + s);
+
+    t = _mm256_mul_ps(_mm256_sub_ps(g, _mm256_mul_ps(vtenth, smooth)), vfade);
+    faded = _mm256_blendv_ps(g, _mm256_min_ps(faded, t), _mm256_cmp_ps(g, smooth, _CMP_LT_OQ));
+
+    att = _mm256_add_ps(_mm256_mul_ps(vatt, _mm256_sub_ps(smooth, faded)), faded);
+    att = _mm256_max_ps(g, att);
+    rel = _mm256_add_ps(_mm256_mul_ps(vrel, _mm256_sub_ps(smooth, faded)), faded);
+    rel = _mm256_blendv_ps(rel, faded, _mm256_cmp_ps(rel, smooth, _CMP_EQ_OQ));
+    smooth = _mm256_blendv_ps(rel, att, _mm256_cmp_ps(faded, smooth, _CMP_LT_OQ));
+
+    _mm256_storeu_ps(fadedGain + s, faded);
+    _mm256_storeu_ps(smoothState + s, smooth);
+    _mm256_storeu_ps(gain + s, smooth);
+  }
+  laneGain_sse2(maximum + s, fadedGain + s, smoothState + s, gain + s, nLanes - s,
+                threshold, attackConst, releaseConst);
+}
+
+static const PeakLimiterKernels kernels_avx2 = {
+  PEAKLIMITER_ISA_AVX2, "avx2",
+  maxAbs_avx2, maxAbsPlanar_avx2, applyGain_avx2, truePeak_avx2,
+  laneMax_avx2, laneGain_avx2
+};
+
+/******************************************************************************
+* AVX-512 kernels                                                             *
+* the channel remainder is handled with masked loads and stores, so any       *
+* frame of up to 16 channels is a single vector operation                     *
+******************************************************************************/
+
+PEAKLIMITER_TARGET("avx512f")
+static float maxAbs_avx512(const float* frame, int nChannels, float init)
+{
+  const __m512i absMask = _mm512_set1_epi32(0x7fffffff);
+  __m512 maximum = _mm512_set1_ps(init);
+  __mmask16 k;
+  int j = 0;
+
+  for (; j + 16 <= nChannels; j += 16)
+    maximum = _mm512_max_ps(maximum, _mm512_castsi512_ps(
+                _mm512_and_epi32(_mm512_castps_si512(_mm512_loadu_ps(frame + j)), absMask)));
+  if (j < nChannels) {
+    k = (__mmask16)((1u << (nChannels - j)) - 1);
+    maximum = _mm512_mask_max_ps(maximum, k, maximum, _mm512_castsi512_ps(
+                _mm512_and_epi32(_mm512_castps_si512(_mm512_maskz_loadu_ps(k, frame + j)), absMask)));
+  }
+  return _mm512_reduce_max_ps(maximum);
+}
+
+PEAKLIMITER_TARGET("avx512f")
+static void maxAbsPlanar_avx512(const float* const* samples, int nChannels,
+                                int offset, int nSamples, float init, float* peak)
+{
+  const __m512i absMask = _mm512_set1_epi32(0x7fffffff);
+  const __m512 vinit = _mm512_set1_ps(init);
+  __m512 maximum;
+  __mmask16 k;
+  int i, j;
+
+  for (i = 0; i < nSamples; i += 16) {
+    k = (nSamples - i >= 16) ? (__mmask16)0xffff : (__mmask16)((1u << (nSamples - i)) - 1);
+    _mm512_mask_storeu_ps(peak + i, k, vinit);
+  }
+
+  for (j = 0; j < nChannels; j++) {
+    const float* x = samples[j] + offset;
+    for (i = 0; i < nSamples; i += 16) {
+      k = (nSamples - i >= 16) ? (__mmask16)0xffff : (__mmask16)((1u << (nSamples - i)) - 1);
+      maximum = _mm512_maskz_loadu_ps(k, peak + i);
+      maximum = _mm512_mask_max_ps(maximum, k, maximum, _mm512_castsi512_ps(
+                  _mm512_and_epi32(_mm512_castps_si512(_mm512_maskz_loadu_ps(k, x + i)), absMask)));
+      _mm512_mask_storeu_ps(peak + i, k, maximum);
+    }
+  }
+}
+
+PEAKLIMITER_TARGET("avx512f")
+static void applyGain_avx512(const float* in, float* out, float* delay, int nChannels,
+                             float gain, float threshold)
+{
+  const __m512 vgain = _mm512_set1_ps(gain);
+  const __m512 vthr = _mm512_set1_ps(threshold);
+  const __m512 vnthr = _mm512_set1_ps(-threshold);
+  __m512 tmp;
+  __mmask16 k;
+  int j;
+
+  for (j = 0; j < nChannels; j += 16) {
+    k = (nChannels - j >= 16) ? (__mmask16)0xffff : (__mmask16)((1u << (nChannels - j)) - 1);
+    tmp = _mm512_mul_ps(_mm512_maskz_loadu_ps(k, delay + j), vgain);
+    _mm512_mask_storeu_ps(delay + j, k, _mm512_maskz_loadu_ps(k, in + j));
+    tmp = _mm512_min_ps(vthr, tmp);
+    tmp = _mm512_max_ps(vnthr, tmp);
+    _mm512_mask_storeu_ps(out + j, k, tmp);
+  }
+}
+
+PEAKLIMITER_TARGET("avx512f")
+static void truePeak_avx512(const float* x, int nSamples, float* peak)
+{
+  const __m512i absMask = _mm512_set1_epi32(0x7fffffff);
+  __m512 acc, maximum;
+  __mmask16 m;
+  int i, k, t;
+
+  for (i = 0; i < nSamples; i += 16) {
+    m = (nSamples - i >= 16) ? (__mmask16)0xffff : (__mmask16)((1u << (nSamples - i)) - 1);
+    maximum = _mm512_maskz_loadu_ps(m, peak + i);
+    for (k = 0; k < PEAKLIMITER_TRUEPEAK_PHASES; k++) {
+      acc = _mm512_setzero_ps();
+      for (t = 0; t < PEAKLIMITER_TRUEPEAK_TAPS; t++)
+        acc = _mm512_add_ps(acc, _mm512_mul_ps(_mm512_set1_ps(truePeakCoefs[k][t]), _mm512_maskz_loadu_ps(m, x + i - t)));
+      maximum = _mm512_mask_max_ps(maximum, m, maximum,
+                                   _mm512_castsi512_ps(_mm512_and_epi32(_mm512_castps_si512(acc), absMask)));
+    }
+    _mm512_mask_storeu_ps(peak + i, m, maximum);
+  }
+}
+
+PEAKLIMITER_TARGET("avx512f")
+static void laneMax_avx512(const float* a, const float* b, float* y, int nLanes)
+{
+  __mmask16 k;
+  int s;
+
+  for (s = 0; s < nLanes; s += 16) {
+    k = (nLanes - s >= 16) ? (__mmask16)0xffff : (__mmask16)((1u << (nLanes - s)) - 1);
+    _mm512_mask_storeu_ps(y + s, k, _mm512_max_ps(_mm512_maskz_loadu_ps(k, a + s), _mm512_maskz_loadu_ps(k, b + s)));
+  }
+}
+
+PEAKLIMITER_TARGET("avx512f")
+static void laneGain_avx512(const float* maximum, float* fadedGain, float* smoothState,
+                            float* gain, int nLanes,
+                            float threshold, float attackConst, float releaseConst)
+{
+  const __m512 vthr = _mm512_set1_ps(threshold);
+  const __m512 vone = _mm512_set1_ps(1.0f);
+  const __m512 vtenth = _mm512_set1_ps(0.1f);
+  const __m512 vfade = _mm512_set1_ps(1.11111111f);
+  const __m512 vatt = _mm512_set1_ps(attackConst);
+  const __m512 vrel = _mm512_set1_ps(releaseConst);
+  __m512 m, g, faded, smooth, t, att, rel;
+  __mmask16 k;
+  int s;
+
+  for (s = 0; s < nLanes; s += 16) {
+    k = (nLanes - s >= 16) ? (__mmask16)0xffff : (__mmask16)((1u << (nLanes - s)) - 1);
+    m = _mm512_maskz_loadu_ps(k, maximum + s);
+    g = _mm512_mask_div_ps(vone, _mm512_cmp_ps_mask(m, vthr, _CMP_GT_OQ), vthr, m);
+    smooth = _mm512_maskz_loadu_ps(k, smoothState + s);
+    faded = _mm512_maskz_loadu_ps(k, fadedGain + s);
+
+    t = _mm512_mul_ps(_mm512_sub_ps(g, _mm512_mul_ps(vtenth, smooth)), vfade);
+    faded = _mm512_mask_min_ps(g, _mm512_cmp_ps_mask(g, smooth, _CMP_LT_OQ), faded, t);
+
+    att = _mm512_add_ps(_mm512_mul_ps(vatt, _mm512_sub_ps(smooth, faded)), faded);
+    att = _mm512_max_ps(g, att);
+    rel = _mm512_add_ps(_mm512_mul_ps(vrel, _mm512_sub_ps(smooth, faded)), faded);
+    rel = _mm512_mask_blend_ps(_mm512_cmp_ps_mask(rel, smooth, _CMP_EQ_OQ), rel, faded);
+    smooth = _mm512_mask_blend_ps(_mm512_cmp_ps_mask(faded, smooth, _CMP_LT_OQ), rel, att);
+
+    _mm512_mask_storeu_ps(fadedGain + s, k, faded);
+    _mm512_mask_storeu_ps(smoothState + s, k, smooth);
+    _mm512_mask_storeu_ps(gain + s, k, smooth);
+  }
+}
+
+static const PeakLimiterKernels kernels_avx512 = {
+  PEAKLIMITER_ISA_AVX512, "avx512",
+  maxAbs_avx512, maxAbsPlanar_avx512, applyGain_avx512, truePeak_avx512,
+  laneMax_avx512, laneGain_avx512
+};
+
+static int cpuSupports(int isa)
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+  int info[4];
+  unsigned long long xcr0;
+
+  __cpuid(info, 0);
+  if (info[0] < 7) return 0;
+  __cpuid(info, 1);
+  if (!(info[2] & (1 << 27))) return 0; /* no OSXSAVE */
+  xcr0 = _xgetbv(0);
+  __cpuidex(info, 7, 0);
+  if (isa == PEAKLIMITER_ISA_AVX2)
+    return ((xcr0 & 0x06) == 0x06) && (info[1] & (1 << 5));
+  if (isa == PEAKLIMITER_ISA_AVX512)
+    return ((xcr0 & 0xe6) == 0xe6) && (info[1] & (1 << 16));
+  return 0;
+#else
+  __builtin_cpu_init();
+  if (isa == PEAKLIMITER_ISA_AVX2)
+    return __builtin_cpu_supports("avx2");
+  if (isa == PEAKLIMITER_ISA_AVX512)
+    return __builtin_cpu_supports("avx512f");
+  return 0;
+#endif
+}
+
+#endif /* PEAKLIMITER_HAVE_X86 */
+
+#ifdef PEAKLIMITER_HAVE_NEON
+
+/******************************************************************************
+* NEON kernels                                                                *
+******************************************************************************/
+
+static inline float hmax_neon(float32x4_t v)
+{
+  float32x2_t tmp = vpmax_f32(vget_low_f32(v), vget_high_f32(v));
+  tmp = vpmax_f32(tmp, tmp);
+  return vget_lane_f32(tmp, 0);
+}
+
+static float maxAbs_neon(const float* frame, int nChannels, float init)
+{
+  float32x4_t maximum = vdupq_n_f32(init);
+  int j = 0;
+
+  for (; j + 4 <= nChannels; j += 4)
+    maximum = vmaxq_f32(maximum, vabsq_f32(vld1q_f32(frame + j)));
+
+  return maxAbs_scalar(frame + j, nChannels - j, hmax_neon(maximum));
+}
+
+static void maxAbsPlanar_neon(const float* const* samples, int nChannels,
+                              int offset, int nSamples, float init, float* peak)
+{
+  const float32x4_t vinit = vdupq_n_f32(init);
+  int i, j;
+  float tmp;
+
+  for (i = 0; i + 4 <= nSamples; i += 4)
+    vst1q_f32(peak + i, vinit);
+  for (; i < nSamples; i++)
+    peak[i] = init;
+
+  for (j = 0; j < nChannels; j++) {
+    const float* x = samples[j] + offset;
+    for (i = 0; i + 4 <= nSamples; i += 4)
+      vst1q_f32(peak + i, vmaxq_f32(vld1q_f32(peak + i), vabsq_f32(vld1q_f32(x + i))));
+    for (; i < nSamples; i++) {
+      tmp = (float)fabs(x[i]);
+      peak[i] = (peak[i] > tmp) ? peak[i] : tmp;
+    }
+  }
+}
+
+static void applyGain_neon(const float* in, float* out, float* delay, int nChannels,
+                           float gain, float threshold)
+{
+  const float32x4_t vthr = vdupq_n_f32(threshold);
+  const float32x4_t vnthr = vdupq_n_f32(-threshold);
+  float32x4_t tmp;
+  int j = 0;
+
+  for (; j + 4 <= nChannels; j += 4) {
+    tmp = vmulq_n_f32(vld1q_f32(delay + j), gain);
+    vst1q_f32(delay + j, vld1q_f32(in + j));
+    tmp = vminq_f32(tmp, vthr);
+    tmp = vmaxq_f32(tmp, vnthr);
+    vst1q_f32(out + j, tmp);
+  }
+  applyGain_scalar(in + j, out + j, delay + j, nChannels - j, gain, threshold);
+}
+
+static void truePeak_neon(const float* x, int nSamples, float* peak)
+{
+  float32x4_t acc, maximum;
+  int i = 0, k, t;
+
+  for (; i + 4 <= nSamples; i += 4) {
+    maximum = vld1q_f32(peak + i);
+    for (k = 0; k < PEAKLIMITER_TRUEPEAK_PHASES; k++) {
+      acc = vdupq_n_f32(0.0f);
+      for (t = 0; t < PEAKLIMITER_TRUEPEAK_TAPS; t++)
+        acc = vaddq_f32(acc, vmulq_n_f32(vld1q_f32(x + i - t), truePeakCoefs[k][t]));
+      maximum = vmaxq_f32(maximum, vabsq_f32(acc));
+    }
+    vst1q_f32(peak + i, maximum);
+  }
+  truePeak_scalar(x + i, nSamples - i, peak + i);
+}
+
+static void laneMax_neon(const float* a, const float* b, float* y, int nLanes)
+{
+  int s = 0;
+
+  for (; s + 4 <= nLanes; s += 4)
+    vst1q_f32(y + s, vmaxq_f32(vld1q_f32(a + s), vld1q_f32(b + s)));
+  laneMax_scalar(a + s, b + s, y + s, nLanes - s);
+}
+
+/* ARMv7 NEON has no exact division, the scalar code is used there */
+#if defined(__aarch64__) || defined(_M_ARM64)
+static void laneGain_neon(const float* maximum, float* fadedGain, float* smoothState,
+                          float* gain, int nLanes,
+                          float threshold, float attackConst, float releaseConst)
+{
+  const float32x4_t vthr = vdupq_n_f32(threshold);
+  const float32x4_t vone = vdupq_n_f32(1.0f);
+  float32x4_t m, g, faded, smooth, t, att, rel;
+  int s = 0;
+
+  for (; s + 4 <= nLanes; s += 4) {
+    m = vld1q_f32(maximum + s);
+    g = vbslq_f32(vcgtq_f32(m, vthr), vdivq_f32(vthr, m), vone);
+    smooth = vld1q_f32(smoothState + s);
+    faded = vld1q_f32(fadedGain + s);
+
+    t = vmulq_n_f32(vsubq_f32(g, vmulq_n_f32(smooth, 0.1f)), 1.11111111f);
+    faded = vbslq_f32(vcltq_f32(g, smooth), vminq_f32(faded, t), g);
+
+    att = vaddq_f32(vmulq_n_f32(vsubq_f32(smooth, faded), attackConst), faded);
+    att = vmaxq_f32(g, att);
+    rel = vaddq_f32(vmulq_n_f32(vsubq_f32(smooth, faded), releaseConst), faded);
+    rel = vbslq_f32(vceqq_f32(rel, smooth), faded, rel);
+    smooth = vbslq_f32(vcltq_f32(faded, smooth), att, rel);
+
+    vst1q_f32(fadedGain + s, faded);
+    vst1q_f32(smoothState + s, smooth);
+    vst1q_f32(gain + s, smooth);
+  }
+  laneGain_scalar(maximum + s, fadedGain + s, smoothState + s, gain + s, nLanes - s,
+                  threshold, attackConst, releaseConst);
+}
+#else
+#define laneGain_neon laneGain_scalar
+#endif
+
+static const PeakLimiterKernels kernels_neon = {
+  PEAKLIMITER_ISA_NEON, "neon",
+  maxAbs_neon, maxAbsPlanar_neon, applyGain_neon, truePeak_neon,
+  laneMax_neon, laneGain_neon
+};
+
+#endif /* PEAKLIMITER_HAVE_NEON */
+
+#ifdef PEAKLIMITER_HAVE_WASM
+
+/******************************************************************************
+* WebAssembly SIMD kernels (emcc -msimd128)                                   *
+* wasm_f32x4_pmax(b, a) and wasm_f32x4_pmin(b, a) are _mm_max_ps(a, b) and    *
+* _mm_min_ps(a, b), so these are the SSE2 kernels with the same results.      *
+******************************************************************************/
+
+static inline float hmax_wasm(v128_t v)
+{
+  v = wasm_f32x4_pmax(wasm_i32x4_shuffle(v, v, 2, 3, 0, 1), v);
+  v = wasm_f32x4_pmax(wasm_i32x4_shuffle(v, v, 1, 0, 3, 2), v);
+  return wasm_f32x4_extract_lane(v, 0);
+}
+
+static float maxAbs_wasm(const float* frame, int nChannels, float init)
+{
+  v128_t maximum = wasm_f32x4_splat(init);
+  int j = 0;
+
+  for (; j + 4 <= nChannels; j += 4)
+    maximum = wasm_f32x4_pmax(wasm_f32x4_abs(wasm_v128_load(frame + j)), maximum);
+
+  return maxAbs_scalar(frame + j, nChannels - j, hmax_wasm(maximum));
+}
+
+static void maxAbsPlanar_wasm(const float* const* samples, int nChannels,
+                              int offset, int nSamples, float init, float* peak)
+{
+  const v128_t vinit = wasm_f32x4_splat(init);
+  int i, j;
+  float tmp;
+
+  for (i = 0; i + 4 <= nSamples; i += 4)
+    wasm_v128_store(peak + i, vinit);
+  for (; i < nSamples; i++)
+    peak[i] = init;
+
+  for (j = 0; j < nChannels; j++) {
+    const float* x = samples[j] + offset;
+    for (i = 0; i + 4 <= nSamples; i += 4)
+      wasm_v128_store(peak + i, wasm_f32x4_pmax(wasm_f32x4_abs(wasm_v128_load(x + i)),
+                                                wasm_v128_load(peak + i)));
+    for (; i < nSamples; i++) {
+      tmp = (float)fabs(x[i]);
+      peak[i] = (peak[i] > tmp) ? peak[i] : tmp;
+    }
+  }
+}
+
+static void applyGain_wasm(const float* in, float* out, float* delay, int nChannels,
+                           float gain, float threshold)
+{
+  const v128_t vgain = wasm_f32x4_splat(gain);
+  const v128_t vthr = wasm_f32x4_splat(threshold);
+  const v128_t vnthr = wasm_f32x4_splat(-threshold);
+  v128_t tmp;
+  int j = 0;
+
+  for (; j + 4 <= nChannels; j += 4) {
+    tmp = wasm_f32x4_mul(wasm_v128_load(delay + j), vgain);
+    wasm_v128_store(delay + j, wasm_v128_load(in + j));
+    tmp = wasm_f32x4_pmin(tmp, vthr);
+    tmp = wasm_f32x4_pmax(tmp, vnthr);
+    wasm_v128_store(out + j, tmp);
+  }
+  applyGain_scalar(in + j, out + j, delay + j, nChannels - j, gain, threshold);
+}
+
+static void truePeak_wasm(const float* x, int nSamples, float* peak)
+{
+  v128_t acc, maximum;
+  int i = 0, k, t;
+
+  for (; i + 4 <= nSamples; i += 4) {
+    maximum = wasm_v128_load(peak + i);
+    for (k = 0; k < PEAKLIMITER_TRUEPEAK_PHASES; k++) {
+      acc = wasm_f32x4_splat(0.0f);
+      for (t = 0; t < PEAKLIMITER_TRUEPEAK_TAPS; t++)
+        acc = wasm_f32x4_add(acc, wasm_f32x4_mul(wasm_f32x4_splat(truePeakCoefs[k][t]), wasm_v128_load(x + i - t)));
+      maximum = wasm_f32x4_pmax(wasm_f32x4_abs(acc), maximum);
+    }
+    wasm_v128_store(peak + i, maximum);
+  }
+  truePeak_scalar(x + i, nSamples - i, peak + i);
+}
+
+static void laneMax_wasm(const float* a, const float* b, float* y, int nLanes)
+{
+  int s = 0;
+
+  for (; s + 4 <= nLanes; s += 4)
+    wasm_v128_store(y + s, wasm_f32x4_pmax(wasm_v128_load(b + s), wasm_v128_load(a + s)));
+  laneMax_scalar(a + s, b + s, y + s, nLanes - s);
+}
+
+static void laneGain_wasm(const float* maximum, float* fadedGain, float* smoothState,
+                          float* gain, int nLanes,
+                          float threshold, float attackConst, float releaseConst)
+{
+  const v128_t vthr = wasm_f32x4_splat(threshold);
+  const v128_t vone = wasm_f32x4_splat(1.0f);
+  const v128_t vtenth = wasm_f32x4_splat(0.1f);
+  const v128_t vfade = wasm_f32x4_splat(1.11111111f);
+  const v128_t vatt = wasm_f32x4_splat(attackConst);
+  const v128_t vrel = wasm_f32x4_splat(releaseConst);
+  v128_t m, g, faded, smooth, t, att, rel;
+  int s = 0;
+
+  for (; s + 4 <= nLanes; s += 4) {
+    m = wasm_v128_load(maximum + s);
+    g = wasm_v128_bitselect(wasm_f32x4_div(vthr, m), vone, wasm_f32x4_gt(m, vthr));
+    smooth = wasm_v128_load(smoothState + s);
+    faded = wasm_v128_load(fadedGain + s);
+
+    t = wasm_f32x4_mul(wasm_f32x4_sub(g, wasm_f32x4_mul(vtenth, smooth)), vfade);
+    faded = wasm_v128_bitselect(wasm_f32x4_pmin(t, faded), g, wasm_f32x4_lt(g, smooth));
+
+    att = wasm_f32x4_add(wasm_f32x4_mul(vatt, wasm_f32x4_sub(smooth, faded)), faded);
+    att = wasm_f32x4_pmax(att, g);
+    rel = wasm_f32x4_add(wasm_f32x4_mul(vrel, wasm_f32x4_sub(smooth, faded)), faded);
+    rel = wasm_v128_bitselect(faded, rel, wasm_f32x4_eq(rel, smooth));
+    smooth = wasm_v128_bitselect(att, rel, wasm_f32x4_lt(faded, smooth));
+
+    wasm_v128_store(fadedGain + s, faded);
+    wasm_v128_store(smoothState + s, smooth);
+    wasm_v128_store(gain + s, smooth);
+  }
+  laneGain_scalar(maximum + s, fadedGain + s, smoothState + s, gain + s, nLanes - s,
+                  threshold, attackConst, releaseConst);
+}
+
+static const PeakLimiterKernels kernels_wasm = {
+  PEAKLIMITER_ISA_WASM, "wasm",
+  maxAbs_wasm, maxAbsPlanar_wasm, applyGain_wasm, truePeak_wasm,
+  laneMax_wasm, laneGain_wasm
+};
+
+#endif /* PEAKLIMITER_HAVE_WASM */
+
+/* select kernels */
+const PeakLimiterKernels* getPeakLimiterKernels(int isa)
+{
+#ifdef PEAKLIMITER_HAVE_X86
+  if ((isa == PEAKLIMITER_ISA_BEST) || (isa == PEAKLIMITER_ISA_AVX512))
+    if (cpuSupports(PEAKLIMITER_ISA_AVX512)) return &kernels_avx512;
+  if ((isa == PEAKLIMITER_ISA_BEST) || (isa == PEAKLIMITER_ISA_AVX2))
+    if (cpuSupports(PEAKLIMITER_ISA_AVX2)) return &kernels_avx2;
+  if ((isa == PEAKLIMITER_ISA_BEST) || (isa == PEAKLIMITER_ISA_SSE2))
+    return &kernels_sse2;
+#endif
+#ifdef PEAKLIMITER_HAVE_NEON
+  if ((isa == PEAKLIMITER_ISA_BEST) || (isa == PEAKLIMITER_ISA_NEON))
+    return &kernels_neon;
+#endif
+#ifdef PEAKLIMITER_HAVE_WASM
+  if ((isa == PEAKLIMITER_ISA_BEST) || (isa == PEAKLIMITER_ISA_WASM))
+    return &kernels_wasm;
+#endif
+  if ((isa == PEAKLIMITER_ISA_BEST) || (isa == PEAKLIMITER_ISA_SCALAR))
+    return &kernels_scalar;
+
+  return NULL;
+}
+
+uint64_t getPeakLimiterTicks()
+{
+#if defined(PEAKLIMITER_HAVE_X86)
+  return (uint64_t)__rdtsc();
+#elif defined(__aarch64__) && (defined(__GNUC__) || defined(__clang__))
+  uint64_t ticks;
+  __asm__ __volatile__("mrs %0, cntvct_el0" : "=r"(ticks));
+  return ticks;
+#else
+  return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+           std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+/* FTZ (bit 15) and DAZ (bit 6) of the MXCSR, FZ (bit 24) of the FPCR/FPSCR. The
+   control register is only written if the mode changes, hosts that already run
+   with flush to zero pay a read per call. Leaving restores the mode bits only,
+   the exception flags raised in between are kept */
+#define PEAKLIMITER_MXCSR_FLUSH   (0x8040)
+#define PEAKLIMITER_FPCR_FLUSH    (1 << 24)
+
+int enterPeakLimiterFlushDenormals(uint64_t* state)
+{
+#if defined(PEAKLIMITER_HAVE_X86)
+  const unsigned int csr = _mm_getcsr();
+
+  *state = csr;
+  if ((csr & PEAKLIMITER_MXCSR_FLUSH) != PEAKLIMITER_MXCSR_FLUSH)
+    _mm_setcsr(csr | PEAKLIMITER_MXCSR_FLUSH);
+  return 1;
+#elif defined(__aarch64__) && (defined(__GNUC__) || defined(__clang__))
+  uint64_t fpcr;
+
+  __asm__ __volatile__("mrs %0, fpcr" : "=r"(fpcr));
+  *state = fpcr;
+  if (!(fpcr & PEAKLIMITER_FPCR_FLUSH))
+    __asm__ __volatile__("msr fpcr, %0" : : "r"(fpcr | PEAKLIMITER_FPCR_FLUSH));
+  return 1;
+#elif defined(__arm__) && defined(__ARM_FP) && (defined(__GNUC__) || defined(__clang__))
+  uint32_t fpscr;
+
+  __asm__ __volatile__("vmrs %0, fpscr" : "=r"(fpscr));
+  *state = fpscr;
+  if (!(fpscr & PEAKLIMITER_FPCR_FLUSH))
+    __asm__ __volatile__("vmsr fpscr, %0" : : "r"(fpscr | PEAKLIMITER_FPCR_FLUSH));
+  return 1;
+#else
+  *state = 0;
+  return 0;
+#endif
+}
+
+void leavePeakLimiterFlushDenormals(uint64_t state)
+{
+#if defined(PEAKLIMITER_HAVE_X86)
+  if ((state & PEAKLIMITER_MXCSR_FLUSH) != PEAKLIMITER_MXCSR_FLUSH)
+    _mm_setcsr((_mm_getcsr() & ~PEAKLIMITER_MXCSR_FLUSH) | ((unsigned int)state & PEAKLIMITER_MXCSR_FLUSH));
+#elif defined(__aarch64__) && (defined(__GNUC__) || defined(__clang__))
+  uint64_t fpcr;
+
+  if (!(state & PEAKLIMITER_FPCR_FLUSH)) {
+    __asm__ __volatile__("mrs %0, fpcr" : "=r"(fpcr));
+    __asm__ __volatile__("msr fpcr, %0" : : "r"(fpcr & ~(uint64_t)PEAKLIMITER_FPCR_FLUSH));
+  }
+#elif defined(__arm__) && defined(__ARM_FP) && (defined(__GNUC__) || defined(__clang__))
+  uint32_t fpscr;
+
+  if (!(state & PEAKLIMITER_FPCR_FLUSH)) {
+    __asm__ __volatile__("vmrs %0, fpscr" : "=r"(fpscr));
+    __asm__ __volatile__("vmsr fpscr, %0" : : "r"(fpscr & ~(uint32_t)PEAKLIMITER_FPCR_FLUSH));
+  }
+#else
+  (void)state;
+#endif
+}
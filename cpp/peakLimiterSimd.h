@@ -0,0 +1,155 @@
+/*
+Copyright (c) 2016, UMR STMS 9912 - Ircam-Centre Pompidou / CNRS / UPMC
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the <organization> nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __peaklimitersimd_h__
+#define __peaklimitersimd_h__
+
+#include <stdint.h>
+
+enum {
+  PEAKLIMITER_ISA_SCALAR = 0,
+  PEAKLIMITER_ISA_SSE2,
+  PEAKLIMITER_ISA_AVX2,
+  PEAKLIMITER_ISA_AVX512,
+  PEAKLIMITER_ISA_NEON,
+  PEAKLIMITER_ISA_WASM,
+
+  PEAKLIMITER_ISA_BEST = -1
+};
+
+#define PEAKLIMITER_TRUEPEAK_PHASES   (4)    /* true peak oversampling factor */
+#define PEAKLIMITER_TRUEPEAK_TAPS     (12)   /* true peak filter taps per phase */
+
+/******************************************************************************
+* PeakLimiterMaxAbsFunc                                                       *
+* frame:     nChannels contiguous samples                                     *
+* nChannels: number of samples in frame                                       *
+* init:      starting value of the maximum (the limiter threshold)            *
+* returns:   max(init, fabs(frame[0]), ..., fabs(frame[nChannels-1]))         *
+******************************************************************************/
+typedef float (*PeakLimiterMaxAbsFunc)(const float* frame, int nChannels, float init);
+
+/******************************************************************************
+* PeakLimiterMaxAbsPlanarFunc                                                 *
+* samples:   one buffer per channel                                           *
+* nChannels: number of channels                                               *
+* offset:    first sample to read in each channel buffer                      *
+* nSamples:  number of samples per channel                                    *
+* init:      starting value of the maximum (the limiter threshold)            *
+* peak:      receives the maximum over all channels for each sample           *
+******************************************************************************/
+typedef void (*PeakLimiterMaxAbsPlanarFunc)(const float* const* samples, int nChannels,
+                                            int offset, int nSamples, float init, float* peak);
+
+/******************************************************************************
+* PeakLimiterApplyGainFunc                                                    *
+* in:        nChannels contiguous input samples, written to the delay line    *
+* out:       nChannels contiguous output samples, may be the same as in       *
+* delay:     nChannels contiguous delay line samples, read and replaced       *
+* nChannels: number of samples in the frame                                   *
+* gain:      gain applied to the delayed samples                              *
+* threshold: output is clipped to [-threshold, threshold]                     *
+******************************************************************************/
+typedef void (*PeakLimiterApplyGainFunc)(const float* in, float* out, float* delay, int nChannels,
+                                         float gain, float threshold);
+
+/******************************************************************************
+* PeakLimiterTruePeakFunc                                                     *
+* 4x oversampling of ITU-R BS.1770-4 Annex 2, 12 taps per phase               *
+* x:         nSamples samples of one channel, preceded by the last            *
+*            PEAKLIMITER_TRUEPEAK_TAPS-1 samples of the previous call         *
+*            (x[-11] .. x[-1])                                                *
+* nSamples:  number of samples                                                *
+* peak:      for each sample, max(peak, absolute value of the 4 interpolated  *
+*            samples)                                                         *
+******************************************************************************/
+typedef void (*PeakLimiterTruePeakFunc)(const float* x, int nSamples, float* peak);
+
+/******************************************************************************
+* PeakLimiterLaneMaxFunc                                                      *
+* element-wise maximum of two rows of nLanes values, one lane per stream      *
+* y:         receives max(a[s], b[s]), may be the same row as a or b          *
+******************************************************************************/
+typedef void (*PeakLimiterLaneMaxFunc)(const float* a, const float* b, float* y, int nLanes);
+
+/******************************************************************************
+* PeakLimiterLaneGainFunc                                                     *
+* gain update of PeakLimiter::updateGain for nLanes independent streams       *
+* maximum:      maximum over the lookahead window of each stream              *
+* fadedGain:    faded gain of each stream, updated                            *
+* smoothState:  smoothed gain of each stream, updated                         *
+* gain:         receives the new smoothed gain of each stream                 *
+* threshold, attackConst, releaseConst: shared by all streams                 *
+******************************************************************************/
+typedef void (*PeakLimiterLaneGainFunc)(const float* maximum, float* fadedGain, float* smoothState,
+                                        float* gain, int nLanes,
+                                        float threshold, float attackConst, float releaseConst);
+
+typedef struct {
+  int                           isa;
+  const char*                   name;
+  PeakLimiterMaxAbsFunc         maxAbs;
+  PeakLimiterMaxAbsPlanarFunc   maxAbsPlanar;
+  PeakLimiterApplyGainFunc      applyGain;
+  PeakLimiterTruePeakFunc       truePeak;
+  PeakLimiterLaneMaxFunc        laneMax;
+  PeakLimiterLaneGainFunc       laneGain;
+} PeakLimiterKernels;
+
+/******************************************************************************
+* getPeakLimiterKernels                                                       *
+* isa:     one of PEAKLIMITER_ISA_*, or PEAKLIMITER_ISA_BEST to pick the      *
+*          fastest set supported by the running CPU                           *
+* returns: kernel set, NULL if the instruction set is not available           *
+******************************************************************************/
+const PeakLimiterKernels* getPeakLimiterKernels(int isa = PEAKLIMITER_ISA_BEST);
+
+/******************************************************************************
+* getPeakLimiterTicks                                                         *
+* returns: a cheap monotonic counter for timing, the time stamp counter on    *
+*          x86, the virtual counter on ARM64, steady clock ns elsewhere       *
+******************************************************************************/
+uint64_t getPeakLimiterTicks();
+
+/******************************************************************************
+* enterPeakLimiterFlushDenormals                                              *
+* state:   receives the floating point mode of the calling thread, to give    *
+*          back to leavePeakLimiterFlushDenormals                             *
+* returns: 1 if subnormal floats are now flushed to zero by the hardware, as  *
+*          inputs and as results: FTZ and DAZ of the MXCSR (x86), FZ of the   *
+*          FPCR (ARM64) or of the FPSCR (ARMv7). 0 if the target has no such  *
+*          mode (WebAssembly), state is then 0                                *
+******************************************************************************/
+int enterPeakLimiterFlushDenormals(uint64_t* state);
+
+/******************************************************************************
+* leavePeakLimiterFlushDenormals                                              *
+* state:   mode given by enterPeakLimiterFlushDenormals, restored             *
+******************************************************************************/
+void leavePeakLimiterFlushDenormals(uint64_t state);
+
+#endif /* __peaklimitersimd_h__ */
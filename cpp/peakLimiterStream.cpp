@@ -0,0 +1,330 @@
+/*
+Copyright (c) 2016, UMR STMS 9912 - Ircam-Centre Pompidou / CNRS / UPMC
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the <organization> nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "peakLimiterStream.h"
+
+#include <thread>
+#include <chrono>
+
+#include <errno.h>
+#include <unistd.h>
+
+#ifndef max
+#define max(a, b)   (((a) > (b)) ? (a) : (b))
+#endif
+#ifndef min
+#define min(a, b)   (((a) < (b)) ? (a) : (b))
+#endif
+
+/* create stream */
+PeakLimiterStream::PeakLimiterStream(
+                           PeakLimiter*  limiterIn,
+                           int           formatIn,
+                           int           blockFramesIn,
+                           int           depthIn
+                           )
+{
+  m_pLimiter     = limiterIn;
+  m_format       = formatIn;
+  m_blockFrames  = max(blockFramesIn, 1);
+  m_depth        = max(depthIn, 2);
+  m_frameBytes   = (size_t)getFormatBytes(m_format) * limiterIn->m_channels;
+
+  /* the rings hold all the blocks of the pool and the end of stream */
+  m_pBlocks      = new uint8_t[(size_t)m_depth * m_blockFrames * m_frameBytes];
+  m_pFreeRing    = new PeakLimiterRing<PeakLimiterStreamBlock>(m_depth + 1);
+  m_pInputRing   = new PeakLimiterRing<PeakLimiterStreamBlock>(m_depth + 1);
+  m_pOutputRing  = new PeakLimiterRing<PeakLimiterStreamBlock>(m_depth + 1);
+
+  m_inFd         = -1;
+  m_outFd        = -1;
+  m_delay        = 0;
+  m_readError    = 0;
+  m_writeError   = 0;
+  memset(&m_stats, 0, sizeof(m_stats));
+}
+
+PeakLimiterStream::~PeakLimiterStream()
+{
+  if (m_pBlocks)
+  {
+    delete [] m_pBlocks;
+    m_pBlocks = NULL;
+  }
+  if (m_pFreeRing)
+  {
+    delete m_pFreeRing;
+    m_pFreeRing = NULL;
+  }
+  if (m_pInputRing)
+  {
+    delete m_pInputRing;
+    m_pInputRing = NULL;
+  }
+  if (m_pOutputRing)
+  {
+    delete m_pOutputRing;
+    m_pOutputRing = NULL;
+  }
+}
+
+int PeakLimiterStream::getFormatBytes(int format)
+{
+  switch (format) {
+  case PEAKLIMITERSTREAM_INT16: return 2;
+  case PEAKLIMITERSTREAM_INT24: return 3;
+  default:                      return 4;
+  }
+}
+
+int PeakLimiterStream::applyLimiterFormat(PeakLimiter* limiter, int format, const void* samplesIn, void* samplesOut, int nSamples)
+{
+  switch (format) {
+  case PEAKLIMITERSTREAM_INT16:
+    return limiter->applyLimiter_E_Int16((const int16_t*)samplesIn, (int16_t*)samplesOut, nSamples);
+  case PEAKLIMITERSTREAM_INT24:
+    return limiter->applyLimiter_E_Int24((const uint8_t*)samplesIn, (uint8_t*)samplesOut, nSamples);
+  case PEAKLIMITERSTREAM_INT32:
+    return limiter->applyLimiter_E_Int32((const int32_t*)samplesIn, (int32_t*)samplesOut, nSamples);
+  case PEAKLIMITERSTREAM_FLOAT32:
+    return limiter->applyLimiter_E((const float*)samplesIn, (float*)samplesOut, nSamples);
+  }
+  return LIMITER_INVALID_PARAMETER;
+}
+
+/* wait of a stage on an empty ring: yield first, then sleep */
+static void waitRing(int* spins)
+{
+  if (++(*spins) < PEAKLIMITERSTREAM_SPINS)
+    std::this_thread::yield();
+  else
+    std::this_thread::sleep_for(std::chrono::microseconds(PEAKLIMITERSTREAM_SLEEP_US));
+}
+
+/* pop one block, waiting for it, returns 1 if the stage had to wait */
+static int popBlock(PeakLimiterRing<PeakLimiterStreamBlock>* ring, PeakLimiterStreamBlock* block)
+{
+  int spins = 0;
+
+  while (ring->pop(block, 1) == 0)
+    waitRing(&spins);
+  return (spins > 0);
+}
+
+static void pushBlock(PeakLimiterRing<PeakLimiterStreamBlock>* ring, const PeakLimiterStreamBlock& block)
+{
+  int spins = 0;
+
+  while (!ring->push(block))
+    waitRing(&spins);
+}
+
+/* read up to size bytes, less only at the end of the file or on an error */
+static size_t readFull(int fd, uint8_t* buffer, size_t size, int* error)
+{
+  size_t done = 0;
+  ssize_t n;
+
+  while (done < size) {
+    n = read(fd, buffer + done, size - done);
+    if (n > 0)
+      done += (size_t)n;
+    else if (n < 0 && errno == EINTR)
+      continue;
+    else {
+      *error = (n < 0);
+      break;
+    }
+  }
+  return done;
+}
+
+static int writeFull(int fd, const uint8_t* buffer, size_t size)
+{
+  ssize_t n;
+
+  while (size > 0) {
+    n = write(fd, buffer, size);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return -1;
+    buffer += n;
+    size -= (size_t)n;
+  }
+  return 0;
+}
+
+/* reader: fills the free blocks, then the flush with silence and the end of stream */
+void PeakLimiterStream::readerThread()
+{
+  const size_t blockBytes = (size_t)m_blockFrames * m_frameBytes;
+  int64_t flushFrames = m_delay, stalls = 0;
+  PeakLimiterStreamBlock block;
+  size_t bytes;
+  int eof = 0, zeros;
+  uint8_t* samples;
+
+  while (!eof || flushFrames > 0) {
+    stalls += popBlock(m_pFreeRing, &block);
+    samples = m_pBlocks + (size_t)block.index * blockBytes;
+
+    block.nFrames = 0;
+    if (!eof) {
+      bytes = readFull(m_inFd, samples, blockBytes, &m_readError);
+      block.nFrames = (int)(bytes / m_frameBytes);
+      eof = (bytes < blockBytes);
+    }
+    if (eof) {
+      zeros = (int)min((int64_t)(m_blockFrames - block.nFrames), flushFrames);
+      memset(samples + (size_t)block.nFrames * m_frameBytes, 0, (size_t)zeros * m_frameBytes);
+      block.nFrames += zeros;
+      flushFrames -= zeros;
+    }
+    if (block.nFrames > 0)
+      pushBlock(m_pInputRing, block);
+  }
+
+  block.index = -1;
+  block.nFrames = 0;
+  pushBlock(m_pInputRing, block);
+  m_stats.readerStalls = stalls;
+}
+
+/* limiter: processes the blocks in place, waits for input only */
+void PeakLimiterStream::limiterThread()
+{
+  const size_t blockBytes = (size_t)m_blockFrames * m_frameBytes;
+  int64_t blocks = 0, stalls = 0, inputFill = 0, outputFill = 0;
+  int inputFillMax = 0, outputFillMax = 0, fill;
+  float maxGainReduction = 0;
+  double stallMs = 0;
+  PeakLimiterStreamBlock block;
+  std::chrono::steady_clock::time_point start;
+
+  for (;;) {
+    if (m_pInputRing->pop(&block, 1) == 0) {
+      start = std::chrono::steady_clock::now();
+      stalls += popBlock(m_pInputRing, &block);
+      stallMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+    if (block.nFrames == 0)
+      break;
+
+    fill = (int)m_pInputRing->count();
+    inputFill += fill;
+    inputFillMax = max(inputFillMax, fill);
+    fill = (int)m_pOutputRing->count();
+    outputFill += fill;
+    outputFillMax = max(outputFillMax, fill);
+
+    uint8_t* samples = m_pBlocks + (size_t)block.index * blockBytes;
+    applyLimiterFormat(m_pLimiter, m_format, samples, samples, block.nFrames);
+    maxGainReduction = max(m_pLimiter->getLimiterMaxGainReduction(), maxGainReduction);
+    blocks++;
+
+    pushBlock(m_pOutputRing, block);
+  }
+
+  pushBlock(m_pOutputRing, block);
+  m_stats.blocks = blocks;
+  m_stats.limiterStalls = stalls;
+  m_stats.limiterStallMs = stallMs;
+  m_stats.inputFillMean = blocks ? (float)inputFill / blocks : 0;
+  m_stats.inputFillMax = inputFillMax;
+  m_stats.outputFillMean = blocks ? (float)outputFill / blocks : 0;
+  m_stats.outputFillMax = outputFillMax;
+  m_stats.maxGainReduction = maxGainReduction;
+}
+
+/* writer: drops the delay, writes and gives the blocks back to the reader.
+   After a write error it keeps draining so that the other stages finish */
+void PeakLimiterStream::writerThread()
+{
+  const size_t blockBytes = (size_t)m_blockFrames * m_frameBytes;
+  int64_t skipFrames = m_delay, frames = 0, stalls = 0;
+  PeakLimiterStreamBlock block;
+  int skip;
+
+  for (;;) {
+    stalls += popBlock(m_pOutputRing, &block);
+    if (block.nFrames == 0)
+      break;
+
+    skip = (int)min((int64_t)block.nFrames, skipFrames);
+    skipFrames -= skip;
+    if (!m_writeError && block.nFrames > skip) {
+      if (writeFull(m_outFd, m_pBlocks + (size_t)block.index * blockBytes + (size_t)skip * m_frameBytes,
+                    (size_t)(block.nFrames - skip) * m_frameBytes))
+        m_writeError = 1;
+      else
+        frames += block.nFrames - skip;
+    }
+
+    pushBlock(m_pFreeRing, block);
+  }
+
+  m_stats.frames = frames;
+  m_stats.writerStalls = stalls;
+}
+
+/* run the three stages until the end of the input */
+int PeakLimiterStream::runLimiterStream(int inFdIn, int outFdIn)
+{
+  PeakLimiterStreamBlock block;
+  int i;
+
+  m_inFd = inFdIn;
+  m_outFd = outFdIn;
+  m_delay = m_pLimiter->getLimiterDelay();
+  m_readError = 0;
+  m_writeError = 0;
+  memset(&m_stats, 0, sizeof(m_stats));
+
+  for (i = 0; i < m_depth; i++) {
+    block.index = i;
+    block.nFrames = 0;
+    m_pFreeRing->push(block);
+  }
+
+  std::thread reader(&PeakLimiterStream::readerThread, this);
+  std::thread writer(&PeakLimiterStream::writerThread, this);
+  limiterThread();
+  reader.join();
+  writer.join();
+
+  /* blocks back in the free ring for the next run */
+  while (m_pFreeRing->pop(&block, 1))
+    ;
+
+  return (m_readError || m_writeError) ? LIMITER_INVALID_HANDLE : LIMITER_OK;
+}
+
+const PeakLimiterStreamStats* PeakLimiterStream::getStreamStats()
+{
+  return &m_stats;
+}
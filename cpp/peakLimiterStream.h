@@ -0,0 +1,151 @@
+/*
+Copyright (c) 2016, UMR STMS 9912 - Ircam-Centre Pompidou / CNRS / UPMC
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the <organization> nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __peaklimiterstream_h__
+#define __peaklimiterstream_h__
+
+#include "peakLimiter.h"
+#include "peakLimiterRing.h"
+
+#define PEAKLIMITERSTREAM_BLOCK_DEFAULT   (1024)    /* default frames per block */
+#define PEAKLIMITERSTREAM_DEPTH_DEFAULT   (8)       /* default number of blocks in flight */
+#define PEAKLIMITERSTREAM_SPINS           (64)      /* yields of a waiting stage before it sleeps */
+#define PEAKLIMITERSTREAM_SLEEP_US        (50)      /* sleep of a waiting stage */
+
+/* sample formats of the streams, interleaved little endian */
+enum {
+  PEAKLIMITERSTREAM_INT16 = 0,
+  PEAKLIMITERSTREAM_INT24,
+  PEAKLIMITERSTREAM_INT32,
+  PEAKLIMITERSTREAM_FLOAT32
+};
+
+/* block handed over between the stages, nFrames = 0 ends the stream */
+typedef struct {
+  int           index;
+  int           nFrames;
+} PeakLimiterStreamBlock;
+
+/* statistics of a run, see getStreamStats */
+typedef struct {
+  int64_t       frames;             /* frames written */
+  int64_t       blocks;             /* blocks processed by the limiter */
+  int64_t       readerStalls;       /* waits of the reader for a free block: output backpressure */
+  int64_t       limiterStalls;      /* waits of the limiter for input: input starvation */
+  int64_t       writerStalls;       /* waits of the writer for a processed block */
+  double        limiterStallMs;     /* total time the limiter waited */
+  float         inputFillMean;      /* blocks waiting for the limiter, sampled at each block */
+  int           inputFillMax;
+  float         outputFillMean;     /* blocks waiting for the writer, sampled at each block */
+  int           outputFillMax;
+  float         maxGainReduction;   /* in dB */
+} PeakLimiterStreamStats;
+
+/******************************************************************************
+* PeakLimiterStream                                                           *
+* streaming of interleaved PCM from a file descriptor through a PeakLimiter   *
+* to another, in three threads: reader, limiter and writer.                   *
+* The stages exchange the blocks of a preallocated pool through lock-free    *
+* single producer/single consumer rings (reader -> limiter -> writer ->       *
+* reader), so only the reader and the writer block on I/O. A blocked output  *
+* shows up as reader stalls (no free block), a starved input as limiter      *
+* stalls.                                                                     *
+* The output is delay compensated like PeakLimiterOffline: the writer drops   *
+* the first getLimiterDelay() frames and the reader flushes the end of the    *
+* stream with as many frames of silence.                                      *
+******************************************************************************/
+class PeakLimiterStream
+{
+
+public:
+  PeakLimiter*  m_pLimiter;
+  int           m_format;
+  size_t        m_frameBytes;
+  int           m_blockFrames;
+  int           m_depth;
+  uint8_t*      m_pBlocks;
+  PeakLimiterRing<PeakLimiterStreamBlock>* m_pFreeRing;
+  PeakLimiterRing<PeakLimiterStreamBlock>* m_pInputRing;
+  PeakLimiterRing<PeakLimiterStreamBlock>* m_pOutputRing;
+  int           m_inFd, m_outFd;
+  int64_t       m_delay;
+  int           m_readError, m_writeError;
+  PeakLimiterStreamStats m_stats;
+
+public:
+
+/******************************************************************************
+* createLimiterStream                                                         *
+* limiter:     limiter, with its number of channels set, used by run only     *
+* format:      sample format, one of PEAKLIMITERSTREAM_*                       *
+* blockFrames: frames per block (default PEAKLIMITERSTREAM_BLOCK_DEFAULT)     *
+* depth:       blocks in the pool (default PEAKLIMITERSTREAM_DEPTH_DEFAULT),   *
+*              at least 2                                                     *
+******************************************************************************/
+PeakLimiterStream(         PeakLimiter*  limiter,
+                           int           format,
+                           int           blockFrames = PEAKLIMITERSTREAM_BLOCK_DEFAULT,
+                           int           depth = PEAKLIMITERSTREAM_DEPTH_DEFAULT);
+~PeakLimiterStream();
+
+/******************************************************************************
+* runLimiterStream                                                            *
+* inFd:        input file descriptor, read until end of file                  *
+* outFd:       output file descriptor                                         *
+* returns:     error code, LIMITER_INVALID_HANDLE on a read or write error    *
+* returns when the whole input has been written                               *
+******************************************************************************/
+int runLimiterStream( int inFd, int outFd);
+
+/******************************************************************************
+* getStreamStats                                                              *
+* returns:     statistics of the last run                                     *
+******************************************************************************/
+const PeakLimiterStreamStats* getStreamStats();
+
+/******************************************************************************
+* applyLimiterFormat                                                          *
+* applyLimiter_E* of a PEAKLIMITERSTREAM_* format, samplesIn may be the same  *
+* buffer as samplesOut                                                        *
+******************************************************************************/
+static int applyLimiterFormat( PeakLimiter* limiter, int format, const void* samplesIn, void* samplesOut, int nSamples);
+
+/******************************************************************************
+* getFormatBytes                                                              *
+* returns:     bytes per sample of a PEAKLIMITERSTREAM_* format               *
+******************************************************************************/
+static int getFormatBytes( int format);
+
+private:
+void readerThread();
+void limiterThread();
+void writerThread();
+PeakLimiterStream( const PeakLimiterStream&);
+PeakLimiterStream& operator=( const PeakLimiterStream&);
+};
+
+#endif /* __peaklimiterstream_h__ */
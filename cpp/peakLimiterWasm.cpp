@@ -0,0 +1,168 @@
+/*
+Copyright (c) 2016, UMR STMS 9912 - Ircam-Centre Pompidou / CNRS / UPMC
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the <organization> nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* WebAssembly build of the limiter, for javascript/peaklimiterprocessor.js.
+
+   build:  emcc -O3 -msimd128 -ffp-contract=off -std=c++11 -fno-exceptions -fno-rtti
+                -sSTANDALONE_WASM -sALLOW_MEMORY_GROWTH=1 --no-entry
+                peakLimiterWasm.cpp peakLimiter.cpp peakLimiterSimd.cpp -o peaklimiter.wasm
+
+   -msimd128 selects the WebAssembly SIMD kernels of peakLimiterSimd.cpp (PEAKLIMITER_ISA_WASM),
+   which give the same output as the scalar and x86 kernels. The module only imports a few WASI
+   functions (clock, abort), which the processor stubs, so it needs no JavaScript glue.
+
+   One handle holds a limiter and planar float buffers of maxFrames samples per channel in the
+   WASM heap: the caller writes the input through Float32Array views of the channel buffers, calls
+   peakLimiterWasmProcess, and reads the output from the same views. The views must be made again
+   when the memory grows, which only happens on create. */
+
+#include "peakLimiter.h"
+
+#include <emscripten/emscripten.h>
+
+typedef struct {
+  PeakLimiter*  limiter;
+  int           maxChannels;
+  int           maxFrames;
+  float*        samples;        /* maxChannels buffers of maxFrames samples */
+  float**       channels;       /* start of each channel buffer */
+} PeakLimiterWasm;
+
+extern "C" {
+
+/* create a limiter with its channel buffers, NULL on error */
+EMSCRIPTEN_KEEPALIVE PeakLimiterWasm* peakLimiterWasmCreate(
+                           float         maxAttackMs,
+                           float         releaseMs,
+                           float         threshold,
+                           int           maxChannels,
+                           int           maxSampleRate,
+                           int           maxFrames)
+{
+  PeakLimiterWasm* handle;
+  int j;
+
+  if ((maxChannels < 1) || (maxFrames < 1)) return NULL;
+
+  handle = new PeakLimiterWasm;
+  handle->limiter = new PeakLimiter(maxAttackMs, releaseMs, threshold, maxChannels, maxSampleRate);
+  handle->maxChannels = maxChannels;
+  handle->maxFrames = maxFrames;
+  handle->samples = new float[(size_t)maxChannels * maxFrames]();
+  handle->channels = new float*[maxChannels];
+  for (j = 0; j < maxChannels; j++)
+    handle->channels[j] = handle->samples + (size_t)j * maxFrames;
+
+  if (handle->limiter->getLimiterMemory() == NULL) {
+    delete [] handle->channels;
+    delete [] handle->samples;
+    delete handle->limiter;
+    delete handle;
+    return NULL;
+  }
+  return handle;
+}
+
+EMSCRIPTEN_KEEPALIVE void peakLimiterWasmDestroy(PeakLimiterWasm* handle)
+{
+  if (handle == NULL) return;
+  if (handle->channels)
+  {
+    delete [] handle->channels;
+    handle->channels = NULL;
+  }
+  if (handle->samples)
+  {
+    delete [] handle->samples;
+    handle->samples = NULL;
+  }
+  if (handle->limiter)
+  {
+    delete handle->limiter;
+    handle->limiter = NULL;
+  }
+  delete handle;
+}
+
+/* byte offset of the buffer of a channel in the WASM memory */
+EMSCRIPTEN_KEEPALIVE float* peakLimiterWasmGetChannel(PeakLimiterWasm* handle, int channel)
+{
+  if ((handle == NULL) || (channel < 0) || (channel >= handle->maxChannels)) return NULL;
+  return handle->channels[channel];
+}
+
+/* limit nFrames samples of the channel buffers in place */
+EMSCRIPTEN_KEEPALIVE int peakLimiterWasmProcess(PeakLimiterWasm* handle, int nFrames)
+{
+  if (handle == NULL) return LIMITER_INVALID_HANDLE;
+  if ((nFrames < 0) || (nFrames > handle->maxFrames)) return LIMITER_INVALID_PARAMETER;
+  return handle->limiter->applyLimiter_I(handle->channels, nFrames);
+}
+
+/* attack, release and threshold, applied at the start of the next process */
+EMSCRIPTEN_KEEPALIVE int peakLimiterWasmSetParameters(PeakLimiterWasm* handle, float attackMs, float releaseMs, float threshold)
+{
+  PeakLimiterParameters params;
+
+  if (handle == NULL) return LIMITER_INVALID_HANDLE;
+  params.attackMs = attackMs;
+  params.releaseMs = releaseMs;
+  params.threshold = threshold;
+  return handle->limiter->setLimiterParameters(&params);
+}
+
+EMSCRIPTEN_KEEPALIVE int peakLimiterWasmSetNChannels(PeakLimiterWasm* handle, int nChannels)
+{
+  if (handle == NULL) return LIMITER_INVALID_HANDLE;
+  return handle->limiter->setLimiterNChannels(nChannels);
+}
+
+EMSCRIPTEN_KEEPALIVE int peakLimiterWasmSetTruePeak(PeakLimiterWasm* handle, int truePeak)
+{
+  if (handle == NULL) return LIMITER_INVALID_HANDLE;
+  return handle->limiter->setLimiterTruePeak(truePeak);
+}
+
+EMSCRIPTEN_KEEPALIVE int peakLimiterWasmReset(PeakLimiterWasm* handle)
+{
+  if (handle == NULL) return LIMITER_INVALID_HANDLE;
+  return handle->limiter->resetLimiter();
+}
+
+EMSCRIPTEN_KEEPALIVE int peakLimiterWasmGetDelay(PeakLimiterWasm* handle)
+{
+  if (handle == NULL) return 0;
+  return handle->limiter->getLimiterDelay();
+}
+
+EMSCRIPTEN_KEEPALIVE float peakLimiterWasmGetMaxGainReduction(PeakLimiterWasm* handle)
+{
+  if (handle == NULL) return 0.0f;
+  return handle->limiter->getLimiterMaxGainReduction();
+}
+
+}
@@ -0,0 +1,261 @@
+/*
+Copyright (c) 2016, UMR STMS 9912 - Ircam-Centre Pompidou / CNRS / UPMC
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the <organization> nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/************************************************************************************/
+/*!
+ *  @brief          AudioWorklet processor running the C++ limiter compiled to WebAssembly
+ *                  (cpp/peakLimiterWasm.cpp, with the WebAssembly SIMD kernels)
+ *
+ *  @details        The compiled WebAssembly.Module is passed in processorOptions and
+ *                  instantiated synchronously in the audio thread. The limiter works in place
+ *                  on its channel buffers in the WASM heap: Float32Array views of them are
+ *                  made once, and each render quantum is copied in and out with set(), so that
+ *                  nothing is allocated while processing.
+ *
+ *                  processorOptions: { module, numChannels, maxAttackMs, releaseMs, threshold,
+ *                  maxFrames (default 128) }
+ *                  port messages: { type: 'parameters', attackMs, releaseMs, threshold },
+ *                  { type: 'truePeak', value }, { type: 'reset' }, { type: 'maxGainReduction' },
+ *                  { type: 'destroy' }. The processor posts { type: 'delay', value } after the
+ *                  creation and after the first process following a parameter change, and
+ *                  { type: 'maxGainReduction', value } on request.
+ */
+/************************************************************************************/
+
+/************************************************************************************/
+/*!
+ *  @brief          imports of the standalone module: the WASI functions are stubbed, the
+ *                  clock returns Date.now(), it is only read when timing is enabled
+ *  @param[in]      module : compiled WebAssembly.Module
+ *  @param[in]      getMemory : returns the memory of the instance
+ *
+ */
+/************************************************************************************/
+export function peakLimiterImports( module, getMemory )
+{
+    const imports = {};
+
+    for( const entry of WebAssembly.Module.imports( module ) )
+    {
+        if( entry.kind !== 'function' )
+        {
+            continue;
+        }
+        if( imports[entry.module] === undefined )
+        {
+            imports[entry.module] = {};
+        }
+        imports[entry.module][entry.name] = () => 0;
+    }
+
+    const wasi = imports.wasi_snapshot_preview1;
+    if( wasi !== undefined )
+    {
+        if( wasi.clock_time_get !== undefined )
+        {
+            wasi.clock_time_get = ( id, precision, time ) =>
+            {
+                new DataView( getMemory().buffer ).setBigUint64( time, BigInt( Date.now() ) * 1000000n, true );
+                return 0;
+            };
+        }
+        if( wasi.proc_exit !== undefined )
+        {
+            wasi.proc_exit = ( code ) =>
+            {
+                throw new Error( "peaklimiter.wasm exited with code " + code );
+            };
+        }
+    }
+
+    return imports;
+}
+
+export class PeakLimiterProcessor extends AudioWorkletProcessor
+{
+    /************************************************************************************/
+    /*!
+     *  @brief          Class constructor
+     *  @param[in]      options : AudioWorkletNodeOptions, with the processorOptions above
+     *
+     */
+    /************************************************************************************/
+    constructor( options )
+    {
+        super();
+
+        const opts = options.processorOptions;
+
+        /// sanity checks
+        if( opts.numChannels <= 0 )
+        {
+            throw new Error("Invalid");
+        }
+
+        this.numChannels = opts.numChannels;
+        this.maxFrames = opts.maxFrames || 128;
+        this.memory = null;
+
+        const instance = new WebAssembly.Instance( opts.module, peakLimiterImports( opts.module, () => this.memory ) );
+        this.wasm = instance.exports;
+        this.memory = this.wasm.memory;
+        if( this.wasm._initialize !== undefined )
+        {
+            this.wasm._initialize();
+        }
+
+        /// sampleRate is a global of the AudioWorkletGlobalScope
+        this.handle = this.wasm.peakLimiterWasmCreate( opts.maxAttackMs, opts.releaseMs, opts.threshold,
+                                                       this.numChannels, sampleRate, this.maxFrames );
+        if( this.handle === 0 )
+        {
+            throw new Error("Invalid");
+        }
+
+        this.buffer = null;
+        this.views = [];
+        this.updateViews();
+
+        this.delayPending = false;
+        this.port.onmessage = ( event ) => this.onMessage( event.data );
+        this.postDelay();
+    }
+
+    /************************************************************************************/
+    /*!
+     *  @brief          (re)make the views of the channel buffers, when the memory has grown
+     *
+     */
+    /************************************************************************************/
+    updateViews()
+    {
+        if( this.buffer === this.memory.buffer )
+        {
+            return;
+        }
+        this.buffer = this.memory.buffer;
+        for( let j = 0; j < this.numChannels; j++ )
+        {
+            this.views[j] = new Float32Array( this.buffer,
+                                              this.wasm.peakLimiterWasmGetChannel( this.handle, j ),
+                                              this.maxFrames );
+        }
+    }
+
+    postDelay()
+    {
+        this.port.postMessage( { type: 'delay', value: this.wasm.peakLimiterWasmGetDelay( this.handle ) } );
+    }
+
+    onMessage( data )
+    {
+        if( this.handle === 0 )
+        {
+            return;
+        }
+        switch( data.type )
+        {
+            case 'parameters':
+                /// applied at the start of the next process, the delay is posted after it
+                this.wasm.peakLimiterWasmSetParameters( this.handle, data.attackMs, data.releaseMs, data.threshold );
+                this.delayPending = true;
+                break;
+            case 'truePeak':
+                this.wasm.peakLimiterWasmSetTruePeak( this.handle, data.value ? 1 : 0 );
+                break;
+            case 'reset':
+                this.wasm.peakLimiterWasmReset( this.handle );
+                break;
+            case 'maxGainReduction':
+                this.port.postMessage( { type: 'maxGainReduction',
+                                         value: this.wasm.peakLimiterWasmGetMaxGainReduction( this.handle ) } );
+                break;
+            case 'destroy':
+                this.wasm.peakLimiterWasmDestroy( this.handle );
+                this.handle = 0;
+                break;
+        }
+    }
+
+    process( inputs, outputs )
+    {
+        const input  = inputs[0];
+        const output = outputs[0];
+
+        if( this.handle === 0 )
+        {
+            return false;
+        }
+        if( output.length === 0 )
+        {
+            return true;
+        }
+
+        const nFrames = output[0].length;
+
+        this.updateViews();
+
+        for( let offset = 0; offset < nFrames; offset += this.maxFrames )
+        {
+            const n = Math.min( this.maxFrames, nFrames - offset );
+            const whole = ( n === this.maxFrames ) && ( n === nFrames );
+
+            /// missing input channels, or no input connected: silence, the tail is still flushed
+            for( let j = 0; j < this.numChannels; j++ )
+            {
+                if( j < input.length )
+                {
+                    this.views[j].set( whole ? input[j] : input[j].subarray( offset, offset + n ) );
+                }
+                else
+                {
+                    this.views[j].fill( 0, 0, n );
+                }
+            }
+
+            this.wasm.peakLimiterWasmProcess( this.handle, n );
+
+            for( let j = 0; j < Math.min( output.length, this.numChannels ); j++ )
+            {
+                output[j].set( whole ? this.views[j] : this.views[j].subarray( 0, n ), offset );
+            }
+        }
+
+        if( this.delayPending )
+        {
+            this.delayPending = false;
+            this.postDelay();
+        }
+
+        return true;
+    }
+}
+
+if( typeof registerProcessor === 'function' )
+{
+    registerProcessor( 'peak-limiter', PeakLimiterProcessor );
+}
@@ -0,0 +1,144 @@
+/*
+Copyright (c) 2016, UMR STMS 9912 - Ircam-Centre Pompidou / CNRS / UPMC
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the <organization> nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* Headless render of a raw file through PeakLimiterProcessor and peaklimiter.wasm, in Node.
+
+   usage:  node peaklimiterrender.js peaklimiter.wasm input output -channels n -rate hz
+                [-threshold dB] [-attack ms] [-release ms] [-truepeak]
+
+   The files are raw interleaved 32 bit float little endian samples. The processor is run as in
+   an AudioWorklet, one render quantum of 128 frames at a time, with the worklet globals stubbed.
+   As with peakLimiterFile -raw f32, the output is aligned with the input (the lookahead is
+   dropped and the tail flushed with silence) and the defaults are the same, so that the two
+   outputs can be compared bit for bit. */
+
+import fs from 'fs';
+import { dB2lin } from './utils.js';
+
+const RENDER_QUANTUM = 128;
+
+function usage()
+{
+    console.error( "usage: node peaklimiterrender.js peaklimiter.wasm input output -channels n -rate hz" +
+                   " [-threshold dB] [-attack ms] [-release ms] [-truepeak]" );
+    process.exit( 1 );
+}
+
+const files = [];
+let channels = 0, rate = 0, thresholdDb = -1, attackMs = 20, releaseMs = 20, truePeak = false;
+
+for( let i = 2; i < process.argv.length; i++ )
+{
+    const arg = process.argv[i];
+    const next = () => ( i + 1 < process.argv.length ) ? Number( process.argv[++i] ) : usage();
+
+    if( arg === '-channels' )       channels = next();
+    else if( arg === '-rate' )      rate = next();
+    else if( arg === '-threshold' ) thresholdDb = next();
+    else if( arg === '-attack' )    attackMs = next();
+    else if( arg === '-release' )   releaseMs = next();
+    else if( arg === '-truepeak' )  truePeak = true;
+    else if( arg[0] !== '-' )       files.push( arg );
+    else                            usage();
+}
+if( files.length !== 3 || !( channels >= 1 ) || !( rate >= 1 ) )
+{
+    usage();
+}
+
+/// globals of the AudioWorkletGlobalScope used by the processor
+const messages = [];
+globalThis.sampleRate = rate;
+globalThis.AudioWorkletProcessor = class
+{
+    constructor()
+    {
+        this.port = { postMessage: ( message ) => messages.push( message ), onmessage: null };
+    }
+};
+
+const { PeakLimiterProcessor } = await import( './peaklimiterprocessor.js' );
+
+const module = new WebAssembly.Module( fs.readFileSync( files[0] ) );
+const processor = new PeakLimiterProcessor( { processorOptions: { module: module,
+                                                                  numChannels: channels,
+                                                                  maxAttackMs: attackMs,
+                                                                  releaseMs: releaseMs,
+                                                                  threshold: dB2lin( thresholdDb ) } } );
+if( truePeak )
+{
+    processor.port.onmessage( { data: { type: 'truePeak', value: true } } );
+}
+const delay = messages.find( ( message ) => message.type === 'delay' ).value;
+
+const bytes = fs.readFileSync( files[1] );
+const input = new Float32Array( bytes.buffer.slice( bytes.byteOffset, bytes.byteOffset + bytes.byteLength - bytes.byteLength % ( 4 * channels ) ) );
+const nFrames = input.length / channels;
+const output = new Float32Array( input.length );
+
+const inputs = [ [] ], outputs = [ [] ];
+for( let j = 0; j < channels; j++ )
+{
+    inputs[0].push( new Float32Array( RENDER_QUANTUM ) );
+    outputs[0].push( new Float32Array( RENDER_QUANTUM ) );
+}
+
+const start = process.hrtime.bigint();
+
+/// the whole input, then silence until the tail is out
+for( let position = 0; position < nFrames + delay; position += RENDER_QUANTUM )
+{
+    for( let j = 0; j < channels; j++ )
+    {
+        const x = inputs[0][j];
+        for( let i = 0; i < RENDER_QUANTUM; i++ )
+        {
+            x[i] = ( position + i < nFrames ) ? input[( position + i ) * channels + j] : 0;
+        }
+    }
+
+    processor.process( inputs, outputs );
+
+    for( let j = 0; j < channels; j++ )
+    {
+        const y = outputs[0][j];
+        for( let i = 0; i < RENDER_QUANTUM; i++ )
+        {
+            const frame = position + i - delay;
+            if( frame >= 0 && frame < nFrames )
+            {
+                output[frame * channels + j] = y[i];
+            }
+        }
+    }
+}
+
+const seconds = Number( process.hrtime.bigint() - start ) / 1e9;
+
+fs.writeFileSync( files[2], new Uint8Array( output.buffer ) );
+console.error( `${nFrames} frames, ${channels} channels, delay ${delay}: ${seconds.toFixed( 3 )} s, ` +
+               `${( nFrames / rate / seconds ).toFixed( 1 )}x real time` );
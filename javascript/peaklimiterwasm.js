@@ -0,0 +1,238 @@
+/*
+Copyright (c) 2016, UMR STMS 9912 - Ircam-Centre Pompidou / CNRS / UPMC
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the <organization> nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+import AbstractNode from './abstractnode.js';
+import utilities from './utils.js';
+
+/************************************************************************************/
+/*!
+ *  @brief          PeakLimiterNode on an AudioWorklet running the C++ limiter compiled to
+ *                  WebAssembly (peaklimiterprocessor.js), instead of the JavaScript port in a
+ *                  ScriptProcessorNode. Same defaults and setters as PeakLimiterNode.
+ *
+ *  @details        const node = await PeakLimiterWasmNode.create( audioContext, 2, 'peaklimiter.wasm' );
+ *
+ *                  The parameters are posted to the audio thread and applied at the start of
+ *                  the next render quantum; getDelay() returns the delay reported back by it.
+ */
+/************************************************************************************/
+export default class PeakLimiterWasmNode extends AbstractNode
+{
+    /************************************************************************************/
+    /*!
+     *  @brief          compile the WebAssembly module, load the processor and create the node
+     *  @param[in]      audioContext
+     *  @param[in]      numChannels : number of channels
+     *  @param[in]      wasmUrl : URL of peaklimiter.wasm
+     *  @param[in]      processorUrl : URL of peaklimiterprocessor.js, next to this file by default
+     *
+     */
+    /************************************************************************************/
+    static async create( audioContext,
+                         numChannels,
+                         wasmUrl,
+                         processorUrl = new URL( './peaklimiterprocessor.js', import.meta.url ) )
+    {
+        const [ module ] = await Promise.all( [ WebAssembly.compileStreaming( fetch( wasmUrl ) ),
+                                                audioContext.audioWorklet.addModule( processorUrl ) ] );
+
+        return new PeakLimiterWasmNode( audioContext, numChannels, module );
+    }
+
+    /************************************************************************************/
+    /*!
+     *  @brief          Class constructor, the processor must already be loaded in the
+     *                  audioWorklet of the context
+     *  @param[in]      audioContext
+     *  @param[in]      numChannels : number of channels
+     *  @param[in]      module : compiled WebAssembly.Module of peaklimiter.wasm
+     *
+     */
+    /************************************************************************************/
+    constructor( audioContext,
+                 numChannels,
+                 module )
+    {
+        /// sanity checks
+        if( numChannels <= 0 )
+        {
+            throw new Error("Invalid");
+        }
+
+        super( audioContext );
+
+        this.channels = numChannels;
+        this.maxAttackMs = 20;
+        this.attackMs = 20;
+        this.releaseMs = 20;
+        this.threshold = utilities.dB2lin( -3 );
+        this.truePeak = false;
+        this.delay = 0;
+        this.pendingGainReduction = [];
+
+        this._workletNode = new AudioWorkletNode( audioContext, 'peak-limiter',
+        {
+            numberOfInputs: 1,
+            numberOfOutputs: 1,
+            outputChannelCount: [ numChannels ],
+            channelCount: numChannels,
+            channelCountMode: 'explicit',
+            channelInterpretation: 'discrete',
+            processorOptions:
+            {
+                module: module,
+                numChannels: numChannels,
+                maxAttackMs: this.maxAttackMs,
+                releaseMs: this.releaseMs,
+                threshold: this.threshold,
+            },
+        } );
+
+        this._workletNode.port.onmessage = ( event ) => this._onMessage( event.data );
+
+        this._input.connect( this._workletNode );
+        this._workletNode.connect( this._output );
+    }
+
+    _onMessage( data )
+    {
+        if( data.type === 'delay' )
+        {
+            this.delay = data.value;
+        }
+        else if( data.type === 'maxGainReduction' )
+        {
+            const resolve = this.pendingGainReduction.shift();
+            if( resolve !== undefined )
+            {
+                resolve( data.value );
+            }
+        }
+    }
+
+    _postParameters()
+    {
+        this._workletNode.port.postMessage( { type: 'parameters',
+                                              attackMs: this.attackMs,
+                                              releaseMs: this.releaseMs,
+                                              threshold: this.threshold } );
+    }
+
+    getDelay()
+    {
+        return this.delay;
+    }
+
+    getAttack()
+    {
+        return this.attackMs;
+    }
+
+    setAttack( attackMsIn )
+    {
+        if( attackMsIn == this.attackMs ) return true;
+        if( attackMsIn < 0 || attackMsIn > this.maxAttackMs ) return false;
+
+        this.attackMs = attackMsIn;
+        this._postParameters();
+
+        return true;
+    }
+
+    setRelease( releaseMsIn )
+    {
+        if( releaseMsIn == this.releaseMs ) return true;
+
+        this.releaseMs = releaseMsIn;
+        this._postParameters();
+
+        return true;
+    }
+
+    setThreshold( thresholdIn )
+    {
+        this.threshold = thresholdIn;
+        this._postParameters();
+
+        return true;
+    }
+
+    getThreshold()
+    {
+        return this.threshold;
+    }
+
+    /************************************************************************************/
+    /*!
+     *  @brief          detector on the inter-sample peaks (4x oversampled)
+     *  @param[in]      truePeakIn : boolean
+     *
+     */
+    /************************************************************************************/
+    setTruePeak( truePeakIn )
+    {
+        this.truePeak = truePeakIn;
+        this._workletNode.port.postMessage( { type: 'truePeak', value: truePeakIn } );
+
+        return true;
+    }
+
+    /************************************************************************************/
+    /*!
+     *  @brief          maximum gain reduction in dB of the last render quantum, a Promise
+     *
+     */
+    /************************************************************************************/
+    getMaxGainReduction()
+    {
+        return new Promise( ( resolve ) =>
+        {
+            this.pendingGainReduction.push( resolve );
+            this._workletNode.port.postMessage( { type: 'maxGainReduction' } );
+        } );
+    }
+
+    reset()
+    {
+        this._workletNode.port.postMessage( { type: 'reset' } );
+
+        return true;
+    }
+
+    /************************************************************************************/
+    /*!
+     *  @brief          disconnect the node and free the limiter in the WASM heap
+     *
+     */
+    /************************************************************************************/
+    destroy()
+    {
+        this._input.disconnect();
+        this._workletNode.disconnect();
+        this._workletNode.port.postMessage( { type: 'destroy' } );
+    }
+}